@@ -0,0 +1,254 @@
+// Host-side micro-benchmarks of the CPU hot paths of the library: CRC, decoding, comparison, aggregation, copy and serialization.
+// Build and run with: PLATFORMIO_SRC_DIR=examples/BenchNative pio run -e native-bench -t exec
+// (-O2 and ArduinoJson: the native env is not optimized and does not measure Data::toJson(JsonObject))
+//
+// The frames decoded are recorded at startup from the simulated devices (native/MycilaJSYSimulator.h), one per model.
+// Each line reports the time per operation (wall time of the host) and the heap allocations per operation.
+//
+// To track the results over time, save the output and pass it back as a baseline:
+//   MYCILA_JSY_BENCH_BASELINE=bench.txt   compare with a previous output and exit with 1 on a regression
+//   MYCILA_JSY_BENCH_TOLERANCE=20         percentage of slow down tolerated (default: 20), more allocations are always a regression
+#include <MycilaJSY.h>
+#include <MycilaJSYSimulator.h>
+
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+
+// minimum run time of a benchmark
+#define BENCH_MIN_TIME_NS 200000000
+
+static constexpr uint16_t models[] = {
+  MYCILA_JSY_MK_1031,
+  MYCILA_JSY_MK_163,
+  MYCILA_JSY_MK_193,
+  MYCILA_JSY_MK_194,
+  MYCILA_JSY_MK_227,
+  MYCILA_JSY_MK_229,
+  MYCILA_JSY_MK_333,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// heap allocations
+///////////////////////////////////////////////////////////////////////////////
+
+static uint64_t allocations = 0;
+
+// not inlined: once inlined in the operators below, GCC sees free() called on the result of operator new (-Wmismatched-new-delete)
+__attribute__((noinline)) static void* allocate(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) static void release(void* p) noexcept { free(p); }
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+
+#ifdef MYCILA_JSON_SUPPORT
+// ArduinoJson allocates with malloc() and realloc(), not with operator new
+class CountingAllocator : public ArduinoJson::Allocator {
+  public:
+    void* allocate(size_t size) override {
+      allocations++;
+      return malloc(size);
+    }
+    void deallocate(void* p) override { free(p); }
+    void* reallocate(void* p, size_t size) override {
+      allocations++;
+      return realloc(p, size);
+    }
+};
+
+static CountingAllocator jsonAllocator;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// recording
+///////////////////////////////////////////////////////////////////////////////
+
+// keeps the bytes of the last response received from the simulated bus
+class Recorder : public SerialLine {
+  public:
+    explicit Recorder(SerialLine& line) : _line(line) {}
+
+    std::vector<uint8_t> frame;
+
+    void open(uint32_t baudRate) override { _line.open(baudRate); }
+    void close() override { _line.close(); }
+    void transmit(const uint8_t* data, size_t len) override {
+      frame.clear();
+      _line.transmit(data, len);
+    }
+    uint64_t txDone() override { return _line.txDone(); }
+    uint64_t nextArrival() override { return _line.nextArrival(); }
+    size_t available() override { return _line.available(); }
+    uint8_t receive() override {
+      const uint8_t b = _line.receive();
+      frame.push_back(b);
+      return b;
+    }
+
+  private:
+    SerialLine& _line;
+};
+
+static std::vector<uint8_t> record(uint16_t model) {
+  Mycila::JSYSimulator bus;
+  bus.add(model, MYCILA_JSY_ADDRESS_DEFAULT);
+  Recorder recorder(bus);
+  Serial2.attach(&recorder);
+
+  Mycila::JSY jsy;
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::UNKNOWN, MYCILA_JSY_ADDRESS_DEFAULT, model);
+  // let the simulated device accumulate some energy
+  NativeClock::advance(3600000000ULL);
+  const bool success = jsy.read();
+  jsy.end();
+  Serial2.attach(nullptr);
+
+  return success ? recorder.frame : std::vector<uint8_t>();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// benchmark
+///////////////////////////////////////////////////////////////////////////////
+
+struct Result {
+    double ns;
+    double allocs;
+};
+
+static std::map<std::string, Result> results;
+
+// keeps the compiler from optimizing a result away
+static volatile uint32_t sink;
+
+template <typename F>
+static void bench(const std::string& name, F&& op) {
+  using clock = std::chrono::steady_clock;
+
+  // warm up and calibration
+  uint64_t iterations = 1;
+  while (true) {
+    const auto start = clock::now();
+    for (uint64_t i = 0; i < iterations; i++)
+      op();
+    const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    if (elapsed >= BENCH_MIN_TIME_NS / 10)
+      break;
+    iterations *= 2;
+  }
+  iterations *= 10;
+
+  const uint64_t allocated = allocations;
+  const auto start = clock::now();
+  for (uint64_t i = 0; i < iterations; i++)
+    op();
+  const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+
+  Result result;
+  result.ns = static_cast<double>(elapsed) / iterations;
+  result.allocs = static_cast<double>(allocations - allocated) / iterations;
+  results[name] = result;
+  Serial.printf("%-32s %12.1f ns/op %8.2f allocs/op\n", name.c_str(), result.ns, result.allocs);
+}
+
+static int compare(const char* path, double tolerance) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    Serial.printf("Baseline %s not found\n", path);
+    return 1;
+  }
+  Serial.printf("\nComparison with %s (tolerance: %.0f%%):\n", path, tolerance);
+  int regressions = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char name[64];
+    Result baseline;
+    if (sscanf(line, "%63s %lf ns/op %lf allocs/op", name, &baseline.ns, &baseline.allocs) != 3)
+      continue;
+    auto it = results.find(name);
+    if (it == results.end())
+      continue;
+    const Result& result = it->second;
+    const double change = baseline.ns > 0 ? (result.ns - baseline.ns) * 100 / baseline.ns : 0;
+    const bool regression = change > tolerance || result.allocs > baseline.allocs;
+    Serial.printf("%-32s %+8.1f%% %8.2f -> %.2f allocs/op%s\n", name, change, baseline.allocs, result.allocs, regression ? "  REGRESSION" : "");
+    regressions += regression;
+  }
+  fclose(file);
+  return regressions ? 1 : 0;
+}
+
+int main() {
+  for (uint16_t model : models) {
+    const std::vector<uint8_t> frame = record(model);
+    if (frame.empty()) {
+      Serial.printf("%s: no frame recorded\n", Mycila::JSY::getModelName(model));
+      return 1;
+    }
+
+    Mycila::JSY::Data data;
+    if (!Mycila::JSY::decode(model, frame.data(), frame.size(), data)) {
+      Serial.printf("%s: invalid frame recorded\n", Mycila::JSY::getModelName(model));
+      return 1;
+    }
+
+    const std::string prefix = std::string(Mycila::JSY::getModelName(model)) + "/";
+
+    bench(prefix + "crc16", [&]() {
+      sink = Mycila::JSY::crc16(frame.data(), frame.size() - 2);
+    });
+
+    bench(prefix + "decode", [&]() {
+      sink = Mycila::JSY::decode(model, frame.data(), frame.size(), data);
+    });
+
+    Mycila::JSY::Data copy;
+    copy = data;
+    bench(prefix + "Metrics::operator==", [&]() {
+      sink = data.aggregate == copy.aggregate;
+    });
+
+    bench(prefix + "Metrics::operator+=", [&]() {
+      copy.aggregate = data.channel(0);
+      copy.aggregate += data.channel(1);
+      sink = copy.aggregate.activeEnergy;
+    });
+
+    bench(prefix + "Data::operator=", [&]() {
+      copy = data;
+      sink = copy.model;
+    });
+
+    char json[4096];
+    bench(prefix + "Data::toJson(char*)", [&]() {
+      sink = data.toJson(json, sizeof(json));
+    });
+
+#ifdef MYCILA_JSON_SUPPORT
+    bench(prefix + "Data::toJson(JsonObject)", [&]() {
+      JsonDocument doc(&jsonAllocator);
+      data.toJson(doc.to<JsonObject>());
+      sink = doc.size();
+    });
+#endif
+  }
+
+  const char* baseline = getenv("MYCILA_JSY_BENCH_BASELINE");
+  if (baseline) {
+    const char* tolerance = getenv("MYCILA_JSY_BENCH_TOLERANCE");
+    return compare(baseline, tolerance ? atof(tolerance) : 20);
+  }
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+// Host-side performance test running against a simulated JSY bus.
+// Build and run with: PLATFORMIO_SRC_DIR=examples/PerfTestNative pio run -e native -t exec
+//
+// Time is simulated: the reported latencies are what a real UART at the same baud rate would give,
+// with the turnaround delays measured on real devices.
+#include <MycilaJSY.h>
+#include <MycilaJSYSimulator.h>
+
+#define READ_COUNT 50
+
+static constexpr uint16_t models[] = {
+  MYCILA_JSY_MK_1031,
+  MYCILA_JSY_MK_163,
+  MYCILA_JSY_MK_193,
+  MYCILA_JSY_MK_194,
+  MYCILA_JSY_MK_227,
+  MYCILA_JSY_MK_229,
+  MYCILA_JSY_MK_333,
+};
+
+static constexpr Mycila::JSY::BaudRate rates[] = {
+  Mycila::JSY::BaudRate::BAUD_1200,
+  Mycila::JSY::BaudRate::BAUD_2400,
+  Mycila::JSY::BaudRate::BAUD_4800,
+  Mycila::JSY::BaudRate::BAUD_9600,
+  Mycila::JSY::BaudRate::BAUD_19200,
+  Mycila::JSY::BaudRate::BAUD_38400,
+};
+
+int main() {
+  for (uint16_t model : models) {
+    for (Mycila::JSY::BaudRate rate : rates) {
+      if (!Mycila::JSY::isBaudRateSupported(model, rate))
+        continue;
+
+      Mycila::JSYSimulator bus;
+      bus.add(model, MYCILA_JSY_ADDRESS_DEFAULT, rate);
+      Serial2.attach(&bus);
+
+      Mycila::JSY jsy;
+
+      int64_t start = esp_timer_get_time();
+      jsy.begin(Serial2, RX2, TX2);
+      int64_t beginTime = esp_timer_get_time() - start;
+
+      int64_t min = INT64_MAX;
+      int64_t max = 0;
+      int64_t sum = 0;
+      size_t errors = 0;
+      uint64_t bytes = bus.getTxBytes() + bus.getRxBytes();
+
+      start = esp_timer_get_time();
+      for (size_t i = 0; i < READ_COUNT; i++) {
+        int64_t t = esp_timer_get_time();
+        if (!jsy.read()) {
+          errors++;
+          continue;
+        }
+        t = esp_timer_get_time() - t;
+        sum += t;
+        min = std::min(min, t);
+        max = std::max(max, t);
+      }
+      int64_t elapsed = esp_timer_get_time() - start;
+      bytes = bus.getTxBytes() + bus.getRxBytes() - bytes;
+
+      size_t n = READ_COUNT - errors;
+      Serial.printf("%s at %" PRIu32 " bauds:\n", Mycila::JSY::getModelName(model), static_cast<uint32_t>(rate));
+      Serial.printf(" - begin() time: %" PRId64 " us\n", beginTime);
+      Serial.printf(" - Errors: %zu\n", errors);
+      Serial.printf(" - Average read time: %" PRId64 " us\n", n ? sum / static_cast<int64_t>(n) : 0);
+      Serial.printf(" - Min read time: %" PRId64 " us\n", n ? min : 0);
+      Serial.printf(" - Max read time: %" PRId64 " us\n", max);
+      Serial.printf(" - Throughput: %.2f reads/s, %.0f bytes/s\n", n * 1e6 / elapsed, bytes * 1e6 / elapsed);
+
+      jsy.end();
+      Serial2.attach(nullptr);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,297 @@
+// Host-side check of the persisted formats, running against a simulated JSY bus: exits with 1 when a check fails.
+// Build and run with: PLATFORMIO_SRC_DIR=examples/PersistNative pio run -e native -t exec
+//
+// - energy totals (JSYEnergy::setStorage()): continuity across a reboot and resetEnergy(), slot rotation, sequence wraparound and fallback on a torn record
+// - device profile (JSY::setProfileStorage()): reused at the next begin() and not written again when unchanged
+// - binary codec (JSYBinary): bit-exact round trip of the measured values
+#include <MycilaJSY.h>
+#include <MycilaJSYBinary.h>
+#include <MycilaJSYEnergy.h>
+#include <MycilaJSYSimulator.h>
+#include <MycilaJSYStorage.h>
+
+#include <cfloat>
+#include <map>
+#include <string>
+#include <vector>
+
+// energy record layout: version, totals mask, model, sequence (LE) at 4, ..., CRC16 (LE) on the last 2 bytes
+#define ENERGY_RECORD_SIZE     138
+#define ENERGY_RECORD_SEQUENCE 4
+
+// a storage in RAM, surviving the JSY and JSYEnergy instances like a flash would survive a reboot
+class MemoryStorage : public Mycila::JSYStorage {
+  public:
+    size_t read(const char* key, void* buffer, size_t size) override {
+      auto it = records.find(key);
+      if (it == records.end() || it->second.size() > size)
+        return 0;
+      memcpy(buffer, it->second.data(), it->second.size());
+      return it->second.size();
+    }
+
+    bool write(const char* key, const void* data, size_t len) override {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      records[key].assign(bytes, bytes + len);
+      writes[key]++;
+      last = key;
+      return true;
+    }
+
+    bool remove(const char* key) override { return records.erase(key) > 0; }
+
+    std::map<std::string, std::vector<uint8_t>> records;
+    std::map<std::string, size_t> writes;
+    std::string last; // key of the last record written
+};
+
+static size_t failures = 0;
+
+static void check(bool ok, const char* what) {
+  Serial.printf(" - %s: %s\n", ok ? "OK" : "FAIL", what);
+  if (!ok)
+    failures++;
+}
+
+static void readFor(Mycila::JSY& jsy, uint32_t seconds) {
+  for (uint32_t i = 0; i < seconds; i++) {
+    jsy.read();
+    delay(1000);
+  }
+}
+
+static uint64_t total(const Mycila::JSYEnergy& energy) {
+  return energy.getTotal(Mycila::JSY::FIELD_ACTIVE_ENERGY_IMPORTED, 0);
+}
+
+// rewrites the sequence number of an energy record and its CRC
+static void setSequence(std::vector<uint8_t>& record, uint32_t sequence) {
+  for (size_t i = 0; i < 4; i++)
+    record[ENERGY_RECORD_SEQUENCE + i] = sequence >> (8 * i);
+  const uint16_t crc = Mycila::JSY::crc16(record.data(), record.size() - 2);
+  record[record.size() - 2] = crc;
+  record[record.size() - 1] = crc >> 8;
+}
+
+static void checkEnergy() {
+  Serial.printf("Energy totals:\n");
+
+  Mycila::JSYSimulator bus;
+  Mycila::JSYSimulator::Device& device = bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_4800);
+  Serial2.attach(&bus);
+  MemoryStorage storage;
+  uint64_t saved;
+
+  // first boot: nothing to restore, the device counter is reset while running
+  {
+    Mycila::JSY jsy;
+    Mycila::JSYEnergy energy;
+    check(!energy.setStorage(&storage), "nothing restored at the first boot");
+    jsy.setEnergy(&energy);
+    jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_4800, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+    readFor(jsy, 600);
+    const uint64_t before = total(energy);
+    check(before > 0, "total counted");
+    check(jsy.resetEnergy(), "device counters reset");
+    check(device.activeEnergyImported[0] * 1000 < before, "device counter dropped");
+    readFor(jsy, 600);
+    check(total(energy) > before, "total continues after resetEnergy()");
+    jsy.end();
+    saved = total(energy);
+    check(storage.last == "jsy_energy" + std::to_string(energy.getWrites() % MYCILA_JSY_ENERGY_SLOTS), "totals written at end()");
+  }
+
+  // the device keeps counting while the ESP32 is off
+  NativeClock::advance(600000000ULL);
+
+  // second boot: the totals continue, the records rotate through the slots
+  std::string previous;
+  uint64_t previousTotal;
+  {
+    Mycila::JSY jsy;
+    Mycila::JSYEnergy energy;
+    check(energy.setStorage(&storage), "totals restored after a reboot");
+    check(total(energy) == saved, "restored total equals the saved one");
+    jsy.setEnergy(&energy);
+    jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_4800, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+    readFor(jsy, 60);
+    check(total(energy) > saved, "energy counted while off is added");
+
+    bool rotated = true;
+    for (size_t i = 0; i < MYCILA_JSY_ENERGY_SLOTS + 1; i++) {
+      const std::string last = storage.last;
+      readFor(jsy, 10);
+      previousTotal = total(energy);
+      energy.flush();
+      rotated &= storage.last != last;
+    }
+    check(rotated, "each record written in the next slot");
+    check(storage.records.size() == MYCILA_JSY_ENERGY_SLOTS, "records kept in MYCILA_JSY_ENERGY_SLOTS slots");
+    previous = storage.last;
+    readFor(jsy, 10);
+    jsy.end();
+    saved = total(energy);
+  }
+
+  // torn write of the latest record: the previous one is restored
+  {
+    Mycila::JSYEnergy energy;
+    energy.setStorage(&storage);
+    check(total(energy) == saved, "latest record restored");
+  }
+  storage.records[storage.last][20] ^= 0x55;
+  {
+    Mycila::JSYEnergy energy;
+    check(energy.setStorage(&storage), "totals restored from a previous record");
+    check(total(energy) == previousTotal, "corrupted latest slot falls back to the previous one");
+  }
+
+  // sequence wraparound: the record numbered 0 follows the older ones numbered up to 0xFFFFFFFF
+  storage.records.erase(storage.last);
+  uint32_t sequence = 0xFFFFFFFD;
+  for (auto& record : storage.records)
+    if (record.first != previous)
+      setSequence(record.second, sequence++);
+  check(storage.records[previous].size() == ENERGY_RECORD_SIZE, "record size");
+  setSequence(storage.records[previous], 0);
+  {
+    Mycila::JSYEnergy energy;
+    check(energy.setStorage(&storage), "totals restored across the wraparound");
+    check(total(energy) == previousTotal, "record numbered 0 wins over 0xFFFFFFFF");
+    energy.clear();
+    check(storage.last == "jsy_energy1", "next record numbered 1");
+  }
+
+  Serial2.attach(nullptr);
+}
+
+static void checkProfile() {
+  Serial.printf("Device profile:\n");
+
+  Mycila::JSYSimulator bus;
+  bus.add(MYCILA_JSY_MK_333, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_9600);
+  Serial2.attach(&bus);
+  MemoryStorage storage;
+  Mycila::JSY::Profile profile;
+
+  {
+    Mycila::JSY jsy;
+    jsy.setProfileStorage(&storage);
+    jsy.begin(Serial2, RX2, TX2);
+    profile = jsy.getProfile();
+    check(jsy.isEnabled() && profile.model == MYCILA_JSY_MK_333 && profile.baudRate == Mycila::JSY::BaudRate::BAUD_9600, "device detected");
+    check(storage.writes["jsy_profile"] == 1, "profile written");
+    jsy.end();
+  }
+
+  {
+    Mycila::JSY jsy;
+    jsy.setProfileStorage(&storage);
+    const int64_t start = esp_timer_get_time();
+    jsy.begin(Serial2, RX2, TX2);
+    const int64_t elapsed = esp_timer_get_time() - start;
+    check(jsy.isEnabled() && jsy.getProfile().model == profile.model && jsy.getProfile().baudRate == profile.baudRate, "profile reused at the next begin()");
+    check(elapsed < 1000000, "detection skipped");
+    check(storage.writes["jsy_profile"] == 1, "unchanged profile not written again");
+    jsy.end();
+  }
+
+  {
+    Mycila::JSY jsy;
+    jsy.setProfileStorage(&storage);
+    jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_9600, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_333);
+    check(jsy.isEnabled(), "begin() with the baud rate and the model");
+    check(storage.writes["jsy_profile"] == 1, "profile not written again with a forced baud rate");
+    jsy.end();
+  }
+
+  storage.records["jsy_profile"][1] ^= 0x55;
+  {
+    Mycila::JSY jsy;
+    jsy.setProfileStorage(&storage);
+    jsy.begin(Serial2, RX2, TX2);
+    check(jsy.isEnabled() && jsy.getProfile().model == MYCILA_JSY_MK_333, "corrupted profile: device detected again");
+    check(storage.writes["jsy_profile"] == 2, "corrupted profile rewritten");
+    jsy.end();
+  }
+
+  Serial2.attach(nullptr);
+}
+
+// the values computed by the library (i.e. the aggregates of the JSY-MK-194) are rounded to the resolution of their field, within the precision of a float
+static bool rounded(const Mycila::JSY::Data& decoded, const Mycila::JSY::Data& data) {
+  const Mycila::JSY::Metrics* a[] = {&decoded.channel(0), &decoded.channel(1), &decoded.phase(2), &decoded.aggregate};
+  const Mycila::JSY::Metrics* b[] = {&data.channel(0), &data.channel(1), &data.phase(2), &data.aggregate};
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t i = 0; i < Mycila::JSY::FIELD_COUNT; i++) {
+      const Mycila::JSY::FieldTarget& f = Mycila::JSY::FIELD_TARGETS[i];
+      if (!f.real || std::isnan(b[c]->*f.real))
+        continue;
+      const float value = b[c]->*f.real;
+      const float tolerance = Mycila::JSY::getResolution(data.model, 1UL << i) / 2 + std::abs(value) * FLT_EPSILON;
+      if (!(std::abs(a[c]->*f.real - value) <= tolerance))
+        return false;
+    }
+  }
+  return true;
+}
+
+static void checkBinary(uint16_t model, bool measured) {
+  Mycila::JSYSimulator bus;
+  bus.add(model, MYCILA_JSY_ADDRESS_DEFAULT);
+  Serial2.attach(&bus);
+
+  Mycila::JSY jsy;
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::UNKNOWN, MYCILA_JSY_ADDRESS_DEFAULT, model);
+
+  Mycila::JSYBinary::Encoder encoder;
+  Mycila::JSYBinary::Decoder decoder;
+  Mycila::JSYBinary::Encoder reencoder;
+  Mycila::JSYBinary::Decoder redecoder;
+  Mycila::JSY::Snapshot snapshot;
+  uint8_t frame[Mycila::JSYBinary::MAX_FRAME_SIZE];
+  size_t frames = 0;
+  size_t exact = 0;
+  size_t stable = 0;
+  for (size_t i = 0; i < 50; i++) {
+    delay(1000);
+    if (!jsy.read() || !jsy.getSnapshot(snapshot))
+      continue;
+    const Mycila::JSY::Data& data = snapshot.data;
+    Mycila::JSY::Data decoded;
+    size_t len = encoder.encode(data, frame, sizeof(frame));
+    if (!len || !decoder.decode(frame, len, decoded))
+      continue;
+    frames++;
+    exact += measured ? decoded == data : rounded(decoded, data);
+    // the computed values are rounded to the resolution by the first encoding only
+    Mycila::JSY::Data again;
+    len = reencoder.encode(decoded, frame, sizeof(frame));
+    stable += len && redecoder.decode(frame, len, again) && again == decoded;
+  }
+  jsy.end();
+  Serial2.attach(nullptr);
+
+  char what[64];
+  snprintf(what, sizeof(what), "%s frames decoded", Mycila::JSY::getModelName(model));
+  check(frames > 40, what);
+  snprintf(what, sizeof(what), measured ? "%s decoded bit-exact" : "%s decoded to the resolution", Mycila::JSY::getModelName(model));
+  check(exact == frames, what);
+  snprintf(what, sizeof(what), "%s round trip stable", Mycila::JSY::getModelName(model));
+  check(stable == frames, what);
+}
+
+int main() {
+  checkEnergy();
+  checkProfile();
+
+  Serial.printf("Binary codec:\n");
+  // all the values of these models are read from the device
+  for (uint16_t model : {MYCILA_JSY_MK_1031, MYCILA_JSY_MK_227, MYCILA_JSY_MK_229})
+    checkBinary(model, true);
+  for (uint16_t model : {MYCILA_JSY_MK_163, MYCILA_JSY_MK_193, MYCILA_JSY_MK_194, MYCILA_JSY_MK_333})
+    checkBinary(model, false);
+
+  Serial.printf("%zu failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
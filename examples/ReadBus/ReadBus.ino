@@ -0,0 +1,64 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <MycilaJSYBus.h>
+
+#ifndef SOC_UART_HP_NUM
+  #define SOC_UART_HP_NUM SOC_UART_NUM
+#endif
+#if SOC_UART_HP_NUM < 3
+  #define Serial2 Serial1
+  #define RX2     RX1
+  #define TX2     TX1
+#endif
+
+static Mycila::JSYBus bus;
+
+void setup() {
+  Serial.begin(115200);
+#if ARDUINO_USB_CDC_ON_BOOT
+  Serial.setTxTimeoutMs(0);
+  delay(100);
+#else
+  while (!Serial)
+    yield();
+#endif
+
+  // 2 x JSY-MK-194 and 1 x JSY-MK-333 on the same RS485 segment, all at the same speed
+  bus.add(0x01, MYCILA_JSY_MK_194);
+  bus.add(0x02, MYCILA_JSY_MK_194);
+  // model will be read once at begin()
+  bus.add(0x03, MYCILA_JSY_MK_UNKNOWN, [](const Mycila::JSY::EventType event, const Mycila::JSY::Data& data) {
+    if (event == Mycila::JSY::EventType::EVT_READ)
+      Serial.printf("Grid power: %f W\n", data.aggregate.activePower);
+  });
+
+  bus.setCallback([](const Mycila::JSY::EventType event, const Mycila::JSY::Data& data) {
+    if (event == Mycila::JSY::EventType::EVT_READ) {
+      JsonDocument doc;
+      data.toJson(doc.to<JsonObject>());
+      serializeJson(doc, Serial);
+      Serial.println();
+    }
+  });
+
+  // read JSY devices on pins 17 (JSY RX / Serial TX) and 16 (JSY TX / Serial RX)
+  // baud rate will be detected automatically with the first registered device
+  bus.begin(Serial2, RX2, TX2);
+}
+
+void loop() {
+  // one request per device
+  bus.read();
+
+  JsonDocument doc;
+  bus.toJson(doc.to<JsonObject>());
+  for (JsonObject device : doc["devices"].as<JsonArray>()) {
+    Serial.printf("JSY @ 0x%02X: %" PRIu32 " reads, %" PRIu32 " errors, %.2f reads/s\n",
+                  device["address"].as<uint8_t>(),
+                  device["reads"].as<uint32_t>(),
+                  device["errors"].as<uint32_t>(),
+                  device["sample_rate"].as<float>());
+  }
+
+  delay(1000);
+}
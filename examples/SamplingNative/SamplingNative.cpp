@@ -0,0 +1,431 @@
+// Host-side check of the sampling features, running against a simulated JSY bus: exits with 1 when a check fails.
+// Build and run with: PLATFORMIO_SRC_DIR=examples/SamplingNative pio run -e native -t exec
+//
+// Time is simulated, so the results are the same at each run:
+// - history (JSYHistory): samples dropped when the ring wraps around, cursor resumed after a drop, absolute time after a gap of more than 65 s
+// - statistics (JSYStats): buckets merged with Chan's algorithm against the statistics of the samples, buckets expired after their window
+// - deadbands (JSY::setDeadband(), JSY::setMaxSilence()): reads notified only when they moved beyond the deadband, heartbeat after the max silence
+// - baud rate tuning (JSY::setBaudRateTuning()): step down on a noisy line, step up after the quiet period on a clean line
+// - fixed rate sampling (JSY::setPeriod()): no overrun when the reads fit in the period, overruns counted as the slots skipped otherwise
+#include <MycilaJSY.h>
+#include <MycilaJSYHistory.h>
+#include <MycilaJSYSimulator.h>
+#include <MycilaJSYStats.h>
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+static size_t failures = 0;
+
+static void check(bool ok, const char* what) {
+  Serial.printf(" - %s: %s\n", ok ? "OK" : "FAIL", what);
+  if (!ok)
+    failures++;
+}
+
+// a sample read from the simulated device, at a time given by the check
+struct Sample {
+    uint32_t time;
+    Mycila::JSY::Data data;
+};
+
+static void readSamples(Mycila::JSY& jsy, Sample* samples, size_t count, uint32_t time, uint32_t interval) {
+  Mycila::JSY::Snapshot snapshot;
+  for (size_t i = 0; i < count; time += interval) {
+    if (jsy.read() && jsy.getSnapshot(snapshot)) {
+      samples[i].time = time;
+      samples[i++].data = snapshot.data;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JSYHistory
+///////////////////////////////////////////////////////////////////////////////
+
+#define HISTORY_SAMPLES 200
+
+// the cursor returns these samples, in order and unchanged
+static bool sameSamples(Mycila::JSYHistory::Cursor cursor, const Sample* samples, size_t count) {
+  uint32_t time;
+  Mycila::JSY::Data data;
+  size_t i = 0;
+  while (cursor.next(time, data)) {
+    if (i == count || time != samples[i].time || data != samples[i].data)
+      return false;
+    i++;
+  }
+  return i == count;
+}
+
+static void checkHistory() {
+  Serial.printf("History:\n");
+
+  Mycila::JSYSimulator bus;
+  bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_9600);
+  Serial2.attach(&bus);
+  Mycila::JSY jsy;
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_9600, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+  static Sample samples[HISTORY_SAMPLES];
+  readSamples(jsy, samples, HISTORY_SAMPLES, 1000, 50);
+  jsy.end();
+  Serial2.attach(nullptr);
+
+  static Mycila::JSYStaticHistory<4096> history;
+
+  // the ring wraps around: the oldest samples are dropped
+  for (size_t i = 0; i < 20; i++)
+    history.add(samples[i].data, samples[i].time);
+  check(history.getDropCount() == 0, "20 samples stored");
+  check(sameSamples(history.all(), samples, 20), "20 samples read back");
+
+  // a cursor in the middle of the samples when the writer drops them, over a range including the next samples
+  Mycila::JSYHistory::Cursor cursor = history.range(samples[0].time, samples[HISTORY_SAMPLES - 1].time);
+  uint32_t time;
+  Mycila::JSY::Data data;
+  cursor.next(time, data);
+  cursor.next(time, data);
+
+  for (size_t i = 20; i < HISTORY_SAMPLES; i++)
+    history.add(samples[i].data, samples[i].time);
+  const size_t kept = history.size();
+  const Sample* oldest = samples + HISTORY_SAMPLES - kept;
+  check(history.getDropCount() > 0 && history.getDropCount() + kept == HISTORY_SAMPLES, "oldest samples dropped");
+  check(history.getOldestTime() == oldest->time && history.getNewestTime() == samples[HISTORY_SAMPLES - 1].time, "oldest and newest times");
+  check(sameSamples(history.all(), oldest, kept), "samples kept read back");
+  check(sameSamples(cursor, oldest, kept), "cursor resumed from the oldest sample kept");
+
+  // the time of a sample after a gap of more than 65 s is stored in full
+  history.clear();
+  for (size_t i = 0; i < 10; i++) {
+    samples[i].time += static_cast<uint32_t>(i / 3) * 70000;
+    history.add(samples[i].data, samples[i].time);
+  }
+  check(sameSamples(history.all(), samples, 10), "times after gaps of 70 s");
+  check(sameSamples(history.range(samples[3].time, samples[8].time), samples + 3, 6), "range across the gaps");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JSYStats
+///////////////////////////////////////////////////////////////////////////////
+
+#define STATS_SAMPLES 400
+
+static bool near(double value, double expected) {
+  return std::fabs(value - expected) <= 1e-3 * std::max(1.0, std::fabs(expected));
+}
+
+static float value(const Sample& sample, uint32_t field, uint8_t channel) {
+  const Mycila::JSY::Metrics& metrics = channel == Mycila::JSYStats::AGGREGATE ? sample.data.aggregate : sample.data.channel(channel);
+  return metrics.*Mycila::JSY::FIELD_TARGETS[__builtin_ctz(field)].real;
+}
+
+// the statistics of the window match the ones computed from the samples of its buckets not expired
+static bool sameStat(const Mycila::JSYStats& stats, size_t window, uint32_t field, uint8_t channel, const Sample* samples, size_t count) {
+  const Mycila::JSYStats::Stat stat = stats.get(window, field, channel);
+  const uint32_t bucketDuration = stats.getWindow(window) / MYCILA_JSY_STATS_BUCKETS;
+  const uint32_t epoch = millis() / bucketDuration;
+
+  size_t n = 0;
+  double sum = 0;
+  float min = NAN;
+  float max = NAN;
+  for (size_t i = 0; i < count; i++) {
+    if (epoch - samples[i].time / bucketDuration >= MYCILA_JSY_STATS_BUCKETS)
+      continue;
+    const float v = value(samples[i], field, channel);
+    sum += v;
+    min = n ? std::min(min, v) : v;
+    max = n ? std::max(max, v) : v;
+    n++;
+  }
+  if (!n)
+    return stat.count == 0;
+  const double mean = sum / n;
+  double m2 = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (epoch - samples[i].time / bucketDuration < MYCILA_JSY_STATS_BUCKETS)
+      m2 += (value(samples[i], field, channel) - mean) * (value(samples[i], field, channel) - mean);
+  }
+  return stat.count == n && near(stat.mean, mean) && near(stat.variance, m2 / n) && stat.min == min && stat.max == max;
+}
+
+static void checkStats() {
+  Serial.printf("Stats:\n");
+
+  Mycila::JSYSimulator bus;
+  bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_38400);
+  Serial2.attach(&bus);
+  Mycila::JSY jsy;
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_38400, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+  static Sample samples[STATS_SAMPLES];
+  readSamples(jsy, samples, STATS_SAMPLES, 0, 50);
+  jsy.end();
+  Serial2.attach(nullptr);
+
+  // 20 s of samples from now, then the simulated clock is moved to the last one
+  const uint32_t start = millis();
+  for (size_t i = 0; i < STATS_SAMPLES; i++)
+    samples[i].time += start;
+
+  static Mycila::JSYStats stats;
+  stats.setFields(Mycila::JSY::FIELD_ACTIVE_POWER | Mycila::JSY::FIELD_VOLTAGE);
+  for (size_t i = 0; i < STATS_SAMPLES; i++)
+    stats.add(samples[i].data, samples[i].time);
+  delay(samples[STATS_SAMPLES - 1].time - millis());
+
+  // 1 s, 10 s and 60 s windows: the last 20, 200 and all the samples
+  bool merged = true;
+  for (size_t w = 0; w < MYCILA_JSY_STATS_WINDOWS; w++)
+    for (uint8_t c : {static_cast<uint8_t>(0), static_cast<uint8_t>(1), Mycila::JSYStats::AGGREGATE})
+      merged = merged && sameStat(stats, w, Mycila::JSY::FIELD_ACTIVE_POWER, c, samples, STATS_SAMPLES) && sameStat(stats, w, Mycila::JSY::FIELD_VOLTAGE, c, samples, STATS_SAMPLES);
+  check(merged, "buckets merged as the samples of the windows");
+  check(stats.get(2, Mycila::JSY::FIELD_ACTIVE_POWER).count == STATS_SAMPLES, "60 s window holding all the samples");
+
+  // the buckets expire with the time, without new samples
+  delay(stats.getWindow(0));
+  check(stats.get(0, Mycila::JSY::FIELD_ACTIVE_POWER).count == 0 && stats.get(1, Mycila::JSY::FIELD_ACTIVE_POWER).count > 0, "1 s window expired");
+  check(sameStat(stats, 1, Mycila::JSY::FIELD_ACTIVE_POWER, Mycila::JSYStats::AGGREGATE, samples, STATS_SAMPLES), "10 s window sliding");
+  delay(stats.getWindow(2));
+  check(stats.get(2, Mycila::JSY::FIELD_ACTIVE_POWER).count == 0, "60 s window expired");
+
+  // an expired bucket is reused for a new sample
+  samples[0].time = millis();
+  stats.add(samples[0].data, samples[0].time);
+  check(sameStat(stats, 0, Mycila::JSY::FIELD_ACTIVE_POWER, Mycila::JSYStats::AGGREGATE, samples, 1) && stats.get(2, Mycila::JSY::FIELD_ACTIVE_POWER).count == 1, "expired bucket reused");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Deadbands
+///////////////////////////////////////////////////////////////////////////////
+
+#define DEADBAND_READS 300
+
+// the active power of a channel or the aggregate moved beyond the deadband
+static bool moved(const Mycila::JSY::Data& data, const Mycila::JSY::Data& reference, float deadband) {
+  const Mycila::JSY::Metrics* metrics[] = {&data.channel(0), &data.channel(1), &data.aggregate};
+  const Mycila::JSY::Metrics* references[] = {&reference.channel(0), &reference.channel(1), &reference.aggregate};
+  for (size_t c = 0; c < 3; c++)
+    if (std::fabs(metrics[c]->activePower - references[c]->activePower) > deadband)
+      return true;
+  return false;
+}
+
+static void checkDeadbands() {
+  Serial.printf("Deadbands:\n");
+
+  Mycila::JSYSimulator bus;
+  bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_38400);
+  Serial2.attach(&bus);
+  Mycila::JSY jsy;
+
+  size_t notifications = 0;
+  uint32_t changed = 0;
+  uint32_t notifiedTime = 0;
+  static Mycila::JSY::Data notified;
+  jsy.setChangeCallback([&](Mycila::JSY::EventType eventType, const Mycila::JSY::Data& data, uint32_t fields) {
+    if (eventType != Mycila::JSY::EventType::EVT_READ)
+      return;
+    notifications++;
+    changed = fields;
+    notifiedTime = millis();
+    notified = data;
+  });
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_38400, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+
+  // each read is notified if and only if the active power moved by more than 5 W since the last notified read
+  jsy.setDeadband(Mycila::JSY::FIELD_ACTIVE_POWER, 5);
+  static Mycila::JSY::Data reference;
+  Mycila::JSY::Snapshot snapshot;
+  size_t notifiedReads = 0;
+  bool filtered = true;
+  for (size_t i = 0; i < DEADBAND_READS; i++) {
+    const size_t before = notifications;
+    if (!jsy.read() || !jsy.getSnapshot(snapshot)) {
+      filtered = false;
+      continue;
+    }
+    if (notifications == before) {
+      filtered = filtered && !moved(snapshot.data, reference, 5);
+    } else {
+      filtered = filtered && notified == snapshot.data && (!i || (moved(snapshot.data, reference, 5) && (changed & Mycila::JSY::FIELD_ACTIVE_POWER)));
+      reference = snapshot.data;
+      notifiedReads++;
+    }
+    delay(50);
+  }
+  check(filtered, "reads notified when the active power moved beyond 5 W");
+  check(notifiedReads > 1 && notifiedReads < DEADBAND_READS, "some reads filtered");
+
+  // with a deadband never reached, a read is notified every 2 s
+  jsy.setDeadband(Mycila::JSY::FIELD_ACTIVE_POWER, 1e9);
+  jsy.setMaxSilence(2000);
+  uint32_t last = notifiedTime;
+  uint32_t interval = 0;
+  size_t heartbeats = 0;
+  bool silent = true;
+  for (size_t i = 0; i < DEADBAND_READS; i++) {
+    const size_t before = notifications;
+    const uint32_t start = millis();
+    jsy.read();
+    delay(50);
+    interval = std::max(interval, millis() - start);
+    if (notifications != before) {
+      silent = silent && notifiedTime - last >= 2000 && notifiedTime - last < 2000 + interval;
+      last = notifiedTime;
+      heartbeats++;
+    }
+  }
+  check(silent, "reads notified every 2 s without change");
+  check(heartbeats >= 5, "heartbeats sent");
+
+  jsy.end();
+  Serial2.attach(nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Baud rate tuning
+///////////////////////////////////////////////////////////////////////////////
+
+// corrupts the bytes received at or above a baud rate, with a seeded generator so that the errors are the same at each run
+class NoisyLine : public SerialLine {
+  public:
+    NoisyLine(SerialLine& line, float probability) : _line(line), _probability(probability) {}
+
+    void setNoisyFrom(uint32_t baudRate) { _noisyFrom = baudRate; }
+
+    void open(uint32_t baudRate) override {
+      _baudRate = baudRate;
+      _line.open(baudRate);
+    }
+    void close() override { _line.close(); }
+    void transmit(const uint8_t* data, size_t len) override { _line.transmit(data, len); }
+    uint64_t txDone() override { return _line.txDone(); }
+    uint64_t nextArrival() override { return _line.nextArrival(); }
+    size_t available() override { return _line.available(); }
+    uint8_t receive() override {
+      uint8_t b = _line.receive();
+      if (_baudRate >= _noisyFrom && std::uniform_real_distribution<float>(0, 1)(_random) < _probability)
+        b ^= 0x10;
+      return b;
+    }
+
+  private:
+    SerialLine& _line;
+    const float _probability;
+    uint32_t _noisyFrom = UINT32_MAX;
+    uint32_t _baudRate = 0;
+    std::mt19937 _random{1};
+};
+
+static void checkTuning() {
+  Serial.printf("Tuning:\n");
+
+  Mycila::JSYSimulator bus;
+  Mycila::JSYSimulator::Device& device = bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_38400);
+  NoisyLine line(bus, 0.01);
+  Serial2.attach(&line);
+  Mycila::JSY jsy;
+  jsy.setBaudRateTuning(true);
+
+  // time of the last baud rate change, and whether each step up came after the quiet period since the previous change
+  uint32_t changeTime = 0;
+  size_t stepsUp = 0;
+  bool quiet = true;
+  uint32_t baudRate = Mycila::JSY::BaudRate::BAUD_38400;
+  jsy.setCallback([&](Mycila::JSY::EventType eventType, const Mycila::JSY::Data& data) {
+    (void)data;
+    if (eventType != Mycila::JSY::EventType::EVT_BAUD_RATE_CHANGE)
+      return;
+    if (jsy.getBaudRate() > baudRate) {
+      quiet = quiet && millis() - changeTime >= MYCILA_JSY_TUNING_QUIET_PERIOD_MS;
+      stepsUp++;
+    }
+    baudRate = jsy.getBaudRate();
+    changeTime = millis();
+  });
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_38400, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194);
+
+  // 1 % of the bytes corrupted at 19200 bauds and above
+  line.setNoisyFrom(Mycila::JSY::BaudRate::BAUD_19200);
+  uint32_t end = millis() + 60000;
+  while (millis() < end)
+    jsy.read();
+  check(jsy.getBaudRate() == Mycila::JSY::BaudRate::BAUD_9600 && device.baudRate == Mycila::JSY::BaudRate::BAUD_9600, "stepped down to 9600 bauds on a noisy line");
+
+  // clean line: one step up after each quiet period
+  line.setNoisyFrom(UINT32_MAX);
+  end = millis() + 2 * MYCILA_JSY_TUNING_QUIET_PERIOD_MS + 60000;
+  while (millis() < end)
+    jsy.read();
+  check(jsy.getBaudRate() == Mycila::JSY::BaudRate::BAUD_38400 && device.baudRate == Mycila::JSY::BaudRate::BAUD_38400, "stepped up to 38400 bauds on a clean line");
+  check(stepsUp == 2 && quiet, "one step up after each quiet period");
+
+  jsy.end();
+  Serial2.attach(nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fixed rate sampling
+///////////////////////////////////////////////////////////////////////////////
+
+#define SCHEDULER_READS 300
+
+static void checkScheduler() {
+  Serial.printf("Scheduler:\n");
+
+  Mycila::JSYSimulator bus;
+  bus.add(MYCILA_JSY_MK_194, MYCILA_JSY_ADDRESS_DEFAULT, Mycila::JSY::BaudRate::BAUD_38400);
+  Serial2.attach(&bus);
+  Mycila::JSY jsy;
+
+  // the schedules are taken and the period changed by the async task itself, at given reads, so that they do not depend on the host threads
+  size_t reads = 0;
+  Mycila::JSY::Schedule schedule100;
+  Mycila::JSY::Schedule scheduleReset;
+  Mycila::JSY::Schedule schedule30;
+  std::atomic<bool> done(false);
+  jsy.setCallback([&](Mycila::JSY::EventType eventType, const Mycila::JSY::Data& data) {
+    (void)data;
+    if (eventType != Mycila::JSY::EventType::EVT_READ || done)
+      return;
+    reads++;
+    if (reads == SCHEDULER_READS) {
+      schedule100 = jsy.getSchedule();
+      jsy.setPeriod(30);
+    } else if (reads == SCHEDULER_READS + 10) {
+      scheduleReset = jsy.getSchedule();
+    } else if (reads == 2 * SCHEDULER_READS) {
+      schedule30 = jsy.getSchedule();
+      done = true;
+    }
+  });
+  jsy.setPeriod(100);
+  jsy.begin(Serial2, RX2, TX2, Mycila::JSY::BaudRate::BAUD_38400, MYCILA_JSY_ADDRESS_DEFAULT, MYCILA_JSY_MK_194, true);
+  while (!done)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  jsy.end();
+  Serial2.attach(nullptr);
+
+  // the reads take less than 100 ms: one read per slot (a sample is counted when its read starts)
+  check(schedule100.samples == SCHEDULER_READS && schedule100.overruns == 0, "no overrun with a period of 100 ms");
+  check(std::fabs(schedule100.rate() - 10) < 0.01f, "10 reads per second");
+
+  // the reads take more than 30 ms: the slots passed during a read are skipped and counted
+  check(scheduleReset.samples == 10, "schedule reset by setPeriod()");
+  check(schedule30.overruns > 0, "overruns with a period of 30 ms");
+  check(schedule30.samples - 1 + schedule30.overruns == schedule30.elapsed / 30000, "one slot per read or overrun");
+}
+
+int main() {
+  checkHistory();
+  checkStats();
+  checkDeadbands();
+  checkTuning();
+  checkScheduler();
+
+  Serial.printf("%zu failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
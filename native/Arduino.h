@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+// Host-side stand-in for the subset of the Arduino / ESP32 core used by MycilaJSY.
+// Only used by the `native` PlatformIO environment: time is simulated (see NativeClock)
+// so that bus latencies measured on a Linux box match what a real UART would give.
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define ARDUINO_NATIVE 1
+
+///////////////////////////////////////////////////////////////////////////////
+// simulated clock
+///////////////////////////////////////////////////////////////////////////////
+
+// Virtual time in microseconds.
+// Blocking calls (delay, Serial reads, ...) advance it instead of sleeping so that runs are fast and deterministic.
+class NativeClock {
+  public:
+    static uint64_t now() { return _now.load(); }
+
+    // move the clock forward to the given time (never backward)
+    static void advanceTo(uint64_t us) {
+      uint64_t current = _now.load();
+      while (current < us && !_now.compare_exchange_weak(current, us)) {
+      }
+    }
+
+    static void advance(uint64_t us) { _now.fetch_add(us); }
+
+    static void reset() { _now.store(0); }
+
+  private:
+    static inline std::atomic<uint64_t> _now{0};
+};
+
+inline uint32_t millis() { return static_cast<uint32_t>(NativeClock::now() / 1000); }
+inline uint32_t micros() { return static_cast<uint32_t>(NativeClock::now()); }
+inline int64_t esp_timer_get_time() { return static_cast<int64_t>(NativeClock::now()); }
+inline void yield() { std::this_thread::yield(); }
+inline void delay(uint32_t ms) {
+  NativeClock::advance(static_cast<uint64_t>(ms) * 1000);
+  std::this_thread::yield();
+}
+inline void delayMicroseconds(uint32_t us) { NativeClock::advance(us); }
+
+///////////////////////////////////////////////////////////////////////////////
+// logging
+///////////////////////////////////////////////////////////////////////////////
+
+#define ARDUHAL_LOG_LEVEL_NONE    0
+#define ARDUHAL_LOG_LEVEL_ERROR   1
+#define ARDUHAL_LOG_LEVEL_WARN    2
+#define ARDUHAL_LOG_LEVEL_INFO    3
+#define ARDUHAL_LOG_LEVEL_DEBUG   4
+#define ARDUHAL_LOG_LEVEL_VERBOSE 5
+
+#ifndef CORE_DEBUG_LEVEL
+  #define CORE_DEBUG_LEVEL ARDUHAL_LOG_LEVEL_WARN
+#endif
+
+#define NATIVE_LOG(level, letter, tag, format, ...)                                              \
+  do {                                                                                           \
+    if (CORE_DEBUG_LEVEL >= level)                                                               \
+      fprintf(stderr, "[%8" PRIu32 "][" letter "][%s] " format "\n", millis(), tag, ##__VA_ARGS__); \
+  } while (0)
+
+#define ESP_LOGE(tag, format, ...) NATIVE_LOG(ARDUHAL_LOG_LEVEL_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) NATIVE_LOG(ARDUHAL_LOG_LEVEL_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) NATIVE_LOG(ARDUHAL_LOG_LEVEL_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) NATIVE_LOG(ARDUHAL_LOG_LEVEL_DEBUG, "D", tag, format, ##__VA_ARGS__)
+
+///////////////////////////////////////////////////////////////////////////////
+// misc core
+///////////////////////////////////////////////////////////////////////////////
+
+#define pgm_read_word_near(addr) (*reinterpret_cast<const uint16_t*>(addr))
+
+class String {
+  public:
+    String() = default;
+    String(const char* str) : _str(str ? str : "") {} // NOLINT
+    const char* c_str() const { return _str.c_str(); }
+    size_t length() const { return _str.length(); }
+
+  private:
+    std::string _str;
+};
+
+inline const String emptyString;
+
+class Print {
+  public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+      size_t n = 0;
+      while (size--)
+        n += write(*buffer++);
+      return n;
+    }
+    size_t write(const char* str) { return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0; }
+    size_t print(const char* str) { return write(str); }
+    size_t println(const char* str = "") { return write(str) + write("\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+      char buffer[256];
+      va_list args;
+      va_start(args, format);
+      int len = vsnprintf(buffer, sizeof(buffer), format, args);
+      va_end(args);
+      if (len <= 0)
+        return 0;
+      return write(reinterpret_cast<const uint8_t*>(buffer), std::min(static_cast<size_t>(len), sizeof(buffer) - 1));
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// gpio
+///////////////////////////////////////////////////////////////////////////////
+
+typedef enum {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+#define SOC_GPIO_VALID_GPIO_MASK        0xFFFFFFFFFFULL
+#define SOC_GPIO_VALID_OUTPUT_GPIO_MASK 0x03FFFFFFFFULL
+#define SOC_UART_NUM                    3
+#define SOC_UART_HP_NUM                 3
+
+#define RX1 9
+#define TX1 10
+#define RX2 16
+#define TX2 17
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeRTOS
+///////////////////////////////////////////////////////////////////////////////
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define pdFAIL  0
+
+#define portMAX_DELAY      0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  (static_cast<TickType_t>(ms) / portTICK_PERIOD_MS)
+
+// Tasks are host threads. A task ends by returning from its function (vTaskDelete(NULL) is a no-op).
+// Task notifications are real: a task waiting for a notification sleeps for real (at most ticks ms of wall clock time),
+// it does not move the simulated clock.
+class NativeTask {
+  public:
+    void notify() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _notifications++;
+      _cv.notify_one();
+    }
+
+    uint32_t take(bool clear, TickType_t ticks) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait_for(lock, std::chrono::milliseconds(ticks == portMAX_DELAY ? 1000 : ticks), [this]() { return _notifications > 0; });
+      const uint32_t count = _notifications;
+      if (count)
+        _notifications = clear ? 0 : count - 1;
+      return count;
+    }
+
+    static NativeTask*& current() {
+      static thread_local NativeTask* task = nullptr;
+      if (!task)
+        task = new NativeTask(); // main thread, or thread not created by xTaskCreateUniversal
+      return task;
+    }
+
+  private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    uint32_t _notifications = 0;
+};
+
+typedef NativeTask* TaskHandle_t;
+
+inline BaseType_t xTaskCreateUniversal(TaskFunction_t fn, const char* name, uint32_t stackSize, void* params, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  (void)name;
+  (void)stackSize;
+  (void)priority;
+  (void)core;
+  NativeTask* task = new NativeTask(); // never freed: the handle may still be notified after the task ended
+  if (handle)
+    *handle = task;
+  std::thread([fn, params, task]() {
+    NativeTask::current() = task;
+    fn(params);
+  }).detach();
+  return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t handle) { (void)handle; }
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+  if (handle)
+    handle->notify();
+  return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) { return NativeTask::current()->take(clear, ticks); }
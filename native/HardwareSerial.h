@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define SERIAL_8N1 0x800001c
+
+// Wire model plugged behind a HardwareSerial stand-in (see MycilaJSYSimulator.h).
+// All times are in microseconds of NativeClock.
+class SerialLine {
+  public:
+    virtual ~SerialLine() = default;
+
+    // called when the port is opened (begin) or closed (end)
+    virtual void open(uint32_t baudRate) = 0;
+    virtual void close() = 0;
+
+    // sends bytes on the wire, starting at NativeClock::now() or when the previous transmission ends
+    virtual void transmit(const uint8_t* data, size_t len) = 0;
+    // time at which the last transmitted bit leaves the wire
+    virtual uint64_t txDone() = 0;
+
+    // arrival time of the next received byte, or UINT64_MAX if nothing is coming
+    virtual uint64_t nextArrival() = 0;
+    // number of received bytes already arrived at NativeClock::now()
+    virtual size_t available() = 0;
+    // pops the next received byte
+    virtual uint8_t receive() = 0;
+};
+
+// Same blocking semantics as the arduino-esp32 3.x HardwareSerial (which is backed by the IDF driver):
+// - write() returns immediately, bytes are sent in the background
+// - readBytes() waits until length bytes are received or the timeout (for the whole call) is reached
+// - flush(false) waits for TX completion then discards what was received so far
+class HardwareSerial : public Print {
+  public:
+    explicit HardwareSerial(int uartNum) : _uartNum(uartNum) {}
+
+    // host-only: connects this port to a simulated wire. Without a line, writes go to stdout.
+    void attach(SerialLine* line) { _line = line; }
+    SerialLine* getLine() const { return _line; }
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {
+      (void)config;
+      (void)rxPin;
+      (void)txPin;
+      _baud = baud;
+      _open = true;
+      if (_line)
+        _line->open(baud);
+    }
+
+    void end() {
+      if (_line && _open)
+        _line->close();
+      _open = false;
+    }
+
+    uint32_t baudRate() const { return _baud; }
+    int getUartNum() const { return _uartNum; }
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+    operator bool() const { return true; }
+    int availableForWrite() { return 128; }
+
+    int available() { return _line ? static_cast<int>(_line->available()) : 0; }
+
+    int read() {
+      if (!available())
+        return -1;
+      return _line->receive();
+    }
+
+    size_t readBytes(uint8_t* buffer, size_t length) {
+      if (!_line) {
+        NativeClock::advance(static_cast<uint64_t>(_timeout) * 1000);
+        return 0;
+      }
+      const uint64_t deadline = NativeClock::now() + static_cast<uint64_t>(_timeout) * 1000;
+      size_t count = 0;
+      while (count < length) {
+        uint64_t arrival = _line->nextArrival();
+        if (arrival > deadline)
+          break;
+        NativeClock::advanceTo(arrival);
+        buffer[count++] = _line->receive();
+      }
+      if (count < length)
+        NativeClock::advanceTo(deadline);
+      return count;
+    }
+
+    void flush(bool txOnly = true) {
+      if (!_line)
+        return;
+      NativeClock::advanceTo(_line->txDone());
+      if (!txOnly) {
+        while (_line->available())
+          _line->receive();
+      }
+    }
+
+    using Print::write;
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+      if (_line) {
+        _line->transmit(buffer, size);
+      } else {
+        fwrite(buffer, 1, size, stdout);
+      }
+      return size;
+    }
+
+  private:
+    int _uartNum;
+    SerialLine* _line = nullptr;
+    uint32_t _baud = 0;
+    unsigned long _timeout = 1000;
+    bool _open = false;
+};
+
+inline HardwareSerial Serial(0);
+inline HardwareSerial Serial1(1);
+inline HardwareSerial Serial2(2);
@@ -0,0 +1,558 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include <HardwareSerial.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Mycila {
+  /**
+   * @brief Simulated JSY Modbus RTU bus, to be attached to a HardwareSerial stand-in with `Serial2.attach(&bus)`.
+   *
+   * Each byte takes 10 bit times on the wire (8N1) at the baud rate the port was opened with.
+   * A device only answers when its own baud rate matches the port and the request CRC is valid,
+   * after a model specific turnaround delay. Several devices answering at the same time (broadcast) produce garbage.
+   * Register maps follow the decoding done in MycilaJSY.cpp for each supported model.
+   */
+  class JSYSimulator : public SerialLine {
+    public:
+      class Device {
+        public:
+          Device(uint16_t model, uint8_t address, uint32_t baudRate) : model(model), address(address), baudRate(baudRate ? baudRate : defaultBaudRate(model)), turnaroundUs(defaultTurnaroundUs(model)) {}
+
+          uint16_t model;
+          uint8_t address;
+          uint32_t baudRate;
+          // delay in microseconds between the end of a request and the start of the response
+          uint32_t turnaroundUs;
+          // JSY1031 only: 0x01 = AC, 0x02 = DC
+          uint8_t mode = 0x01;
+          // an unpowered device does not answer
+          bool powered = true;
+
+          // simulated load per channel / phase: the active power oscillates +/- 5% around these values
+          float voltage[3] = {230.12f, 231.43f, 229.87f};
+          float activePower[3] = {650.0f, -1200.0f, 320.0f};
+          float powerFactor[3] = {0.95f, 0.87f, 0.99f};
+          float frequency = 49.98f;
+
+          // energies in Wh
+          double activeEnergyImported[3] = {1200.0, 300.0, 4500.0};
+          double activeEnergyReturned[3] = {10.0, 8700.0, 0.0};
+          double reactiveEnergyImported[3] = {120.0, 430.0, 60.0};
+          double reactiveEnergyReturned[3] = {0.0, 0.0, 0.0};
+          double apparentEnergy[3] = {1400.0, 9800.0, 4600.0};
+
+          // statistics
+          uint32_t requests = 0;
+          uint32_t responses = 0;
+
+          static uint32_t defaultBaudRate(uint16_t model) {
+            switch (model) {
+              case 0x0163:
+              case 0x0194:
+                return 4800;
+              default:
+                return 9600;
+            }
+          }
+
+          // approximations from measurements (see README, PerfTest1): JSY1031 is very slow to answer
+          static uint32_t defaultTurnaroundUs(uint16_t model) {
+            switch (model) {
+              case 0x1031:
+                return 350000;
+              case 0x0163:
+                return 20000;
+              case 0x0193:
+              case 0x0194:
+                return 25000;
+              case 0x0227:
+              case 0x0229:
+                return 20000;
+              case 0x0333:
+                return 30000;
+              default:
+                return 25000;
+            }
+          }
+
+          float power(size_t i, uint64_t now) const {
+            return activePower[i] * (1.0f + 0.05f * static_cast<float>(std::sin(2.0 * M_PI * static_cast<double>(now) / 7e6 + static_cast<double>(i))));
+          }
+          float apparentPower(size_t i, uint64_t now) const { return std::abs(power(i, now)) / powerFactor[i]; }
+          float reactivePower(size_t i, uint64_t now) const {
+            float s = apparentPower(i, now);
+            float p = power(i, now);
+            return std::sqrt(s * s - p * p);
+          }
+          float current(size_t i, uint64_t now) const { return apparentPower(i, now) / voltage[i]; }
+
+          // integrates the energy counters up to the given time
+          void update(uint64_t now) {
+            if (now <= _lastUpdate) {
+              return;
+            }
+            const double hours = static_cast<double>(now - _lastUpdate) / 3.6e9;
+            for (size_t i = 0; i < 3; i++) {
+              const double p = power(i, now);
+              if (p >= 0)
+                activeEnergyImported[i] += p * hours;
+              else
+                activeEnergyReturned[i] += -p * hours;
+              reactiveEnergyImported[i] += reactivePower(i, now) * hours;
+              apparentEnergy[i] += apparentPower(i, now) * hours;
+            }
+            _lastUpdate = now;
+          }
+
+          void resetEnergy() {
+            for (size_t i = 0; i < 3; i++) {
+              activeEnergyImported[i] = 0;
+              activeEnergyReturned[i] = 0;
+              reactiveEnergyImported[i] = 0;
+              reactiveEnergyReturned[i] = 0;
+              apparentEnergy[i] = 0;
+            }
+          }
+
+          // size in bytes of a register
+          uint8_t registerSize(uint16_t reg) const { return model == 0x0194 && reg >= 0x0048 ? 4 : 2; }
+
+          // register map at the given time
+          std::map<uint16_t, uint32_t> registers(uint64_t now) const;
+
+        private:
+          uint64_t _lastUpdate = 0;
+      };
+
+      /**
+       * @brief Add a device to the bus
+       * @param model JSY model (MYCILA_JSY_MK_xxx)
+       * @param address Modbus address of the device
+       * @param baudRate baud rate of the device, or 0 for the model default
+       */
+      Device& add(uint16_t model, uint8_t address = 0x01, uint32_t baudRate = 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _devices.emplace_back(std::make_unique<Device>(model, address, baudRate));
+        return *_devices.back();
+      }
+
+      Device* device(uint8_t address) {
+        for (auto& d : _devices)
+          if (d->address == address)
+            return d.get();
+        return nullptr;
+      }
+
+      size_t size() const { return _devices.size(); }
+      Device& operator[](size_t index) { return *_devices[index]; }
+
+      uint32_t getBaudRate() const { return _baudRate; }
+      // duration of 1 byte on the wire (start + 8 data + stop bits)
+      double charTimeUs() const { return _baudRate ? 10e6 / _baudRate : 0; }
+
+      // bus statistics
+      uint64_t getTxBytes() const { return _txBytes; }
+      uint64_t getRxBytes() const { return _rxBytes; }
+      uint64_t getBusyUs() const { return _busyUs; }
+
+      // SerialLine
+
+      void open(uint32_t baudRate) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _baudRate = baudRate;
+        _rx.clear();
+      }
+
+      void close() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _baudRate = 0;
+        _rx.clear();
+      }
+
+      void transmit(const uint8_t* data, size_t len) override;
+
+      uint64_t txDone() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _txBusyUntil;
+      }
+
+      uint64_t nextArrival() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _rx.empty() ? UINT64_MAX : _rx.front().first;
+      }
+
+      size_t available() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const uint64_t now = NativeClock::now();
+        size_t count = 0;
+        for (const auto& b : _rx) {
+          if (b.first > now)
+            break;
+          count++;
+        }
+        return count;
+      }
+
+      uint8_t receive() override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_rx.empty())
+          return 0;
+        uint8_t b = _rx.front().second;
+        _rx.pop_front();
+        return b;
+      }
+
+      // CRC-16/MODBUS
+      static uint16_t crc16(const uint8_t* data, size_t len) {
+        uint16_t crc = 0xFFFF;
+        while (len--) {
+          crc ^= *data++;
+          for (int i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        return crc;
+      }
+
+    private:
+      std::mutex _mutex;
+      std::vector<std::unique_ptr<Device>> _devices;
+      std::deque<std::pair<uint64_t, uint8_t>> _rx;
+      uint32_t _baudRate = 0;
+      uint64_t _txBusyUntil = 0;
+      uint64_t _rxBusyUntil = 0;
+      uint64_t _txBytes = 0;
+      uint64_t _rxBytes = 0;
+      uint64_t _busyUs = 0;
+
+      std::vector<uint8_t> _answer(Device& device, const uint8_t* request, size_t len, uint64_t now);
+  };
+
+  inline std::map<uint16_t, uint32_t> JSYSimulator::Device::registers(uint64_t now) const {
+    std::map<uint16_t, uint32_t> r;
+
+    auto u16 = [&r](uint16_t reg, double value) { r[reg] = static_cast<uint32_t>(std::lround(value)) & 0xFFFF; };
+    auto u32 = [&r](uint16_t reg, double value) {
+      uint32_t v = static_cast<uint32_t>(std::llround(value));
+      r[reg] = v >> 16;
+      r[reg + 1] = v & 0xFFFF;
+    };
+
+    uint8_t baudId = 0;
+    switch (baudRate) {
+      case 1200:
+        baudId = 0x03;
+        break;
+      case 2400:
+        baudId = 0x04;
+        break;
+      case 4800:
+        baudId = 0x05;
+        break;
+      case 9600:
+        baudId = 0x06;
+        break;
+      case 19200:
+        baudId = 0x07;
+        break;
+      case 38400:
+        baudId = 0x08;
+        break;
+      default:
+        break;
+    }
+
+    // system registers
+    r[0x0000] = model;
+    r[0x0001] = (model == 0x1031 ? mode : 0x01) << 8 | 0x01;
+    r[0x0002] = 250;
+    r[0x0003] = 800;
+    r[0x0004] = address << 8 | baudId;
+    r[0x0005] = mode;
+
+    switch (model) {
+      case 0x1031: {
+        u16(0x0048, voltage[0] * 100);
+        u32(0x0049, current(0, now) * 10000);
+        u32(0x004B, std::abs(power(0, now)) * 10000);
+        u32(0x004D, (activeEnergyImported[0] + activeEnergyReturned[0]) / 10);
+        u16(0x004F, powerFactor[0] * 1000);
+        u16(0x0050, frequency * 100);
+        u32(0x0051, 0);
+        for (uint16_t reg = 0x0053; reg <= 0x0056; reg++)
+          u16(reg, 0);
+        u32(0x0057, apparentPower(0, now) * 10000);
+        u32(0x0059, reactivePower(0, now) * 10000);
+        u16(0x005B, std::acos(powerFactor[0]) * 180 / M_PI * 100);
+        break;
+      }
+
+      case 0x0163: {
+        u16(0x0048, voltage[0] * 100);
+        u16(0x0049, current(0, now) * 100);
+        u16(0x004A, std::abs(power(0, now)));
+        u32(0x004B, activeEnergyImported[0] * 16 / 5);
+        u16(0x004D, powerFactor[0] * 1000);
+        u32(0x004E, activeEnergyReturned[0] * 16 / 5);
+        u16(0x0050, power(0, now) < 0 ? 1 : 0);
+        u16(0x0051, frequency * 100);
+        break;
+      }
+
+      case 0x0193: {
+        for (uint16_t i = 0; i < 2; i++) {
+          const uint16_t base = 0x0100 + i * 10;
+          u16(base, voltage[i] * 100);
+          u16(base + 1, current(i, now) * 100);
+          u16(base + 2, std::abs(power(i, now)));
+          u16(base + 3, power(i, now) < 0 ? 1 : 0);
+          u32(base + 4, activeEnergyImported[i] / 10);
+          u32(base + 6, activeEnergyReturned[i] / 10);
+          u16(base + 8, powerFactor[i] * 1000);
+          u16(base + 9, frequency * 100);
+        }
+        break;
+      }
+
+      case 0x0194: {
+        // 4 bytes registers
+        for (uint16_t i = 0; i < 2; i++) {
+          const uint16_t base = 0x0048 + i * 8;
+          r[base] = std::lround(voltage[i] * 10000);
+          r[base + 1] = std::lround(current(i, now) * 10000);
+          r[base + 2] = std::lround(std::abs(power(i, now)) * 10000);
+          r[base + 3] = std::llround(activeEnergyImported[i] * 10);
+          r[base + 4] = std::lround(powerFactor[i] * 1000);
+          r[base + 5] = std::llround(activeEnergyReturned[i] * 10);
+        }
+        r[0x004E] = (power(0, now) < 0 ? 1u : 0u) << 24 | (power(1, now) < 0 ? 1u : 0u) << 16;
+        r[0x004F] = std::lround(frequency * 100);
+        break;
+      }
+
+      case 0x0227:
+      case 0x0229: {
+        u32(0x0100, voltage[0] * 10000);
+        u32(0x0102, current(0, now) * 10000);
+        u32(0x0104, std::abs(power(0, now)) * 10000);
+        u32(0x0106, reactivePower(0, now) * 10000);
+        u32(0x0108, apparentPower(0, now) * 10000);
+        u32(0x010A, powerFactor[0] * 1000);
+        u32(0x010C, frequency * 100);
+        u32(0x010E, activeEnergyImported[0] + activeEnergyReturned[0]);
+        u32(0x0110, reactiveEnergyImported[0] + reactiveEnergyReturned[0]);
+        u32(0x0112, 0);
+        u16(0x0114, power(0, now) < 0 ? 1 : 0);
+        u16(0x0115, 0);
+        u32(0x0116, activeEnergyImported[0]);
+        u32(0x0118, activeEnergyReturned[0]);
+        u32(0x011A, reactiveEnergyImported[0]);
+        u32(0x011C, reactiveEnergyReturned[0]);
+        break;
+      }
+
+      case 0x0333: {
+        double p = 0, q = 0, s = 0;
+        double e[8] = {0};
+        uint16_t signs = 0;
+        for (uint16_t i = 0; i < 3; i++) {
+          u16(0x0100 + i, voltage[i] * 100);
+          u16(0x0103 + i, current(i, now) * 100);
+          u16(0x0106 + i, std::abs(power(i, now)));
+          u16(0x010B + i, reactivePower(i, now));
+          u16(0x0110 + i, apparentPower(i, now));
+          u16(0x0116 + i, powerFactor[i] * 1000);
+          u32(0x011A + i * 2, (activeEnergyImported[i] + activeEnergyReturned[i]) / 10);
+          u32(0x0122 + i * 2, (reactiveEnergyImported[i] + reactiveEnergyReturned[i]) / 10);
+          u32(0x012A + i * 2, apparentEnergy[i] / 10);
+          u32(0x0134 + i * 2, activeEnergyImported[i] / 10);
+          u32(0x013C + i * 2, activeEnergyReturned[i] / 10);
+          u32(0x0144 + i * 2, reactiveEnergyImported[i] / 10);
+          u32(0x014C + i * 2, reactiveEnergyReturned[i] / 10);
+          u16(0x0154 + i, 0);
+          const double phi = std::acos(powerFactor[i]) * 180 / M_PI;
+          u16(0x0157 + i, i * 120 * 100);
+          u16(0x015A + i, (i * 120 + phi) * 100);
+          u16(0x015D + i, phi * 100);
+          u16(0x0160 + i, 2.5 * 100);
+          u16(0x0163 + i, 10.0 * 100);
+          p += power(i, now);
+          q += reactivePower(i, now);
+          s += apparentPower(i, now);
+          e[0] += activeEnergyImported[i] + activeEnergyReturned[i];
+          e[1] += reactiveEnergyImported[i] + reactiveEnergyReturned[i];
+          e[2] += apparentEnergy[i];
+          e[3] += activeEnergyImported[i];
+          e[4] += activeEnergyReturned[i];
+          e[5] += reactiveEnergyImported[i];
+          e[6] += reactiveEnergyReturned[i];
+          if (power(i, now) < 0)
+            signs |= 1 << i;
+        }
+        if (p < 0)
+          signs |= 1 << 3;
+        u32(0x0109, std::abs(p));
+        u32(0x010E, q);
+        u32(0x0113, s);
+        u16(0x0115, frequency * 100);
+        u16(0x0119, s == 0 ? 0 : std::abs(p) / s * 1000);
+        u32(0x0120, e[0] / 10);
+        u32(0x0128, e[1] / 10);
+        u32(0x0130, e[2] / 10);
+        u16(0x0132, signs);
+        u16(0x0133, 0);
+        u32(0x013A, e[3] / 10);
+        u32(0x0142, e[4] / 10);
+        u32(0x014A, e[5] / 10);
+        u32(0x0152, e[6] / 10);
+        break;
+      }
+
+      default:
+        break;
+    }
+
+    return r;
+  }
+
+  inline void JSYSimulator::transmit(const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_baudRate || !len)
+      return;
+
+    const double charUs = charTimeUs();
+    const uint64_t start = std::max(NativeClock::now(), _txBusyUntil);
+    const uint64_t end = start + static_cast<uint64_t>(len * charUs);
+    _txBusyUntil = end;
+    _txBytes += len;
+    _busyUs += end - start;
+
+    // find the devices understanding the request
+    std::vector<std::vector<uint8_t>> answers;
+    uint32_t turnaroundUs = 0;
+    for (auto& d : _devices) {
+      if (!d->powered || d->baudRate != _baudRate || len < 4)
+        continue;
+      if (data[0] != 0x00 && data[0] != d->address)
+        continue;
+      if (crc16(data, len - 2) != (data[len - 2] | data[len - 1] << 8))
+        continue;
+      // device still busy answering a previous request
+      if (end < _rxBusyUntil)
+        continue;
+      d->requests++;
+      std::vector<uint8_t> answer = _answer(*d, data, len, end);
+      if (!answer.empty()) {
+        d->responses++;
+        turnaroundUs = std::max(turnaroundUs, d->turnaroundUs);
+        answers.push_back(std::move(answer));
+      }
+    }
+
+    if (answers.empty())
+      return;
+
+    // several devices answering at the same time: bytes are mixed up on the wire
+    std::vector<uint8_t>& frame = answers[0];
+    for (size_t i = 1; i < answers.size(); i++)
+      for (size_t j = 0; j < frame.size() && j < answers[i].size(); j++)
+        frame[j] &= answers[i][j];
+
+    const uint64_t responseStart = end + turnaroundUs;
+    for (size_t i = 0; i < frame.size(); i++)
+      _rx.emplace_back(responseStart + static_cast<uint64_t>((i + 1) * charUs), frame[i]);
+    _rxBusyUntil = _rx.back().first;
+    _rxBytes += frame.size();
+    _busyUs += _rxBusyUntil - responseStart;
+  }
+
+  inline std::vector<uint8_t> JSYSimulator::_answer(Device& device, const uint8_t* request, size_t len, uint64_t now) {
+    std::vector<uint8_t> frame;
+    frame.push_back(device.address);
+
+    auto seal = [&frame]() {
+      uint16_t crc = crc16(frame.data(), frame.size());
+      frame.push_back(crc & 0xFF);
+      frame.push_back(crc >> 8);
+      return frame;
+    };
+
+    auto exception = [&frame, &seal](uint8_t cmd, uint8_t code) {
+      frame.push_back(cmd | 0x80);
+      frame.push_back(code);
+      return seal();
+    };
+
+    const uint8_t cmd = request[1];
+    if (len < 8)
+      return {};
+    const uint16_t start = request[2] << 8 | request[3];
+    const uint16_t count = request[4] << 8 | request[5];
+
+    device.update(now);
+
+    switch (cmd) {
+      // read registers
+      case 0x03: {
+        std::map<uint16_t, uint32_t> registers = device.registers(now);
+        frame.push_back(cmd);
+        frame.push_back(0);
+        for (uint16_t reg = start; reg < start + count; reg++) {
+          auto it = registers.find(reg);
+          if (it == registers.end()) {
+            frame.resize(1);
+            return exception(cmd, 0x02);
+          }
+          if (device.registerSize(reg) == 4) {
+            frame.push_back(it->second >> 24);
+            frame.push_back(it->second >> 16);
+          }
+          frame.push_back(it->second >> 8);
+          frame.push_back(it->second);
+        }
+        frame[2] = static_cast<uint8_t>(frame.size() - 3);
+        return seal();
+      }
+
+      // write registers
+      case 0x10: {
+        if (len < 9 || len != 9u + request[6])
+          return exception(cmd, 0x03);
+        const uint8_t* data = request + 7;
+        uint8_t newAddress = device.address;
+        uint32_t newBaudRate = device.baudRate;
+        if (start == 0x0004 && count == 1) {
+          static constexpr uint32_t BAUDS[] = {0, 0, 0, 1200, 2400, 4800, 9600, 19200, 38400};
+          if (data[1] > 8 || !BAUDS[data[1]] || data[0] == 0)
+            return exception(cmd, 0x03);
+          newAddress = data[0];
+          newBaudRate = BAUDS[data[1]];
+        } else if (start == 0x0005 && count == 1 && device.model == 0x1031) {
+          device.mode = data[1];
+        } else if (start == 0x000C && count == 2) {
+          device.resetEnergy();
+        } else {
+          return exception(cmd, 0x02);
+        }
+        frame.insert(frame.end(), request + 1, request + 6);
+        seal();
+        // new settings are applied once the answer is sent
+        device.address = newAddress;
+        device.baudRate = newBaudRate;
+        return frame;
+      }
+
+      default:
+        return exception(cmd, 0x01);
+    }
+  }
+} // namespace Mycila
@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+// Host-side stand-in for the subset of the ESP-IDF UART driver used by the MYCILA_JSY_UART_IDF backend.
+// UART n is wired to the SerialLine attached to the HardwareSerial stand-in of the same number (Serial, Serial1, Serial2),
+// so the same simulated JSY bus can be used with both backends.
+//
+// The driver events are computed from the byte arrival times on the line, like the hardware does:
+// a UART_DATA event is raised when the RX FIFO reaches the full threshold, or after rx timeout characters of silence.
+
+#include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+#define ESP_ERROR_CHECK(x)    \
+  do {                        \
+    esp_err_t err__ = (x);    \
+    assert(err__ == ESP_OK);  \
+    (void)err__;              \
+  } while (0)
+
+typedef enum {
+  UART_NUM_0 = 0,
+  UART_NUM_1,
+  UART_NUM_2,
+  UART_NUM_MAX,
+} uart_port_t;
+
+typedef enum { UART_DATA_8_BITS = 3 } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_DEFAULT = 0 } uart_sclk_t;
+
+typedef struct {
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    uart_sclk_t source_clk;
+} uart_config_t;
+
+typedef enum {
+  UART_DATA,
+  UART_BREAK,
+  UART_BUFFER_FULL,
+  UART_FIFO_OVF,
+  UART_FRAME_ERR,
+  UART_PARITY_ERR,
+  UART_DATA_BREAK,
+  UART_PATTERN_DET,
+  UART_EVENT_MAX,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+#define UART_PIN_NO_CHANGE        (-1)
+#define UART_HW_FIFO_LEN(uartNum) 128
+
+class NativeUart : public NativeQueue {
+  public:
+    explicit NativeUart(uart_port_t port) : _port(port) {}
+
+    SerialLine* line() const {
+      HardwareSerial* serials[] = {&Serial, &Serial1, &Serial2};
+      return serials[_port]->getLine();
+    }
+
+    void open(uint32_t baudRate) {
+      _baudRate = baudRate;
+      if (line())
+        line()->open(baudRate);
+    }
+
+    void close() {
+      if (_baudRate && line())
+        line()->close();
+      _baudRate = 0;
+    }
+
+    void flushInput() {
+      _fifo.clear();
+      _buffer.clear();
+      if (line())
+        while (line()->available())
+          line()->receive();
+    }
+
+    size_t buffered() const { return _buffer.size(); }
+
+    size_t read(uint8_t* data, size_t len) {
+      size_t n = 0;
+      while (n < len && !_buffer.empty()) {
+        data[n++] = _buffer.front();
+        _buffer.pop_front();
+      }
+      return n;
+    }
+
+    uint8_t rxTimeout = 10;
+    uint8_t rxFullThreshold = 120;
+
+    // NativeQueue
+
+    BaseType_t receive(void* item, TickType_t ticks) override {
+      const uint64_t deadline = ticks == portMAX_DELAY ? UINT64_MAX : NativeClock::now() + static_cast<uint64_t>(ticks) * 1000;
+      SerialLine* l = line();
+      if (!l || !_baudRate) {
+        NativeClock::advanceTo(deadline);
+        return pdFALSE;
+      }
+
+      // move the bytes received before the next interrupt into the hardware FIFO
+      const uint64_t toutUs = static_cast<uint64_t>(rxTimeout) * 10000000 / _baudRate;
+      while (_fifo.size() < rxFullThreshold) {
+        const uint64_t arrival = l->nextArrival();
+        const uint64_t limit = _fifo.empty() ? deadline : _fifo.back().first + toutUs;
+        if (arrival == UINT64_MAX || arrival > limit)
+          break;
+        _fifo.emplace_back(arrival, l->receive());
+      }
+
+      if (_fifo.empty()) {
+        NativeClock::advanceTo(deadline);
+        return pdFALSE;
+      }
+
+      const bool full = _fifo.size() >= rxFullThreshold;
+      const uint64_t at = full ? _fifo.back().first : _fifo.back().first + toutUs;
+      if (at > deadline) {
+        NativeClock::advanceTo(deadline);
+        return pdFALSE;
+      }
+
+      NativeClock::advanceTo(at);
+      uart_event_t* event = static_cast<uart_event_t*>(item);
+      event->type = UART_DATA;
+      event->size = _fifo.size();
+      event->timeout_flag = !full;
+      for (const auto& b : _fifo)
+        _buffer.push_back(b.second);
+      _fifo.clear();
+      return pdTRUE;
+    }
+
+    void reset() override {}
+
+  private:
+    uart_port_t _port;
+    uint32_t _baudRate = 0;
+    std::deque<std::pair<uint64_t, uint8_t>> _fifo; // hardware FIFO: arrival time and byte
+    std::deque<uint8_t> _buffer;                    // driver RX ring buffer
+};
+
+inline std::unique_ptr<NativeUart> nativeUarts[UART_NUM_MAX];
+
+inline bool uart_is_driver_installed(uart_port_t port) { return port < UART_NUM_MAX && nativeUarts[port] != nullptr; }
+
+inline esp_err_t uart_driver_install(uart_port_t port, int rxBufferSize, int txBufferSize, int queueSize, QueueHandle_t* queue, int flags) {
+  (void)rxBufferSize;
+  (void)txBufferSize;
+  (void)queueSize;
+  (void)flags;
+  if (port >= UART_NUM_MAX || nativeUarts[port])
+    return ESP_FAIL;
+  nativeUarts[port] = std::make_unique<NativeUart>(port);
+  if (queue)
+    *queue = nativeUarts[port].get();
+  return ESP_OK;
+}
+
+inline esp_err_t uart_driver_delete(uart_port_t port) {
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  nativeUarts[port]->close();
+  nativeUarts[port].reset();
+  return ESP_OK;
+}
+
+inline esp_err_t uart_param_config(uart_port_t port, const uart_config_t* config) {
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  nativeUarts[port]->open(config->baud_rate);
+  return ESP_OK;
+}
+
+inline esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin) {
+  (void)txPin;
+  (void)rxPin;
+  (void)rtsPin;
+  (void)ctsPin;
+  return uart_is_driver_installed(port) ? ESP_OK : ESP_FAIL;
+}
+
+inline esp_err_t uart_set_rx_timeout(uart_port_t port, uint8_t toutThreshold) {
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  nativeUarts[port]->rxTimeout = toutThreshold;
+  return ESP_OK;
+}
+
+inline esp_err_t uart_set_rx_full_threshold(uart_port_t port, int threshold) {
+  if (!uart_is_driver_installed(port) || threshold < 1 || threshold >= UART_HW_FIFO_LEN(port))
+    return ESP_FAIL;
+  nativeUarts[port]->rxFullThreshold = threshold;
+  return ESP_OK;
+}
+
+inline int uart_write_bytes(uart_port_t port, const void* data, size_t len) {
+  if (!uart_is_driver_installed(port))
+    return -1;
+  if (SerialLine* line = nativeUarts[port]->line())
+    line->transmit(static_cast<const uint8_t*>(data), len);
+  return static_cast<int>(len);
+}
+
+inline esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks) {
+  (void)ticks;
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  if (SerialLine* line = nativeUarts[port]->line())
+    NativeClock::advanceTo(line->txDone());
+  return ESP_OK;
+}
+
+inline int uart_read_bytes(uart_port_t port, void* data, uint32_t len, TickType_t ticks) {
+  (void)ticks;
+  if (!uart_is_driver_installed(port))
+    return -1;
+  return static_cast<int>(nativeUarts[port]->read(static_cast<uint8_t*>(data), len));
+}
+
+inline esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t* size) {
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  *size = nativeUarts[port]->buffered();
+  return ESP_OK;
+}
+
+inline esp_err_t uart_flush_input(uart_port_t port) {
+  if (!uart_is_driver_installed(port))
+    return ESP_FAIL;
+  nativeUarts[port]->flushInput();
+  return ESP_OK;
+}
@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+// Host-side stand-in: the FreeRTOS definitions (tasks, notifications, ticks) are in Arduino.h, like on ESP32 where Arduino.h includes FreeRTOS.
+// A tick is 1 ms of NativeClock.
+
+#include <Arduino.h>
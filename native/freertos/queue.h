@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Host-side queue: the producer side is simulated by the implementation (i.e. the UART driver stand-in),
+// which computes at which NativeClock time the next item is available.
+class NativeQueue {
+  public:
+    virtual ~NativeQueue() = default;
+    // waits for the next item for at most ticks, advancing the simulated clock
+    virtual BaseType_t receive(void* item, TickType_t ticks) = 0;
+    virtual void reset() = 0;
+};
+
+typedef NativeQueue* QueueHandle_t;
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) { return queue ? queue->receive(item, ticks) : pdFALSE; }
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+  if (queue)
+    queue->reset();
+  return pdPASS;
+}
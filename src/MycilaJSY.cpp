@@ -3,9 +3,17 @@
  * Copyright (C) Mathieu Carbou
  */
 #include "MycilaJSY.h"
+#include "MycilaJSYEnergy.h"
+#include "MycilaJSYStats.h"
+#include "MycilaJSYStorage.h"
 
 #include <algorithm>
 
+#ifndef ARDUINO_NATIVE
+  #include <esp_timer.h>
+  #include <sys/time.h>
+#endif
+
 #ifdef MYCILA_LOGGER_SUPPORT
   #include <MycilaLogger.h>
 extern Mycila::Logger logger;
@@ -242,6 +250,333 @@ extern Mycila::Logger logger;
 #define JSY_333_REGISTER_COUNT 102 // registers
 #define JSY_333_REGISTER_START JSY_333_REGISTER_PHASE_A_VOLTAGE
 
+///////////////////////////////////////////////////////////////////////////////
+// JSY REGISTER MAPS
+///////////////////////////////////////////////////////////////////////////////
+
+using Metrics = Mycila::JSY::Metrics;
+
+// Where a decoded value goes
+enum : uint8_t {
+  JSY_CHANNEL_1 = 0,                              // Data::_metrics[0]: single channel, channel 1, phase A
+  JSY_CHANNEL_2 = 1,                              // Data::_metrics[1]: channel 2, phase B
+  JSY_CHANNEL_3 = 2,                              // Data::_metrics[2]: phase C
+  JSY_CHANNEL_AGGREGATE = Mycila::JSY::AGGREGATE, // Data::aggregate
+};
+
+// How Data::aggregate and the values not provided by the device are computed once the registers are decoded
+enum class JSYAggregate : uint8_t {
+  // aggregate == channel 1
+  SINGLE,
+  // aggregate == channel 1 + channel 2, with the max voltage and frequency
+  CHANNELS,
+  // aggregate is read from the device, except the current (sum of the phases) and the voltage (S / I)
+  PHASES,
+};
+
+// Decoding rule of a single value in the register data of a read response.
+// Offsets are computed at compile time from the register address, so decoding a frame is a single loop over a table.
+struct JSYField {
+    uint8_t offset;              // byte offset of the value in the register data
+    uint8_t width;               // 2 or 4 bytes, big endian
+    uint8_t channel;             // JSY_CHANNEL_*
+    uint8_t signOffset;          // byte offset of the 16-bit register holding the sign of the value
+    uint16_t signMask;           // bits of the sign register which are set when the value is negative, 0 for unsigned values
+    uint16_t num;                // counters: value = raw * num / den
+    uint16_t den;                // counters: value = raw * num / den
+    uint32_t field;              // Mycila::JSY::Field of the target
+    float scale;                 // reals: value = raw * scale
+    float Metrics::* real;       // target of a float value, or nullptr
+    uint32_t Metrics::* counter; // target of an integer value (energy), or nullptr
+};
+
+// Register block read by a single request for a given model and the rules to decode it
+struct JSYRegisterMap {
+    uint16_t model;
+    uint16_t registerStart;
+    uint8_t registerCount;
+    uint8_t registerSize;
+    uint8_t fieldCount;
+    JSYAggregate aggregate;
+    // apparent power, reactive power and active energy are not provided by the device and must be computed
+    bool computed;
+    const JSYField* fields;
+};
+
+// Field bit of a target metric
+static constexpr uint32_t fieldOf(float Metrics::* target) {
+  return target == &Metrics::frequency       ? Mycila::JSY::FIELD_FREQUENCY
+         : target == &Metrics::voltage       ? Mycila::JSY::FIELD_VOLTAGE
+         : target == &Metrics::current       ? Mycila::JSY::FIELD_CURRENT
+         : target == &Metrics::activePower   ? Mycila::JSY::FIELD_ACTIVE_POWER
+         : target == &Metrics::reactivePower ? Mycila::JSY::FIELD_REACTIVE_POWER
+         : target == &Metrics::apparentPower ? Mycila::JSY::FIELD_APPARENT_POWER
+         : target == &Metrics::powerFactor   ? Mycila::JSY::FIELD_POWER_FACTOR
+         : target == &Metrics::phaseAngleU   ? Mycila::JSY::FIELD_PHASE_ANGLE_U
+         : target == &Metrics::phaseAngleI   ? Mycila::JSY::FIELD_PHASE_ANGLE_I
+         : target == &Metrics::phaseAngleUI  ? Mycila::JSY::FIELD_PHASE_ANGLE_UI
+         : target == &Metrics::thdU          ? Mycila::JSY::FIELD_THD_U
+         : target == &Metrics::thdI          ? Mycila::JSY::FIELD_THD_I
+                                             : Mycila::JSY::FIELD_NONE;
+}
+
+static constexpr uint32_t fieldOf(uint32_t Metrics::* target) {
+  return target == &Metrics::activeEnergy             ? Mycila::JSY::FIELD_ACTIVE_ENERGY
+         : target == &Metrics::activeEnergyImported   ? Mycila::JSY::FIELD_ACTIVE_ENERGY_IMPORTED
+         : target == &Metrics::activeEnergyReturned   ? Mycila::JSY::FIELD_ACTIVE_ENERGY_RETURNED
+         : target == &Metrics::reactiveEnergy         ? Mycila::JSY::FIELD_REACTIVE_ENERGY
+         : target == &Metrics::reactiveEnergyImported ? Mycila::JSY::FIELD_REACTIVE_ENERGY_IMPORTED
+         : target == &Metrics::reactiveEnergyReturned ? Mycila::JSY::FIELD_REACTIVE_ENERGY_RETURNED
+         : target == &Metrics::apparentEnergy         ? Mycila::JSY::FIELD_APPARENT_ENERGY
+                                                      : Mycila::JSY::FIELD_NONE;
+}
+
+// in the order of the Field bits
+const Mycila::JSY::FieldTarget Mycila::JSY::FIELD_TARGETS[] = {
+  {&Metrics::frequency, nullptr, "frequency"},
+  {&Metrics::voltage, nullptr, "voltage"},
+  {&Metrics::current, nullptr, "current"},
+  {&Metrics::activePower, nullptr, "active_power"},
+  {&Metrics::reactivePower, nullptr, "reactive_power"},
+  {&Metrics::apparentPower, nullptr, "apparent_power"},
+  {&Metrics::powerFactor, nullptr, "power_factor"},
+  {nullptr, &Metrics::activeEnergy, "active_energy"},
+  {nullptr, &Metrics::activeEnergyImported, "active_energy_imported"},
+  {nullptr, &Metrics::activeEnergyReturned, "active_energy_returned"},
+  {nullptr, &Metrics::reactiveEnergy, "reactive_energy"},
+  {nullptr, &Metrics::reactiveEnergyImported, "reactive_energy_imported"},
+  {nullptr, &Metrics::reactiveEnergyReturned, "reactive_energy_returned"},
+  {nullptr, &Metrics::apparentEnergy, "apparent_energy"},
+  {&Metrics::phaseAngleU, nullptr, "phase_angle_u"},
+  {&Metrics::phaseAngleI, nullptr, "phase_angle_i"},
+  {&Metrics::phaseAngleUI, nullptr, "phase_angle_ui"},
+  {&Metrics::thdU, nullptr, "thd_u"},
+  {&Metrics::thdI, nullptr, "thd_i"},
+};
+
+static_assert((1UL << Mycila::JSY::FIELD_COUNT) - 1 == Mycila::JSY::FIELD_ALL, "one target per field");
+
+// Builds the field descriptors of a model from its register addresses
+template <uint16_t START, uint8_t SIZE>
+struct JSYFields {
+    static constexpr uint8_t offset(uint16_t reg, uint8_t index = 0) { return static_cast<uint8_t>((reg - START) * SIZE + index); }
+
+    static constexpr JSYField real(uint16_t reg, uint8_t width, uint8_t channel, float Metrics::* target, float scale) {
+      return {offset(reg), width, channel, 0, 0, 1, 1, fieldOf(target), scale, target, nullptr};
+    }
+
+    // signed value: the sign is given by some bits of a 16-bit register (or of the first 2 bytes of a 32-bit register)
+    static constexpr JSYField real(uint16_t reg, uint8_t width, uint8_t channel, float Metrics::* target, float scale, uint16_t signReg, uint16_t signMask) {
+      return {offset(reg), width, channel, offset(signReg), signMask, 1, 1, fieldOf(target), scale, target, nullptr};
+    }
+
+    static constexpr JSYField counter(uint16_t reg, uint8_t width, uint8_t channel, uint32_t Metrics::* target, uint16_t num, uint16_t den = 1) {
+      return {offset(reg), width, channel, 0, 0, num, den, fieldOf(target), 1.0f, nullptr, target};
+    }
+};
+
+using JSY1031 = JSYFields<JSY_1031_REGISTER_START, JSY_1031_REGISTER_LEN>;
+using JSY163 = JSYFields<JSY_163_REGISTER_START, JSY_163_REGISTER_LEN>;
+using JSY193 = JSYFields<JSY_193_REGISTER_START, JSY_193_REGISTER_LEN>;
+using JSY194 = JSYFields<JSY_194_REGISTER_START, JSY_194_REGISTER_LEN>;
+using JSY22x = JSYFields<JSY_22x_REGISTER_START, JSY_22x_REGISTER_LEN>;
+using JSY333 = JSYFields<JSY_333_REGISTER_START, JSY_333_REGISTER_LEN>;
+
+// clang-format off
+static constexpr JSYField JSY_1031_FIELDS[] = {
+  JSY1031::real(JSY_1031_REGISTER_FREQUENCY, 2, JSY_CHANNEL_1, &Metrics::frequency, 0.01f),
+  JSY1031::real(JSY_1031_REGISTER_VOLTAGE, 2, JSY_CHANNEL_1, &Metrics::voltage, 0.01f),
+  JSY1031::real(JSY_1031_REGISTER_CURRENT, 4, JSY_CHANNEL_1, &Metrics::current, 0.0001f),
+  JSY1031::real(JSY_1031_REGISTER_ACTIVE_POWER, 4, JSY_CHANNEL_1, &Metrics::activePower, 0.0001f), // note: spec says /100 but in reality this is /10000
+  JSY1031::counter(JSY_1031_REGISTER_ACTIVE_ENERGY, 4, JSY_CHANNEL_1, &Metrics::activeEnergy, 10),
+  JSY1031::real(JSY_1031_REGISTER_POWER_FACTOR, 2, JSY_CHANNEL_1, &Metrics::powerFactor, 0.001f),
+  JSY1031::real(JSY_1031_REGISTER_APPARENT_POWER, 4, JSY_CHANNEL_1, &Metrics::apparentPower, 0.0001f), // note: spec says /100 but in reality this is /10000
+  JSY1031::real(JSY_1031_REGISTER_REACTIVE_POWER, 4, JSY_CHANNEL_1, &Metrics::reactivePower, 0.0001f), // note: spec says /100 but in reality this is /10000
+};
+
+// sign of power: second byte of JSY_163_REGISTER_ACTIVE_POWER_SIGN
+static constexpr JSYField JSY_163_FIELDS[] = {
+  JSY163::real(JSY_163_REGISTER_FREQUENCY, 2, JSY_CHANNEL_1, &Metrics::frequency, 0.01f),
+  JSY163::real(JSY_163_REGISTER_VOLTAGE, 2, JSY_CHANNEL_1, &Metrics::voltage, 0.01f),
+  JSY163::real(JSY_163_REGISTER_CURRENT, 2, JSY_CHANNEL_1, &Metrics::current, 0.01f),
+  JSY163::real(JSY_163_REGISTER_ACTIVE_POWER, 2, JSY_CHANNEL_1, &Metrics::activePower, 1.0f, JSY_163_REGISTER_ACTIVE_POWER_SIGN, 0x00FF),
+  JSY163::counter(JSY_163_REGISTER_ACTIVE_ENERGY_IMPORTED, 4, JSY_CHANNEL_1, &Metrics::activeEnergyImported, 5, 16),
+  JSY163::real(JSY_163_REGISTER_POWER_FACTOR, 2, JSY_CHANNEL_1, &Metrics::powerFactor, 0.001f),
+  JSY163::counter(JSY_163_REGISTER_ACTIVE_ENERGY_RETURNED, 4, JSY_CHANNEL_1, &Metrics::activeEnergyReturned, 5, 16),
+};
+
+// sign of power: whole sign register of each channel
+static constexpr JSYField JSY_193_FIELDS[] = {
+  JSY193::real(JSY_193_REGISTER_CH1_VOLTAGE, 2, JSY_CHANNEL_1, &Metrics::voltage, 0.01f),
+  JSY193::real(JSY_193_REGISTER_CH1_CURRENT, 2, JSY_CHANNEL_1, &Metrics::current, 0.01f),
+  JSY193::real(JSY_193_REGISTER_CH1_ACTIVE_POWER, 2, JSY_CHANNEL_1, &Metrics::activePower, 1.0f, JSY_193_REGISTER_CH1_ACTIVE_POWER_SIGN, 0xFFFF),
+  JSY193::counter(JSY_193_REGISTER_CH1_ACTIVE_ENERGY_POSITIVE, 4, JSY_CHANNEL_1, &Metrics::activeEnergyImported, 10),
+  JSY193::counter(JSY_193_REGISTER_CH1_ACTIVE_ENERGY_NEGATIVE, 4, JSY_CHANNEL_1, &Metrics::activeEnergyReturned, 10),
+  JSY193::real(JSY_193_REGISTER_CH1_POWER_FACTOR, 2, JSY_CHANNEL_1, &Metrics::powerFactor, 0.001f),
+  JSY193::real(JSY_193_REGISTER_CH1_FREQUENCY, 2, JSY_CHANNEL_1, &Metrics::frequency, 0.01f),
+
+  JSY193::real(JSY_193_REGISTER_CH2_VOLTAGE, 2, JSY_CHANNEL_2, &Metrics::voltage, 0.01f),
+  JSY193::real(JSY_193_REGISTER_CH2_CURRENT, 2, JSY_CHANNEL_2, &Metrics::current, 0.01f),
+  JSY193::real(JSY_193_REGISTER_CH2_ACTIVE_POWER, 2, JSY_CHANNEL_2, &Metrics::activePower, 1.0f, JSY_193_REGISTER_CH2_ACTIVE_POWER_SIGN, 0xFFFF),
+  JSY193::counter(JSY_193_REGISTER_CH2_ACTIVE_ENERGY_POSITIVE, 4, JSY_CHANNEL_2, &Metrics::activeEnergyImported, 10),
+  JSY193::counter(JSY_193_REGISTER_CH2_ACTIVE_ENERGY_NEGATIVE, 4, JSY_CHANNEL_2, &Metrics::activeEnergyReturned, 10),
+  JSY193::real(JSY_193_REGISTER_CH2_POWER_FACTOR, 2, JSY_CHANNEL_2, &Metrics::powerFactor, 0.001f),
+  JSY193::real(JSY_193_REGISTER_CH2_FREQUENCY, 2, JSY_CHANNEL_2, &Metrics::frequency, 0.01f),
+};
+
+// signs of power: first byte of JSY_194_REGISTER_ACTIVE_POWER_SIGNS for channel 1, second byte for channel 2
+static constexpr JSYField JSY_194_FIELDS[] = {
+  JSY194::real(JSY_194_REGISTER_FREQUENCY, 4, JSY_CHANNEL_1, &Metrics::frequency, 0.01f),
+  JSY194::real(JSY_194_REGISTER_CH1_VOLTAGE, 4, JSY_CHANNEL_1, &Metrics::voltage, 0.0001f),
+  JSY194::real(JSY_194_REGISTER_CH1_CURRENT, 4, JSY_CHANNEL_1, &Metrics::current, 0.0001f),
+  JSY194::real(JSY_194_REGISTER_CH1_ACTIVE_POWER, 4, JSY_CHANNEL_1, &Metrics::activePower, 0.0001f, JSY_194_REGISTER_ACTIVE_POWER_SIGNS, 0xFF00),
+  JSY194::counter(JSY_194_REGISTER_CH1_ACTIVE_ENERGY_IMPORTED, 4, JSY_CHANNEL_1, &Metrics::activeEnergyImported, 1, 10),
+  JSY194::real(JSY_194_REGISTER_CH1_POWER_FACTOR, 4, JSY_CHANNEL_1, &Metrics::powerFactor, 0.001f),
+  JSY194::counter(JSY_194_REGISTER_CH1_ACTIVE_ENERGY_RETURNED, 4, JSY_CHANNEL_1, &Metrics::activeEnergyReturned, 1, 10),
+
+  JSY194::real(JSY_194_REGISTER_FREQUENCY, 4, JSY_CHANNEL_2, &Metrics::frequency, 0.01f),
+  JSY194::real(JSY_194_REGISTER_CH2_VOLTAGE, 4, JSY_CHANNEL_2, &Metrics::voltage, 0.0001f),
+  JSY194::real(JSY_194_REGISTER_CH2_CURRENT, 4, JSY_CHANNEL_2, &Metrics::current, 0.0001f),
+  JSY194::real(JSY_194_REGISTER_CH2_ACTIVE_POWER, 4, JSY_CHANNEL_2, &Metrics::activePower, 0.0001f, JSY_194_REGISTER_ACTIVE_POWER_SIGNS, 0x00FF),
+  JSY194::counter(JSY_194_REGISTER_CH2_ACTIVE_ENERGY_IMPORTED, 4, JSY_CHANNEL_2, &Metrics::activeEnergyImported, 1, 10),
+  JSY194::real(JSY_194_REGISTER_CH2_POWER_FACTOR, 4, JSY_CHANNEL_2, &Metrics::powerFactor, 0.001f),
+  JSY194::counter(JSY_194_REGISTER_CH2_ACTIVE_ENERGY_RETURNED, 4, JSY_CHANNEL_2, &Metrics::activeEnergyReturned, 1, 10),
+};
+
+// signs of powers: whole sign registers
+static constexpr JSYField JSY_22x_FIELDS[] = {
+  JSY22x::real(JSY_22x_REGISTER_VOLTAGE, 4, JSY_CHANNEL_1, &Metrics::voltage, 0.0001f),
+  JSY22x::real(JSY_22x_REGISTER_CURRENT, 4, JSY_CHANNEL_1, &Metrics::current, 0.0001f),
+  JSY22x::real(JSY_22x_REGISTER_ACTIVE_POWER, 4, JSY_CHANNEL_1, &Metrics::activePower, 0.0001f, JSY_22x_REGISTER_ACTIVE_POWER_SIGN, 0xFFFF),
+  JSY22x::real(JSY_22x_REGISTER_REACTIVE_POWER, 4, JSY_CHANNEL_1, &Metrics::reactivePower, 0.0001f, JSY_22x_REGISTER_REACTIVE_POWER_SIGN, 0xFFFF),
+  JSY22x::real(JSY_22x_REGISTER_APPARENT_POWER, 4, JSY_CHANNEL_1, &Metrics::apparentPower, 0.0001f),
+  JSY22x::real(JSY_22x_REGISTER_POWER_FACTOR, 4, JSY_CHANNEL_1, &Metrics::powerFactor, 0.001f),
+  JSY22x::real(JSY_22x_REGISTER_FREQUENCY, 4, JSY_CHANNEL_1, &Metrics::frequency, 0.01f),
+  JSY22x::counter(JSY_22x_REGISTER_ACTIVE_ENERGY, 4, JSY_CHANNEL_1, &Metrics::activeEnergy, 1),
+  JSY22x::counter(JSY_22x_REGISTER_REACTIVE_ENERGY, 4, JSY_CHANNEL_1, &Metrics::reactiveEnergy, 1),
+  JSY22x::counter(JSY_22x_REGISTER_ACTIVE_ENERGY_POSITIVE, 4, JSY_CHANNEL_1, &Metrics::activeEnergyImported, 1),
+  JSY22x::counter(JSY_22x_REGISTER_ACTIVE_ENERGY_NEGATIVE, 4, JSY_CHANNEL_1, &Metrics::activeEnergyReturned, 1),
+  JSY22x::counter(JSY_22x_REGISTER_REACTIVE_ENERGY_POSITIVE, 4, JSY_CHANNEL_1, &Metrics::reactiveEnergyImported, 1),
+  JSY22x::counter(JSY_22x_REGISTER_REACTIVE_ENERGY_NEGATIVE, 4, JSY_CHANNEL_1, &Metrics::reactiveEnergyReturned, 1),
+};
+
+// signs of powers: second byte of JSY_333_REGISTER_POWER_SIGNS
+// bit 7: sign of total reactive power
+// bit 6: sign of phase C reactive power
+// bit 5: sign of phase B reactive power
+// bit 4: sign of phase A reactive power
+// bit 3: sign of total active power
+// bit 2: sign of phase C active power
+// bit 1: sign of phase B active power
+// bit 0: sign of phase A active power
+#define JSY_333_PHASE_FIELDS(P, CHANNEL, ACTIVE_SIGN, REACTIVE_SIGN)                                                                                         \
+  JSY333::real(JSY_333_REGISTER_FREQUENCY, 2, CHANNEL, &Metrics::frequency, 0.01f),                                                                          \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_VOLTAGE, 2, CHANNEL, &Metrics::voltage, 0.01f),                                                                  \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_CURRENT, 2, CHANNEL, &Metrics::current, 0.01f),                                                                  \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_ACTIVE_POWER, 2, CHANNEL, &Metrics::activePower, 1.0f, JSY_333_REGISTER_POWER_SIGNS, ACTIVE_SIGN),               \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_REACTIVE_POWER, 2, CHANNEL, &Metrics::reactivePower, 1.0f, JSY_333_REGISTER_POWER_SIGNS, REACTIVE_SIGN),         \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_APPARENT_POWER, 2, CHANNEL, &Metrics::apparentPower, 1.0f),                                                      \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_POWER_FACTOR, 2, CHANNEL, &Metrics::powerFactor, 0.001f),                                                        \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_ACTIVE_ENERGY, 4, CHANNEL, &Metrics::activeEnergy, 10),                                                       \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_REACTIVE_ENERGY, 4, CHANNEL, &Metrics::reactiveEnergy, 10),                                                   \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_APPARENT_ENERGY, 4, CHANNEL, &Metrics::apparentEnergy, 10),                                                   \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_ACTIVE_ENERGY_IMPORTED, 4, CHANNEL, &Metrics::activeEnergyImported, 10),                                      \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_ACTIVE_ENERGY_RETURNED, 4, CHANNEL, &Metrics::activeEnergyReturned, 10),                                      \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_REACTIVE_ENERGY_IMPORTED, 4, CHANNEL, &Metrics::reactiveEnergyImported, 10),                                  \
+  JSY333::counter(JSY_333_REGISTER_PHASE_##P##_REACTIVE_ENERGY_RETURNED, 4, CHANNEL, &Metrics::reactiveEnergyReturned, 10),                                  \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_PHASE_ANGLE_U, 2, CHANNEL, &Metrics::phaseAngleU, 0.01f),                                                        \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_PHASE_ANGLE_I, 2, CHANNEL, &Metrics::phaseAngleI, 0.01f),                                                        \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_PHASE_ANGLE_UI, 2, CHANNEL, &Metrics::phaseAngleUI, 0.01f),                                                      \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_THD_U, 2, CHANNEL, &Metrics::thdU, 0.01f),                                                                       \
+  JSY333::real(JSY_333_REGISTER_PHASE_##P##_THD_I, 2, CHANNEL, &Metrics::thdI, 0.01f)
+
+static constexpr JSYField JSY_333_FIELDS[] = {
+  JSY_333_PHASE_FIELDS(A, JSY_CHANNEL_1, 0x0001, 0x0010),
+  JSY_333_PHASE_FIELDS(B, JSY_CHANNEL_2, 0x0002, 0x0020),
+  JSY_333_PHASE_FIELDS(C, JSY_CHANNEL_3, 0x0004, 0x0040),
+
+  JSY333::real(JSY_333_REGISTER_FREQUENCY, 2, JSY_CHANNEL_AGGREGATE, &Metrics::frequency, 0.01f),
+  JSY333::real(JSY_333_REGISTER_TOTAL_ACTIVE_POWER, 4, JSY_CHANNEL_AGGREGATE, &Metrics::activePower, 1.0f, JSY_333_REGISTER_POWER_SIGNS, 0x0008),
+  JSY333::real(JSY_333_REGISTER_TOTAL_REACTIVE_POWER, 4, JSY_CHANNEL_AGGREGATE, &Metrics::reactivePower, 1.0f, JSY_333_REGISTER_POWER_SIGNS, 0x0080),
+  JSY333::real(JSY_333_REGISTER_TOTAL_APPARENT_POWER, 4, JSY_CHANNEL_AGGREGATE, &Metrics::apparentPower, 1.0f),
+  JSY333::real(JSY_333_REGISTER_TOTAL_POWER_FACTOR, 2, JSY_CHANNEL_AGGREGATE, &Metrics::powerFactor, 0.001f),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY, 4, JSY_CHANNEL_AGGREGATE, &Metrics::activeEnergy, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY, 4, JSY_CHANNEL_AGGREGATE, &Metrics::reactiveEnergy, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_APPARENT_ENERGY, 4, JSY_CHANNEL_AGGREGATE, &Metrics::apparentEnergy, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY_IMPORTED, 4, JSY_CHANNEL_AGGREGATE, &Metrics::activeEnergyImported, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY_RETURNED, 4, JSY_CHANNEL_AGGREGATE, &Metrics::activeEnergyReturned, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY_IMPORTED, 4, JSY_CHANNEL_AGGREGATE, &Metrics::reactiveEnergyImported, 10),
+  JSY333::counter(JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY_RETURNED, 4, JSY_CHANNEL_AGGREGATE, &Metrics::reactiveEnergyReturned, 10),
+};
+#undef JSY_333_PHASE_FIELDS
+
+#define JSY_FIELD_COUNT(fields) static_cast<uint8_t>(sizeof(fields) / sizeof(JSYField))
+
+static constexpr JSYRegisterMap JSY_REGISTER_MAPS[] = {
+  {MYCILA_JSY_MK_1031, JSY_1031_REGISTER_START, JSY_1031_REGISTER_COUNT, JSY_1031_REGISTER_LEN, JSY_FIELD_COUNT(JSY_1031_FIELDS), JSYAggregate::SINGLE, false, JSY_1031_FIELDS},
+  {MYCILA_JSY_MK_163, JSY_163_REGISTER_START, JSY_163_REGISTER_COUNT, JSY_163_REGISTER_LEN, JSY_FIELD_COUNT(JSY_163_FIELDS), JSYAggregate::SINGLE, true, JSY_163_FIELDS},
+  {MYCILA_JSY_MK_193, JSY_193_REGISTER_START, JSY_193_REGISTER_COUNT, JSY_193_REGISTER_LEN, JSY_FIELD_COUNT(JSY_193_FIELDS), JSYAggregate::CHANNELS, true, JSY_193_FIELDS},
+  {MYCILA_JSY_MK_194, JSY_194_REGISTER_START, JSY_194_REGISTER_COUNT, JSY_194_REGISTER_LEN, JSY_FIELD_COUNT(JSY_194_FIELDS), JSYAggregate::CHANNELS, true, JSY_194_FIELDS},
+  {MYCILA_JSY_MK_227, JSY_22x_REGISTER_START, JSY_22x_REGISTER_COUNT, JSY_22x_REGISTER_LEN, JSY_FIELD_COUNT(JSY_22x_FIELDS), JSYAggregate::SINGLE, false, JSY_22x_FIELDS},
+  {MYCILA_JSY_MK_229, JSY_22x_REGISTER_START, JSY_22x_REGISTER_COUNT, JSY_22x_REGISTER_LEN, JSY_FIELD_COUNT(JSY_22x_FIELDS), JSYAggregate::SINGLE, false, JSY_22x_FIELDS},
+  {MYCILA_JSY_MK_333, JSY_333_REGISTER_START, JSY_333_REGISTER_COUNT, JSY_333_REGISTER_LEN, JSY_FIELD_COUNT(JSY_333_FIELDS), JSYAggregate::PHASES, false, JSY_333_FIELDS},
+};
+// clang-format on
+
+#undef JSY_FIELD_COUNT
+
+static constexpr uint8_t maxRegisterCount() {
+  uint8_t count = 0;
+  for (const JSYRegisterMap& map : JSY_REGISTER_MAPS)
+    count = map.registerCount > count ? map.registerCount : count;
+  return count;
+}
+
+// the registers of a read plan are marked in an array of this size
+static_assert(maxRegisterCount() == JSY_333_REGISTER_COUNT, "JSY_333_REGISTER_COUNT must be the largest register count");
+
+static const JSYRegisterMap* findRegisterMap(uint16_t model) {
+  for (const JSYRegisterMap& map : JSY_REGISTER_MAPS)
+    if (map.model == model)
+      return &map;
+  return nullptr;
+}
+
+// weight of the last response time in the smoothed response time of a device
+#define JSY_TURNAROUND_SMOOTHING 0.125f
+
+// JSY1031 takes up to 350 ms to answer, other models 20 to 30 ms
+static inline uint32_t firstByteTimeout(uint16_t model) {
+  return model == MYCILA_JSY_MK_1031 || model == MYCILA_JSY_MK_UNKNOWN ? MYCILA_JSY_READ_TIMEOUT_MS : MYCILA_JSY_FIRST_BYTE_TIMEOUT_MS;
+}
+
+static inline uint32_t readRegister(const uint8_t* data, uint8_t width) {
+  return width == 4 ? (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3]
+                    : (static_cast<uint32_t>(data[0]) << 8) | data[1];
+}
+
+// S = P / PF, Q = std::sqrt(S^2 - P^2), E = Ei + Er
+static inline void computeMissingMetrics(Metrics& metrics) {
+  metrics.apparentPower = metrics.powerFactor == 0 ? 0 : std::abs(metrics.activePower / metrics.powerFactor);
+  metrics.reactivePower = std::sqrt(metrics.apparentPower * metrics.apparentPower - metrics.activePower * metrics.activePower);
+  metrics.activeEnergy = metrics.activeEnergyImported + metrics.activeEnergyReturned;
+}
+
+// adds to the selected fields the ones they are computed from
+static uint32_t requiredFields(const JSYRegisterMap& map, uint32_t fields) {
+  if (map.computed) {
+    // S = P / PF, Q = std::sqrt(S^2 - P^2) and, when aggregating channels, PF = P / S
+    if (fields & (Mycila::JSY::FIELD_APPARENT_POWER | Mycila::JSY::FIELD_REACTIVE_POWER | Mycila::JSY::FIELD_POWER_FACTOR))
+      fields |= Mycila::JSY::FIELD_ACTIVE_POWER | Mycila::JSY::FIELD_POWER_FACTOR;
+    if (fields & Mycila::JSY::FIELD_ACTIVE_ENERGY)
+      fields |= Mycila::JSY::FIELD_ACTIVE_ENERGY_IMPORTED | Mycila::JSY::FIELD_ACTIVE_ENERGY_RETURNED;
+  }
+  // aggregate voltage = S / I
+  if (map.aggregate == JSYAggregate::PHASES && (fields & Mycila::JSY::FIELD_VOLTAGE))
+    fields |= Mycila::JSY::FIELD_APPARENT_POWER | Mycila::JSY::FIELD_CURRENT;
+  return fields;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // JSY PROTOCOL
 ///////////////////////////////////////////////////////////////////////////////
@@ -277,6 +612,9 @@ extern Mycila::Logger logger;
 #define JSY_RESPONSE_SIZE_SWITCH_MODE  8 // address(1), cmd(1), register(2), data(2), crc(2)
 #define JSY_RESPONSE_SIZE_SET_COM      8 // address(1), cmd(1), data(4), crc(2)
 
+// the data of a response is checked by chunks while the next ones arrive
+#define JSY_RECEIVE_CHUNK_SIZE 16
+
 static constexpr uint8_t JSY_REQUEST_READ_REGISTERS[] = {
   MYCILA_JSY_ADDRESS_BROADCAST,
   JSY_CMD_READ_REGISTERS,
@@ -435,9 +773,34 @@ void Mycila::JSY::begin(HardwareSerial& serial,
 
   _pause = pause;
   _serial = &serial;
+  _instrumentation.clear();
+  _schedule.clear();
+  _publishSchedule();
+  _periodChanged = false;
+  _deadline = 0;
+
+  // model of the device checked with its persisted profile
+  uint16_t profileModel = MYCILA_JSY_MK_UNKNOWN;
+
+  if (baudRate == BaudRate::UNKNOWN && _loadProfile(destinationAddress, model)) {
+    // a single read of the model register checks the baud rate, the address and the model of the profile
+    _openSerial(_profile.baudRate);
+    if (_canRead(destinationAddress, _profile.baudRate, firstByteTimeout(_profile.model)) &&
+        _lastAddress == _profile.address &&
+        (_buffer[JSY_RESPONSE_DATA] << 8) + _buffer[JSY_RESPONSE_DATA + 1] == _profile.model) {
+      _baudRate = _profile.baudRate;
+      profileModel = _profile.model;
+      LOGI(TAG, "JSY @ 0x%02X matches its profile: JSY-MK-%X @ 0x%02X with speed %" PRIu32 " bauds", destinationAddress, _profile.model, _profile.address, _profile.baudRate);
+    } else {
+      LOGW(TAG, "JSY @ 0x%02X does not match its profile anymore: detecting it", destinationAddress);
+    }
+  }
 
-  if (baudRate == BaudRate::UNKNOWN) {
-    _baudRate = _detectBauds(destinationAddress);
+  if (profileModel != MYCILA_JSY_MK_UNKNOWN) {
+    LOGD(TAG, "JSY @ 0x%02X bauds detection skipped", destinationAddress);
+
+  } else if (baudRate == BaudRate::UNKNOWN) {
+    _baudRate = _detectBauds(destinationAddress, model);
 
     if (_baudRate == BaudRate::UNKNOWN) {
       if (_lastAddress == MYCILA_JSY_ADDRESS_UNKNOWN)
@@ -445,7 +808,7 @@ void Mycila::JSY::begin(HardwareSerial& serial,
       else
         LOGE(TAG, "Unable to read any JSY @ 0x%02X at any supported speed but found one @ 0x%02X.", destinationAddress, _lastAddress);
 
-      _serial->end();
+      _closeSerial();
       return;
     }
 
@@ -455,7 +818,7 @@ void Mycila::JSY::begin(HardwareSerial& serial,
 
     _baudRate = BaudRate::UNKNOWN;
     for (int j = 0; j < MYCILA_JSY_RETRY_COUNT; j++) {
-      if (_canRead(destinationAddress, baudRate)) {
+      if (_canRead(destinationAddress, baudRate, firstByteTimeout(model))) {
         _baudRate = baudRate;
         break;
       }
@@ -463,31 +826,62 @@ void Mycila::JSY::begin(HardwareSerial& serial,
 
     if (_baudRate == BaudRate::UNKNOWN) {
       LOGE(TAG, "Unable to read any JSY @ 0x%02X at speed: %" PRIu32, destinationAddress, baudRate);
-      _serial->end();
+      _closeSerial();
       return;
     }
   }
 
   _enabled = true;
-  _model = model ? model : readModel(destinationAddress);
-
-  if (_model != MYCILA_JSY_MK_1031 &&
-      _model != MYCILA_JSY_MK_163 &&
-      _model != MYCILA_JSY_MK_193 &&
-      _model != MYCILA_JSY_MK_194 &&
-      _model != MYCILA_JSY_MK_227 &&
-      _model != MYCILA_JSY_MK_229 &&
-      _model != MYCILA_JSY_MK_333) {
+  _model = model ? model : (profileModel ? profileModel : readModel(destinationAddress));
+
+  if (findRegisterMap(_model) == nullptr) {
     LOGE(TAG, "Unsupported JSY model: JSY-MK-%X", _model);
     // unsupported
     _enabled = false;
-    _serial->end();
+    _closeSerial();
     return;
   }
 
   _destinationAddress = destinationAddress;
   LOGI(TAG, "Detected JSY-MK-%X @ 0x%02X with speed %" PRIu32 " bauds", _model, _lastAddress, _baudRate);
 
+  // the mode and the baud rate negotiation are kept as long as the device is the same
+  const bool same = _profile.address == _lastAddress && _profile.model == _model;
+  _profile.address = _lastAddress;
+  _profile.model = _model;
+  _profile.baudRate = _baudRate;
+  _profile.mode = same ? _profile.mode : Mode::UNKNOWN;
+  _profile.negotiated = same && _profile.negotiated;
+
+  if (_baudRateUpgrade && !_profile.negotiated) {
+    // recorded with the new baud rate
+    _profile.negotiated = true;
+    if (!_upgradeBaudRate()) {
+      _enabled = false;
+      _closeSerial();
+      return;
+    }
+  }
+
+  _saveProfile();
+
+  // the auto-tuning aims at the baud rate of the device at startup
+  setBaudRateTuning(_tuning);
+
+  _connectionState = ConnectionState::CONNECTED;
+  _failures = 0;
+  _timeouts = 0;
+  _rediscoveryBackoff = 0;
+
+  if (async && _pipeline) {
+    _pipelineFrames.reset(new Frame[MYCILA_JSY_PIPELINE_DEPTH]);
+    _pipelineHead = 0;
+    _pipelineTail = 0;
+    _pipelineDropped = 0;
+    _pipelineMaxDepth = 0;
+    assert(xTaskCreateUniversal(_pipelineTask, "jsyPipelineTask", _pipelineStackSize, this, MYCILA_JSY_ASYNC_PRIORITY, &_pipelineTaskHandle, _pipelineCore) == pdPASS);
+  }
+
   assert(!async || xTaskCreateUniversal(_jsyTask, "jsyTask", stackSize, this, MYCILA_JSY_ASYNC_PRIORITY, &_taskHandle, core) == pdPASS);
 }
 
@@ -499,14 +893,24 @@ void Mycila::JSY::end() {
       // JSY takes at least 40-160 ms to finish a read
       delay(50);
     }
+    // the decoding task processes the remaining frames then exits
+    while (_pipelineTaskHandle != NULL) {
+      xTaskNotifyGive(_pipelineTaskHandle);
+      delay(10);
+    }
+    _pipelineFrames.reset();
+    if (_energy)
+      _energy->flush();
     std::lock_guard<std::mutex> lock(_mutex);
     LOGD(TAG, "Closing Serial for JSY @ 0x%02X", _destinationAddress);
-    _serial->end();
+    _closeSerial();
     _serial = nullptr;
     _baudRate = BaudRate::UNKNOWN;
     _lastAddress = MYCILA_JSY_ADDRESS_UNKNOWN;
     _model = MYCILA_JSY_MK_UNKNOWN;
     _data.clear();
+    _publish();
+    _turnaround.clear();
   }
 }
 
@@ -514,380 +918,488 @@ void Mycila::JSY::end() {
 // read
 ///////////////////////////////////////////////////////////////////////////////
 
-bool Mycila::JSY::_read(const uint8_t address, uint16_t model) {
+bool Mycila::JSY::_read(const uint8_t address, uint16_t model, ReadResult& result) {
+  result = ReadResult::READ_TIMEOUT;
   if (!_enabled)
     return false;
 
-  std::lock_guard<std::mutex> lock(_mutex);
+  bool success;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    success = _pipelineTaskHandle != NULL ? _readToPipeline(address, model) : _read(address, model, _fields, _readPlan, _turnaround, _data, _publisher, _energy);
+    result = _readResult;
+  }
+
+  // a baud rate change takes the lock
+  if (_tuning && address == _destinationAddress)
+    _tuneBaudRate(result);
+
+  return success;
+}
+
+bool Mycila::JSY::_read(const uint8_t address, const uint16_t model, const uint32_t fields, ReadPlan& plan, Turnaround& turnaround, Data& data, const Callback& callback, JSYEnergy* energy) {
+  const uint8_t* registers = nullptr;
+  const ReadResult result = _readRegisters(address, model, fields, plan, turnaround, registers);
+  return _process(result, _buffer[JSY_RESPONSE_ADDRESS], model, plan.decoded, registers, millis(), esp_timer_get_time(), data, callback, energy);
+}
 
+Mycila::JSY::ReadResult Mycila::JSY::_readRegisters(const uint8_t address, const uint16_t model, const uint32_t fields, ReadPlan& plan, Turnaround& turnaround, const uint8_t*& registers) {
 #ifdef MYCILA_JSY_DEBUG
   Serial.printf("[JSY] read(0x%02X)\n", address);
 #endif
 
-  memcpy(_buffer, JSY_REQUEST_READ_REGISTERS, JSY_REQUEST_READ_REGISTERS_LEN);
+  // registers to read depend on the model and on the selected fields
+  if (!_planRead(plan, model, fields)) {
+    LOGD(TAG, "read(0x%02X) error: unsupported model 0x%04X", address, model);
+    _instrumentation.errorModel++;
+    _readResult = ReadResult::READ_ERROR_MODEL;
+    return ReadResult::READ_ERROR_MODEL;
+  }
 
-  // fill the request with the registers to read
-  // this depends on the model
-  uint16_t registerStart = 0;
-  uint16_t registerCount = 0;
-  uint8_t registerSize = 0;
+  const JSYRegisterMap* map = findRegisterMap(model);
+  const bool partial = plan.count != 1 || plan.windows[0].count != map->registerCount;
+  ReadResult result = ReadResult::READ_SUCCESS;
 
-  switch (model) {
-    case MYCILA_JSY_MK_1031:
-      registerSize = JSY_1031_REGISTER_LEN;
-      registerStart = JSY_1031_REGISTER_START;
-      registerCount = JSY_1031_REGISTER_COUNT;
-      break;
+  for (size_t i = 0; i < plan.count && result == ReadResult::READ_SUCCESS; i++) {
+    const uint16_t registerStart = map->registerStart + plan.windows[i].start;
+    const uint16_t registerCount = plan.windows[i].count;
 
-    case MYCILA_JSY_MK_163:
-      registerSize = JSY_163_REGISTER_LEN;
-      registerStart = JSY_163_REGISTER_START;
-      registerCount = JSY_163_REGISTER_COUNT;
-      break;
+    memcpy(_buffer, JSY_REQUEST_READ_REGISTERS, JSY_REQUEST_READ_REGISTERS_LEN);
+    _buffer[JSY_REQUEST_READ_REGISTER_ADDR_HIGH] = HIBYTE(registerStart);
+    _buffer[JSY_REQUEST_READ_REGISTER_ADDR_LOW] = LOBYTE(registerStart);
+    _buffer[JSY_REQUEST_READ_REGISTER_COUNT_HIGH] = HIBYTE(registerCount);
+    _buffer[JSY_REQUEST_READ_REGISTER_COUNT_LOW] = LOBYTE(registerCount);
 
-    case MYCILA_JSY_MK_193:
-      registerSize = JSY_193_REGISTER_LEN;
-      registerStart = JSY_193_REGISTER_START;
-      registerCount = JSY_193_REGISTER_COUNT;
-      break;
+    _send(address, JSY_REQUEST_READ_REGISTERS_LEN);
+    result = _timedRead(address, JSY_RESPONSE_SIZE_READ + registerCount * map->registerSize, _baudRate, turnaround.getTimeout(model));
 
-    case MYCILA_JSY_MK_194:
-      registerSize = JSY_194_REGISTER_LEN;
-      registerStart = JSY_194_REGISTER_START;
-      registerCount = JSY_194_REGISTER_COUNT;
-      break;
+    if (_lastTurnaround)
+      turnaround.update(_lastTurnaround);
 
-    case MYCILA_JSY_MK_227:
-    case MYCILA_JSY_MK_229:
-      registerSize = JSY_22x_REGISTER_LEN;
-      registerStart = JSY_22x_REGISTER_START;
-      registerCount = JSY_22x_REGISTER_COUNT;
-      break;
+    // several windows: rebuild the register image
+    if (partial && result == ReadResult::READ_SUCCESS)
+      memcpy(_registers + plan.windows[i].start * map->registerSize, _buffer + JSY_RESPONSE_DATA, registerCount * map->registerSize);
+  }
 
-    case MYCILA_JSY_MK_333:
-      registerSize = JSY_333_REGISTER_LEN;
-      registerStart = JSY_333_REGISTER_START;
-      registerCount = JSY_333_REGISTER_COUNT;
-      break;
+  if (result == ReadResult::READ_TIMEOUT) {
+    // a late response must not collide with the next request: keep the line idle for the longest response time seen
+    _idleUs = std::max(_idleUs, turnaround.max);
+  }
+
+  registers = partial ? _registers : _buffer + JSY_RESPONSE_DATA;
+  _readResult = result;
+  return result;
+}
+
+bool Mycila::JSY::_process(const ReadResult result, const uint8_t address, const uint16_t model, const uint32_t fields, const uint8_t* registers, const uint32_t time, const int64_t timestamp, Data& data, const Callback& callback, JSYEnergy* energy) {
+  switch (result) {
+    case ReadResult::READ_SUCCESS: {
+      data.address = address;
+      data.model = model;
+      const uint32_t start = micros();
+      _decode(model, registers, data, fields);
+      _instrumentation.decode.add(micros() - start);
+      if (energy)
+        energy->_add(model, registers, fields, data, timestamp);
+      // the reads of the devices of a JSYBus have their own data
+      if (&data == &_data)
+        _time = time;
+      if (callback) {
+        const uint32_t start = micros();
+        callback(EventType::EVT_READ, data);
+        _instrumentation.callback.add(micros() - start);
+      }
+      return true;
+    }
+
+    case ReadResult::READ_TIMEOUT:
+      // reset live values in case of read timeout
+      data.clear();
+      if (callback) {
+        callback(EventType::EVT_READ_TIMEOUT, data);
+      }
+      return false;
+
+    case ReadResult::READ_ERROR_COUNT:
+    case ReadResult::READ_ERROR_CRC:
+      // reset live values in case of read failure
+      data.clear();
+      if (callback) {
+        callback(EventType::EVT_READ_ERROR, data);
+      }
+      return false;
+
+    case ReadResult::READ_ERROR_ADDRESS:
+      // we have set a destination address, but we read another device
+      if (callback) {
+        callback(EventType::EVT_READ_ERROR, data);
+      }
+      return false;
 
     default:
-      break;
+      return false;
+  }
+}
+
+void Mycila::JSY::setFields(uint32_t fields) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _fields = fields & FIELD_ALL;
+  // values of fields not read anymore must not stay in data
+  if (_pipelineTaskHandle != NULL) {
+    // data belongs to the decoding task
+    _pipelineClear = true;
+  } else {
+    _data.clear();
+    _publish();
   }
+}
 
-  _buffer[JSY_REQUEST_READ_REGISTER_ADDR_HIGH] = HIBYTE(registerStart);
-  _buffer[JSY_REQUEST_READ_REGISTER_ADDR_LOW] = LOBYTE(registerStart);
-  _buffer[JSY_REQUEST_READ_REGISTER_COUNT_HIGH] = HIBYTE(registerCount);
-  _buffer[JSY_REQUEST_READ_REGISTER_COUNT_LOW] = LOBYTE(registerCount);
+void Mycila::JSY::_publish() {
+  uint32_t generation = _generation.load(std::memory_order_relaxed) + 1;
+  // 0 means nothing published: skip it while keeping the slots alternating
+  if (generation == 0)
+    generation = 2;
+  const size_t slot = generation % 2;
+  // readers copy the other slot, unless they are slower than 2 publications
+  _snapshotSeq[slot].fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _snapshots[slot].data = _data;
+  _snapshots[slot].time = _time;
+  _snapshots[slot].generation = generation;
+  _snapshotSeq[slot].fetch_add(1, std::memory_order_release);
+  _generation.store(generation, std::memory_order_release);
+}
 
-  _send(address, JSY_REQUEST_READ_REGISTERS_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ + registerCount * registerSize, _baudRate);
+void Mycila::JSY::_event(const EventType eventType) {
+  if (_pipelineTaskHandle != NULL) {
+    // data belongs to the decoding task
+    _pendingEvents.fetch_or(1UL << static_cast<uint32_t>(eventType));
+    xTaskNotifyGive(_pipelineTaskHandle);
+  } else {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _notify(eventType, _data);
+  }
+}
 
-  if (result == ReadResult::READ_TIMEOUT) {
-    // reset live values in case of read timeout
-    _data.clear();
-    if (_callback) {
-      _callback(EventType::EVT_READ_TIMEOUT, _data);
+void Mycila::JSY::_notify(const EventType eventType, const Data& data) {
+  _publish();
+
+  uint32_t changed = FIELD_ALL;
+
+  if (eventType == EventType::EVT_READ) {
+    if (_stats)
+      _stats->add(data, _time);
+
+    const bool filtered = _deadbandFields || _maxSilence;
+    if (filtered || _changeCallback) {
+      changed = _changedFields(data);
+      if (filtered && _notified.model != MYCILA_JSY_MK_UNKNOWN) {
+        const bool due = _maxSilence && _time - _notifiedTime >= _maxSilence;
+        if (!(changed & _deadbandFields) && !due)
+          return;
+      }
+      _notified = data;
+      _notifiedTime = _time;
     }
-    return false;
+  } else {
+    // the next read is notified
+    _notified.clear();
   }
 
-  if (result == ReadResult::READ_ERROR_COUNT || result == ReadResult::READ_ERROR_CRC) {
-    // reset live values in case of read failure
-    _data.clear();
-    if (_callback) {
-      _callback(EventType::EVT_READ_ERROR, _data);
+  _changed = changed;
+
+  if (_callback)
+    _callback(eventType, data);
+  if (_changeCallback)
+    _changeCallback(eventType, data, changed);
+}
+
+uint32_t Mycila::JSY::_changedFields(const Data& data) const {
+  const Metrics* current[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+  const Metrics* notified[] = {&_notified._metrics[0], &_notified._metrics[1], &_notified._metrics[2], &_notified.aggregate};
+  uint32_t changed = FIELD_NONE;
+  for (size_t i = 0; i < FIELD_COUNT; i++) {
+    const FieldTarget& target = FIELD_TARGETS[i];
+    for (size_t c = 0; c < 4; c++) {
+      double value;
+      double reference;
+      if (target.real) {
+        value = current[c]->*target.real;
+        reference = notified[c]->*target.real;
+        if (std::isnan(value) || std::isnan(reference)) {
+          if (std::isnan(value) != std::isnan(reference)) {
+            changed |= 1UL << i;
+            break;
+          }
+          continue;
+        }
+      } else {
+        value = current[c]->*target.counter;
+        reference = notified[c]->*target.counter;
+      }
+      if (std::abs(value - reference) > std::max<double>(_deadbandAbsolute[i], _deadbandRelative[i] * std::abs(reference))) {
+        changed |= 1UL << i;
+        break;
+      }
     }
-    return false;
   }
+  return changed;
+}
 
-  if (result == ReadResult::READ_ERROR_ADDRESS) {
-    // we have set a destination address, but we read another device
-    if (_callback) {
-      _callback(EventType::EVT_READ_ERROR, _data);
+void Mycila::JSY::setDeadband(const uint32_t fields, const float absolute, const float relative) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (size_t i = 0; i < FIELD_COUNT; i++) {
+    if (fields & (1UL << i)) {
+      _deadbandAbsolute[i] = absolute;
+      _deadbandRelative[i] = relative;
+      _deadbandFields |= 1UL << i;
     }
-    return false;
   }
+}
+
+void Mycila::JSY::clearDeadbands() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _deadbandFields = FIELD_NONE;
+  memset(_deadbandAbsolute, 0, sizeof(_deadbandAbsolute));
+  memset(_deadbandRelative, 0, sizeof(_deadbandRelative));
+}
+
+bool Mycila::JSY::getSnapshot(Snapshot& snapshot) const {
+  while (true) {
+    const uint32_t generation = _generation.load(std::memory_order_acquire);
+    if (generation == snapshot.generation)
+      return false;
+    const size_t slot = generation % 2;
+    const uint32_t seq = _snapshotSeq[slot].load(std::memory_order_acquire);
+    // slot being rewritten: a newer generation is being published
+    if (seq % 2)
+      continue;
+    snapshot = _snapshots[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_snapshotSeq[slot].load(std::memory_order_relaxed) == seq)
+      return true;
+  }
+}
 
-  assert(result == ReadResult::READ_SUCCESS);
+void Mycila::JSY::Turnaround::update(const uint32_t us) {
+  average = count == 0 ? us : average + JSY_TURNAROUND_SMOOTHING * (static_cast<float>(us) - average);
+  max = std::max(max, us);
+  count++;
+}
 
-  _data.address = _buffer[JSY_RESPONSE_ADDRESS];
-  _data.model = model;
+void Mycila::JSY::Instrumentation::Phase::add(const uint32_t us) {
+  count++;
+  total += us;
+  last = us;
+  max = std::max(max, us);
+}
 
-  switch (model) {
-    case MYCILA_JSY_MK_1031: {
-      // single channel
-      _data._metrics[0].frequency = _register16(_buffer, registerStart, registerSize, JSY_1031_REGISTER_FREQUENCY) * 0.01f;
-      _data._metrics[0].voltage = _register16(_buffer, registerStart, registerSize, JSY_1031_REGISTER_VOLTAGE) * 0.01f;
-      _data._metrics[0].current = _register32(_buffer, registerStart, registerSize, JSY_1031_REGISTER_CURRENT) * 0.0001f;
-      _data._metrics[0].activePower = _register32(_buffer, registerStart, registerSize, JSY_1031_REGISTER_ACTIVE_POWER) * 0.0001f; // note: spec says /100 but in reality this is /10000
-      _data._metrics[0].activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_1031_REGISTER_ACTIVE_ENERGY) * 10;
-      _data._metrics[0].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_1031_REGISTER_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].apparentPower = _register32(_buffer, registerStart, registerSize, JSY_1031_REGISTER_APPARENT_POWER) * 0.0001f; // note: spec says /100 but in reality this is /10000
-      _data._metrics[0].reactivePower = _register32(_buffer, registerStart, registerSize, JSY_1031_REGISTER_REACTIVE_POWER) * 0.0001f; // note: spec says /100 but in reality this is /10000
-
-      // aggregate
-      _data.aggregate = _data._metrics[0];
+uint32_t Mycila::JSY::Turnaround::getTimeout(const uint16_t model) const {
+  const uint32_t upper = firstByteTimeout(model);
+  if (count < MYCILA_JSY_TURNAROUND_SAMPLES)
+    return upper;
+  // 25% above the worst response seen and 50% above the average, rounded up to the next tick
+  const uint32_t us = std::max(max + max / 4, static_cast<uint32_t>(average * 1.5f));
+  return std::clamp(static_cast<uint32_t>((us + 999) / 1000 + 1), static_cast<uint32_t>(MYCILA_JSY_TURNAROUND_MIN_TIMEOUT_MS), upper);
+}
 
-      break;
-    }
+bool Mycila::JSY::_planRead(ReadPlan& plan, const uint16_t model, const uint32_t fields) {
+  if (plan.model == model && plan.fields == fields)
+    return plan.count > 0;
 
-    case MYCILA_JSY_MK_163: {
-      // signs
-      // _buffer[19] unused
-      // _buffer[20] is the sign of power
-      uint8_t sign = _register8(_buffer, registerStart, registerSize, JSY_163_REGISTER_ACTIVE_POWER_SIGN, 1);
-
-      // single channel
-      _data._metrics[0].frequency = _register16(_buffer, registerStart, registerSize, JSY_163_REGISTER_FREQUENCY) * 0.01f;
-      _data._metrics[0].voltage = _register16(_buffer, registerStart, registerSize, JSY_163_REGISTER_VOLTAGE) * 0.01f;
-      _data._metrics[0].current = _register16(_buffer, registerStart, registerSize, JSY_163_REGISTER_CURRENT) * 0.01f;
-      _data._metrics[0].activePower = _register16(_buffer, registerStart, registerSize, JSY_163_REGISTER_ACTIVE_POWER) * (sign ? -1.0f : 1.0f);
-      _data._metrics[0].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_163_REGISTER_ACTIVE_ENERGY_IMPORTED) * 5.0f / 16.0f;
-      _data._metrics[0].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_163_REGISTER_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_163_REGISTER_ACTIVE_ENERGY_RETURNED) * 5.0f / 16.0f;
-
-      // calculate remaining metrics
-      // S = P / PF
-      _data._metrics[0].apparentPower = _data._metrics[0].powerFactor == 0 ? 0 : std::abs(_data._metrics[0].activePower / _data._metrics[0].powerFactor);
-      // Q = std::sqrt(S^2 - P^2)
-      _data._metrics[0].reactivePower = std::sqrt(_data._metrics[0].apparentPower * _data._metrics[0].apparentPower - _data._metrics[0].activePower * _data._metrics[0].activePower);
-      // E = Ei + Er
-      _data._metrics[0].activeEnergy = _data._metrics[0].activeEnergyImported + _data._metrics[0].activeEnergyReturned;
-
-      // aggregate
-      _data.aggregate = _data._metrics[0];
+  plan.model = model;
+  plan.fields = fields;
+  plan.decoded = fields;
+  plan.count = 0;
 
-      break;
-    }
+  const JSYRegisterMap* map = findRegisterMap(model);
+  if (map == nullptr)
+    return false;
 
-    case MYCILA_JSY_MK_193: {
-      // channel 1
-      _data._metrics[0].voltage = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_VOLTAGE) * 0.01f;
-      _data._metrics[0].current = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_CURRENT) * 0.01f;
-      _data._metrics[0].activePower = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_ACTIVE_POWER) * (_register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_ACTIVE_POWER_SIGN) ? -1.0f : 1.0f);
-      _data._metrics[0].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_ACTIVE_ENERGY_POSITIVE) * 10;
-      _data._metrics[0].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_ACTIVE_ENERGY_NEGATIVE) * 10;
-      _data._metrics[0].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].frequency = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH1_FREQUENCY) * 0.01f;
-
-      // channel 2
-      _data._metrics[1].voltage = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_VOLTAGE) * 0.01f;
-      _data._metrics[1].current = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_CURRENT) * 0.01f;
-      _data._metrics[1].activePower = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_ACTIVE_POWER) * (_register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_ACTIVE_POWER_SIGN) ? -1.0f : 1.0f);
-      _data._metrics[1].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_ACTIVE_ENERGY_POSITIVE) * 10;
-      _data._metrics[1].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_ACTIVE_ENERGY_NEGATIVE) * 10;
-      _data._metrics[1].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_POWER_FACTOR) * 0.001f;
-      _data._metrics[1].frequency = _register16(_buffer, registerStart, registerSize, JSY_193_REGISTER_CH2_FREQUENCY) * 0.01f;
-
-      // calculate remaining metrics
-      // S = P / PF
-      _data._metrics[0].apparentPower = _data._metrics[0].powerFactor == 0 ? 0 : std::abs(_data._metrics[0].activePower / _data._metrics[0].powerFactor);
-      _data._metrics[1].apparentPower = _data._metrics[1].powerFactor == 0 ? 0 : std::abs(_data._metrics[1].activePower / _data._metrics[1].powerFactor);
-      // Q = std::sqrt(S^2 - P^2)
-      _data._metrics[0].reactivePower = std::sqrt(_data._metrics[0].apparentPower * _data._metrics[0].apparentPower - _data._metrics[0].activePower * _data._metrics[0].activePower);
-      _data._metrics[1].reactivePower = std::sqrt(_data._metrics[1].apparentPower * _data._metrics[1].apparentPower - _data._metrics[1].activePower * _data._metrics[1].activePower);
-      // E = Ei + Er
-      _data._metrics[0].activeEnergy = _data._metrics[0].activeEnergyImported + _data._metrics[0].activeEnergyReturned;
-      _data._metrics[1].activeEnergy = _data._metrics[1].activeEnergyImported + _data._metrics[1].activeEnergyReturned;
-
-      // aggregate
-      _data.aggregate = _data._metrics[0];
-      _data.aggregate += _data._metrics[1];
-      _data.aggregate.voltage = std::max(_data._metrics[0].voltage, _data._metrics[1].voltage);
-      _data.aggregate.frequency = std::max(_data._metrics[0].frequency, _data._metrics[1].frequency);
+  if (fields == FIELD_ALL) {
+    plan.windows[0] = {0, map->registerCount};
+    plan.count = 1;
+    return true;
+  }
 
-      break;
+  // mark the registers holding the selected fields and their signs
+  plan.decoded = requiredFields(*map, fields);
+  bool needed[JSY_333_REGISTER_COUNT] = {false};
+  for (const JSYField* field = map->fields; field != map->fields + map->fieldCount; field++) {
+    if (!(field->field & plan.decoded))
+      continue;
+    const size_t last = (field->offset + field->width - 1) / map->registerSize;
+    for (size_t i = field->offset / map->registerSize; i <= last; i++)
+      needed[i] = true;
+    if (field->signMask)
+      needed[field->signOffset / map->registerSize] = true;
+  }
+
+  // group them in windows, merging windows separated by less than MYCILA_JSY_READ_WINDOWS_GAP bytes
+  const size_t gap = MYCILA_JSY_READ_WINDOWS_GAP / map->registerSize;
+  for (size_t i = 0; i < map->registerCount; i++) {
+    if (!needed[i])
+      continue;
+    ReadPlan::Window* last = plan.count ? &plan.windows[plan.count - 1] : nullptr;
+    if (last && i - last->start - last->count <= gap) {
+      last->count = i - last->start + 1;
+    } else if (plan.count < MYCILA_JSY_READ_WINDOWS_MAX) {
+      plan.windows[plan.count++] = {static_cast<uint8_t>(i), 1};
+    } else {
+      // no more window available: extend the last one
+      last->count = i - last->start + 1;
     }
+  }
 
-    case MYCILA_JSY_MK_194: {
-      // signs
-      // _buffer[27] is the sign of power1
-      // _buffer[28] is the sign of power2
-      // _buffer[29] unused
-      // _buffer[30] unused
-      uint8_t sign0 = _register8(_buffer, registerStart, registerSize, JSY_194_REGISTER_ACTIVE_POWER_SIGNS, 0);
-      uint8_t sign1 = _register8(_buffer, registerStart, registerSize, JSY_194_REGISTER_ACTIVE_POWER_SIGNS, 1);
-
-      // frequency
-      float frequency = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_FREQUENCY) * 0.01f;
-
-      // channel 1
-      _data._metrics[0].frequency = frequency;
-      _data._metrics[0].voltage = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_VOLTAGE) * 0.0001f;
-      _data._metrics[0].current = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_CURRENT) * 0.0001f;
-      _data._metrics[0].activePower = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_ACTIVE_POWER) * (sign0 ? -0.0001f : 0.0001f);
-      _data._metrics[0].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_ACTIVE_ENERGY_IMPORTED) * 0.1f;
-      _data._metrics[0].powerFactor = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH1_ACTIVE_ENERGY_RETURNED) * 0.1f;
-
-      // channel 2
-      _data._metrics[1].frequency = frequency;
-      _data._metrics[1].voltage = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_VOLTAGE) * 0.0001f;
-      _data._metrics[1].current = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_CURRENT) * 0.0001f;
-      _data._metrics[1].activePower = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_ACTIVE_POWER) * (sign1 ? -0.0001f : 0.0001f);
-      _data._metrics[1].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_ACTIVE_ENERGY_IMPORTED) * 0.1f;
-      _data._metrics[1].powerFactor = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_POWER_FACTOR) * 0.001f;
-      _data._metrics[1].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_194_REGISTER_CH2_ACTIVE_ENERGY_RETURNED) * 0.1f;
-
-      // calculate remaining metrics
-      // S = P / PF
-      _data._metrics[0].apparentPower = _data._metrics[0].powerFactor == 0 ? 0 : std::abs(_data._metrics[0].activePower / _data._metrics[0].powerFactor);
-      _data._metrics[1].apparentPower = _data._metrics[1].powerFactor == 0 ? 0 : std::abs(_data._metrics[1].activePower / _data._metrics[1].powerFactor);
-      // Q = std::sqrt(S^2 - P^2)
-      _data._metrics[0].reactivePower = std::sqrt(_data._metrics[0].apparentPower * _data._metrics[0].apparentPower - _data._metrics[0].activePower * _data._metrics[0].activePower);
-      _data._metrics[1].reactivePower = std::sqrt(_data._metrics[1].apparentPower * _data._metrics[1].apparentPower - _data._metrics[1].activePower * _data._metrics[1].activePower);
-      // E = Ei + Er
-      _data._metrics[0].activeEnergy = _data._metrics[0].activeEnergyImported + _data._metrics[0].activeEnergyReturned;
-      _data._metrics[1].activeEnergy = _data._metrics[1].activeEnergyImported + _data._metrics[1].activeEnergyReturned;
-
-      // aggregate
-      _data.aggregate = _data._metrics[0];
-      _data.aggregate += _data._metrics[1];
-      _data.aggregate.frequency = frequency;
-      _data.aggregate.voltage = std::max(_data._metrics[0].voltage, _data._metrics[1].voltage);
+  // no register to read: read the smallest one to check the device is still there
+  if (plan.count == 0)
+    plan.windows[plan.count++] = {0, 1};
 
-      break;
-    }
+  for (size_t i = 0; i < plan.count; i++)
+    LOGD(TAG, "JSY-MK-%X read window %u: 0x%04X, %u registers", model, static_cast<unsigned>(i), map->registerStart + plan.windows[i].start, plan.windows[i].count);
 
-    case MYCILA_JSY_MK_227:
-    case MYCILA_JSY_MK_229: {
-      // single channel
-      _data._metrics[0].voltage = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_VOLTAGE) * 0.0001f;
-      _data._metrics[0].current = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_CURRENT) * 0.0001f;
-      _data._metrics[0].activePower = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_ACTIVE_POWER) * (_register16(_buffer, registerStart, registerSize, JSY_22x_REGISTER_ACTIVE_POWER_SIGN) ? -0.0001f : 0.0001f);
-      _data._metrics[0].reactivePower = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_REACTIVE_POWER) * (_register16(_buffer, registerStart, registerSize, JSY_22x_REGISTER_REACTIVE_POWER_SIGN) ? -0.0001f : 0.0001f);
-      _data._metrics[0].apparentPower = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_APPARENT_POWER) * 0.0001f;
-      _data._metrics[0].powerFactor = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].frequency = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_FREQUENCY) * 0.01f;
-      _data._metrics[0].activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_ACTIVE_ENERGY);
-      _data._metrics[0].reactiveEnergy = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_REACTIVE_ENERGY);
-      _data._metrics[0].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_ACTIVE_ENERGY_POSITIVE);
-      _data._metrics[0].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_ACTIVE_ENERGY_NEGATIVE);
-      _data._metrics[0].reactiveEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_REACTIVE_ENERGY_POSITIVE);
-      _data._metrics[0].reactiveEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_22x_REGISTER_REACTIVE_ENERGY_NEGATIVE);
-
-      // aggregate
-      _data.aggregate = _data._metrics[0];
+  return true;
+}
 
-      break;
+void Mycila::JSY::_decode(const uint16_t model, const uint8_t* registers, Data& data, const uint32_t fields) {
+  const JSYRegisterMap* map = findRegisterMap(model);
+  if (map == nullptr)
+    return;
+
+  Metrics* targets[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+
+  for (const JSYField* field = map->fields; field != map->fields + map->fieldCount; field++) {
+    if (!(field->field & fields))
+      continue;
+    const uint32_t raw = readRegister(registers + field->offset, field->width);
+    Metrics& metrics = *targets[field->channel];
+    if (field->real) {
+      const bool negative = field->signMask && (readRegister(registers + field->signOffset, 2) & field->signMask);
+      metrics.*(field->real) = raw * (negative ? -field->scale : field->scale);
+    } else if (field->den == 1) {
+      metrics.*(field->counter) = raw * field->num;
+    } else {
+      metrics.*(field->counter) = static_cast<uint32_t>(static_cast<uint64_t>(raw) * field->num / field->den);
     }
+  }
 
-    case MYCILA_JSY_MK_333: {
-      // signs
-      // _buffer[103] unused
-      // _buffer[104] bit 7: sign of total reactive power
-      // _buffer[104] bit 6: sign of phase C reactive power
-      // _buffer[104] bit 5: sign of phase B reactive power
-      // _buffer[104] bit 4: sign of phase A reactive power
-      // _buffer[104] bit 3: sign of total active power
-      // _buffer[104] bit 2: sign of phase C active power
-      // _buffer[104] bit 1: sign of phase B active power
-      // _buffer[104] bit 0: sign of phase A active power
-      uint8_t sign7 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x80;
-      uint8_t sign6 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x40;
-      uint8_t sign5 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x20;
-      uint8_t sign4 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x10;
-      uint8_t sign3 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x08;
-      uint8_t sign2 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x04;
-      uint8_t sign1 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x02;
-      uint8_t sign0 = _register8(_buffer, registerStart, registerSize, JSY_333_REGISTER_POWER_SIGNS, 1) & 0x01;
-
-      // frequency
-      float frequency = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_FREQUENCY) * 0.01f;
-
-      // phase A
-      _data._metrics[0].frequency = frequency;
-      _data._metrics[0].voltage = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_VOLTAGE) * 0.01f;
-      _data._metrics[0].current = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_CURRENT) * 0.01f;
-      _data._metrics[0].activePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_ACTIVE_POWER) * (sign0 ? -1.0f : 1.0f);
-      _data._metrics[0].reactivePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_REACTIVE_POWER) * (sign4 ? -1.0f : 1.0f);
-      _data._metrics[0].apparentPower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_APPARENT_POWER);
-      _data._metrics[0].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_POWER_FACTOR) * 0.001f;
-      _data._metrics[0].activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_ACTIVE_ENERGY) * 10;
-      _data._metrics[0].reactiveEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_REACTIVE_ENERGY) * 10;
-      _data._metrics[0].apparentEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_APPARENT_ENERGY) * 10;
-      _data._metrics[0].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_ACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[0].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_ACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[0].reactiveEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_REACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[0].reactiveEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_REACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[0].phaseAngleU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_PHASE_ANGLE_U) * 0.01f;
-      _data._metrics[0].phaseAngleI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_PHASE_ANGLE_I) * 0.01f;
-      _data._metrics[0].phaseAngleUI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_PHASE_ANGLE_UI) * 0.01f;
-      _data._metrics[0].thdU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_THD_U) * 0.01f;
-      _data._metrics[0].thdI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_A_THD_I) * 0.01f;
-
-      // phase B
-      _data._metrics[1].frequency = frequency;
-      _data._metrics[1].voltage = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_VOLTAGE) * 0.01f;
-      _data._metrics[1].current = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_CURRENT) * 0.01f;
-      _data._metrics[1].activePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_ACTIVE_POWER) * (sign1 ? -1.0f : 1.0f);
-      _data._metrics[1].reactivePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_REACTIVE_POWER) * (sign5 ? -1.0f : 1.0f);
-      _data._metrics[1].apparentPower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_APPARENT_POWER);
-      _data._metrics[1].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_POWER_FACTOR) * 0.001f;
-      _data._metrics[1].activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_ACTIVE_ENERGY) * 10;
-      _data._metrics[1].reactiveEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_REACTIVE_ENERGY) * 10;
-      _data._metrics[1].apparentEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_APPARENT_ENERGY) * 10;
-      _data._metrics[1].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_ACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[1].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_ACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[1].reactiveEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_REACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[1].reactiveEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_REACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[1].phaseAngleU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_PHASE_ANGLE_U) * 0.01f;
-      _data._metrics[1].phaseAngleI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_PHASE_ANGLE_I) * 0.01f;
-      _data._metrics[1].phaseAngleUI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_PHASE_ANGLE_UI) * 0.01f;
-      _data._metrics[1].thdU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_THD_U) * 0.01f;
-      _data._metrics[1].thdI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_B_THD_I) * 0.01f;
-
-      // phase C
-      _data._metrics[2].frequency = frequency;
-      _data._metrics[2].voltage = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_VOLTAGE) * 0.01f;
-      _data._metrics[2].current = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_CURRENT) * 0.01f;
-      _data._metrics[2].activePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_ACTIVE_POWER) * (sign2 ? -1.0f : 1.0f);
-      _data._metrics[2].reactivePower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_REACTIVE_POWER) * (sign6 ? -1.0f : 1.0f);
-      _data._metrics[2].apparentPower = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_APPARENT_POWER);
-      _data._metrics[2].powerFactor = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_POWER_FACTOR) * 0.001f;
-      _data._metrics[2].activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_ACTIVE_ENERGY) * 10;
-      _data._metrics[2].reactiveEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_REACTIVE_ENERGY) * 10;
-      _data._metrics[2].apparentEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_APPARENT_ENERGY) * 10;
-      _data._metrics[2].activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_ACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[2].activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_ACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[2].reactiveEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_REACTIVE_ENERGY_IMPORTED) * 10;
-      _data._metrics[2].reactiveEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_REACTIVE_ENERGY_RETURNED) * 10;
-      _data._metrics[2].phaseAngleU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_PHASE_ANGLE_U) * 0.01f;
-      _data._metrics[2].phaseAngleI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_PHASE_ANGLE_I) * 0.01f;
-      _data._metrics[2].phaseAngleUI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_PHASE_ANGLE_UI) * 0.01f;
-      _data._metrics[2].thdU = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_THD_U) * 0.01f;
-      _data._metrics[2].thdI = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_PHASE_C_THD_I) * 0.01f;
-
-      // aggregate
-      _data.aggregate.frequency = frequency;
-      _data.aggregate.activePower = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_ACTIVE_POWER) * (sign3 ? -1.0f : 1.0f);
-      _data.aggregate.reactivePower = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_REACTIVE_POWER) * (sign7 ? -1.0f : 1.0f);
-      _data.aggregate.apparentPower = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_APPARENT_POWER);
-      _data.aggregate.powerFactor = _register16(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_POWER_FACTOR) * 0.001f;
-      _data.aggregate.activeEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY) * 10;
-      _data.aggregate.reactiveEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY) * 10;
-      _data.aggregate.apparentEnergy = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_APPARENT_ENERGY) * 10;
-      _data.aggregate.activeEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY_IMPORTED) * 10;
-      _data.aggregate.activeEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_ACTIVE_ENERGY_RETURNED) * 10;
-      _data.aggregate.reactiveEnergyImported = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY_IMPORTED) * 10;
-      _data.aggregate.reactiveEnergyReturned = _register32(_buffer, registerStart, registerSize, JSY_333_REGISTER_TOTAL_REACTIVE_ENERGY_RETURNED) * 10;
-      _data.aggregate.current = _data._metrics[0].current + _data._metrics[1].current + _data._metrics[2].current;
-      _data.aggregate.voltage = _data.aggregate.current == 0 ? NAN : _data.aggregate.apparentPower / _data.aggregate.current;
+  switch (map->aggregate) {
+    case JSYAggregate::SINGLE:
+      if (map->computed)
+        computeMissingMetrics(data._metrics[0]);
+      data.aggregate = data._metrics[0];
+      break;
+
+    case JSYAggregate::CHANNELS:
+      if (map->computed) {
+        computeMissingMetrics(data._metrics[0]);
+        computeMissingMetrics(data._metrics[1]);
+      }
+      data.aggregate = data._metrics[0];
+      data.aggregate += data._metrics[1];
+      data.aggregate.voltage = std::max(data._metrics[0].voltage, data._metrics[1].voltage);
+      data.aggregate.frequency = std::max(data._metrics[0].frequency, data._metrics[1].frequency);
+      break;
 
+    case JSYAggregate::PHASES:
+      data.aggregate.current = data._metrics[0].current + data._metrics[1].current + data._metrics[2].current;
+      data.aggregate.voltage = data.aggregate.current == 0 ? NAN : data.aggregate.apparentPower / data.aggregate.current;
       break;
-    }
 
     default:
       break;
   }
+}
 
-  _time = millis();
+size_t Mycila::JSY::_readCounters(const uint16_t model, const uint8_t* registers, const uint32_t fields, RawCounter* counters) {
+  const JSYRegisterMap* map = findRegisterMap(model);
+  if (map == nullptr)
+    return 0;
 
-  if (_callback) {
-    _callback(EventType::EVT_READ, _data);
+  size_t count = 0;
+  for (const JSYField* field = map->fields; field != map->fields + map->fieldCount; field++) {
+    if (!field->counter || !(field->field & fields))
+      continue;
+    RawCounter& counter = counters[count++];
+    counter.channel = field->channel;
+    counter.index = __builtin_ctz(field->field / FIELD_ACTIVE_ENERGY);
+    counter.num = field->num;
+    counter.den = field->den;
+    counter.value = readRegister(registers + field->offset, field->width);
   }
+  return count;
+}
 
-  return true;
+///////////////////////////////////////////////////////////////////////////////
+// pipeline
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSY::setPipeline(const bool enabled, const uint8_t core, const uint32_t stackSize) {
+  if (_enabled)
+    return;
+  _pipeline = enabled;
+  _pipelineCore = core;
+  _pipelineStackSize = stackSize;
+}
+
+bool Mycila::JSY::_readToPipeline(const uint8_t address, const uint16_t model) {
+  const uint8_t* registers = nullptr;
+  const ReadResult result = _readRegisters(address, model, _fields, _readPlan, _turnaround, registers);
+  if (result == ReadResult::READ_ERROR_MODEL)
+    return false;
+
+  const uint32_t head = _pipelineHead.load(std::memory_order_relaxed);
+  const size_t depth = head - _pipelineTail.load(std::memory_order_acquire);
+
+  if (depth >= MYCILA_JSY_PIPELINE_DEPTH) {
+    // the decoding task is too slow: keep reading the bus
+    _pipelineDropped.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    Frame& frame = _pipelineFrames[head % MYCILA_JSY_PIPELINE_DEPTH];
+    frame.time = millis();
+    frame.timestamp = esp_timer_get_time();
+    frame.result = result;
+    frame.address = _buffer[JSY_RESPONSE_ADDRESS];
+    frame.model = model;
+    frame.fields = _readPlan.decoded;
+    if (result == ReadResult::READ_SUCCESS) {
+      const JSYRegisterMap* map = findRegisterMap(model);
+      memcpy(frame.registers, registers, map->registerCount * map->registerSize);
+    }
+    _pipelineHead.store(head + 1, std::memory_order_release);
+    if (depth + 1 > _pipelineMaxDepth.load(std::memory_order_relaxed))
+      _pipelineMaxDepth.store(depth + 1, std::memory_order_relaxed);
+    xTaskNotifyGive(_pipelineTaskHandle);
+  }
+
+  return result == ReadResult::READ_SUCCESS;
+}
+
+void Mycila::JSY::_pipelineTask(void* params) {
+  JSY* jsy = reinterpret_cast<JSY*>(params);
+  while (true) {
+    // once the async task is stopped, no more frames will come
+    const bool stopped = !jsy->_enabled && jsy->_taskHandle == NULL;
+    // process all the frames pushed so far
+    uint32_t tail = jsy->_pipelineTail.load(std::memory_order_relaxed);
+    while (tail != jsy->_pipelineHead.load(std::memory_order_acquire)) {
+      const Frame& frame = jsy->_pipelineFrames[tail % MYCILA_JSY_PIPELINE_DEPTH];
+      if (jsy->_pipelineClear.exchange(false))
+        jsy->_data.clear();
+      jsy->_process(frame.result, frame.address, frame.model, frame.fields, frame.registers, frame.time, frame.timestamp, jsy->_data, jsy->_publisher, jsy->_energy);
+      jsy->_pipelineTail.store(++tail, std::memory_order_release);
+    }
+    // then the events sent by the async task
+    const uint32_t events = jsy->_pendingEvents.exchange(0);
+    for (uint32_t e = 0; events >> e; e++)
+      if (events & (1UL << e))
+        jsy->_notify(static_cast<EventType>(e), jsy->_data);
+    if (stopped)
+      break;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+  }
+  jsy->_pipelineTaskHandle = NULL;
+  vTaskDelete(NULL);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -901,14 +1413,17 @@ uint16_t Mycila::JSY::readModel(const uint8_t address) {
   LOGD(TAG, "readModel(0x%02X)", address);
 
   std::lock_guard<std::mutex> lock(_mutex);
+  return _readModel(address);
+}
 
+uint16_t Mycila::JSY::_readModel(const uint8_t address) {
 #ifdef MYCILA_JSY_DEBUG
   Serial.printf("[JSY] readModel(0x%02X)\n", address);
 #endif
 
   memcpy(_buffer, JSY_REQUEST_READ_MODEL, JSY_REQUEST_READ_MODEL_LEN);
   _send(address, JSY_REQUEST_READ_MODEL_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ_MODEL, _baudRate);
+  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ_MODEL, _baudRate, MYCILA_JSY_READ_TIMEOUT_MS);
 
   if (result != ReadResult::READ_SUCCESS) {
     return MYCILA_JSY_MK_UNKNOWN;
@@ -925,6 +1440,24 @@ Mycila::JSY::Mode Mycila::JSY::_readMode(const uint8_t address, const uint16_t m
   if (!_enabled)
     return Mode::UNKNOWN;
 
+  // the other models have a fixed mode
+  if (model != MYCILA_JSY_MK_1031)
+    return _queryMode(address, model);
+
+  LOGD(TAG, "readMode(0x%02X)", address);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Mode mode = _queryMode(address, model);
+
+  if (mode != Mode::UNKNOWN && _lastAddress == _profile.address) {
+    _profile.mode = mode;
+    _saveProfile();
+  }
+
+  return mode;
+}
+
+Mycila::JSY::Mode Mycila::JSY::_queryMode(const uint8_t address, const uint16_t model) {
   switch (model) {
     case MYCILA_JSY_MK_163:
     case MYCILA_JSY_MK_193:
@@ -940,17 +1473,13 @@ Mycila::JSY::Mode Mycila::JSY::_readMode(const uint8_t address, const uint16_t m
       return Mode::UNKNOWN;
   }
 
-  LOGD(TAG, "readMode(0x%02X)", address);
-
-  std::lock_guard<std::mutex> lock(_mutex);
-
 #ifdef MYCILA_JSY_DEBUG
   Serial.printf("[JSY] readMode(0x%02X)\n", address);
 #endif
 
   memcpy(_buffer, JSY_REQUEST_READ_MODE, JSY_REQUEST_READ_MODE_LEN);
   _send(address, JSY_REQUEST_READ_MODE_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ_MODE, _baudRate);
+  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ_MODE, _baudRate, firstByteTimeout(model));
 
   if (result != ReadResult::READ_SUCCESS) {
     return Mode::UNKNOWN;
@@ -1001,9 +1530,17 @@ bool Mycila::JSY::_setMode(const uint8_t address, const uint16_t model, const Mo
   _buffer[JSY_REQUEST_SET_MODE] = mode == Mode::AC ? JSY_MODE_AC : JSY_MODE_DC;
 
   _send(address, JSY_REQUEST_SWITCH_MODE_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_SWITCH_MODE, _baudRate);
+  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_SWITCH_MODE, _baudRate, MYCILA_JSY_READ_TIMEOUT_MS);
 
-  return result == ReadResult::READ_SUCCESS;
+  if (result != ReadResult::READ_SUCCESS)
+    return false;
+
+  if (_lastAddress == _profile.address) {
+    _profile.mode = mode;
+    _saveProfile();
+  }
+
+  return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1016,6 +1553,10 @@ bool Mycila::JSY::resetEnergy(const uint8_t address) {
 
   LOGD(TAG, "resetEnergy(0x%02X)", address);
 
+  // the persisted totals continue from the last values before the reset
+  if (_energy)
+    _energy->flush();
+
   std::lock_guard<std::mutex> lock(_mutex);
 
 #ifdef MYCILA_JSY_DEBUG
@@ -1024,7 +1565,7 @@ bool Mycila::JSY::resetEnergy(const uint8_t address) {
 
   memcpy(_buffer, JSY_REQUEST_RESET_ENERGY, JSY_REQUEST_RESET_ENERGY_LEN);
   _send(address, JSY_REQUEST_RESET_ENERGY_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_RESET_ENERGY, _baudRate);
+  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_RESET_ENERGY, _baudRate, MYCILA_JSY_READ_TIMEOUT_MS);
 
   return result == ReadResult::READ_SUCCESS;
 }
@@ -1089,21 +1630,76 @@ bool Mycila::JSY::isBaudRateSupported(uint16_t model, Mycila::JSY::BaudRate baud
   return getMinAvailableBaudRate(model) <= baudRate && baudRate <= getMaxAvailableBaudRate(model);
 }
 
-bool Mycila::JSY::setBaudRate(const uint8_t address, const BaudRate baudRate) {
-  return _set(address, address ? address : (_lastAddress ? _lastAddress : MYCILA_JSY_ADDRESS_DEFAULT), baudRate);
-}
+float Mycila::JSY::getResolution(uint16_t model, uint32_t field) {
+  if (field == FIELD_NONE || (field & (field - 1)) || !(field & FIELD_ALL))
+    return 0;
 
-bool Mycila::JSY::setDeviceAddress(const uint8_t address, const uint8_t newAddress) {
-  return _set(address, newAddress, _baudRate);
+  const JSYRegisterMap* map = findRegisterMap(model);
+  if (map) {
+    for (const JSYField* f = map->fields; f != map->fields + map->fieldCount; f++)
+      if (f->field == field)
+        return f->real ? f->scale : 1;
+  }
+
+  // computed values: finest resolution of all the models
+  switch (field) {
+    case FIELD_FREQUENCY:
+    case FIELD_PHASE_ANGLE_U:
+    case FIELD_PHASE_ANGLE_I:
+    case FIELD_PHASE_ANGLE_UI:
+    case FIELD_THD_U:
+    case FIELD_THD_I:
+      return 0.01f;
+    case FIELD_POWER_FACTOR:
+      return 0.001f;
+    case FIELD_VOLTAGE:
+    case FIELD_CURRENT:
+    case FIELD_ACTIVE_POWER:
+    case FIELD_REACTIVE_POWER:
+    case FIELD_APPARENT_POWER:
+      return 0.0001f;
+    default:
+      return 1; // energies
+  }
 }
 
-bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const BaudRate newBaudRate) {
-  if (!_enabled)
+bool Mycila::JSY::decode(const uint16_t model, const uint8_t* frame, const size_t len, Data& data) {
+  const JSYRegisterMap* map = findRegisterMap(model);
+  if (map == nullptr || len != static_cast<size_t>(JSY_RESPONSE_SIZE_READ + map->registerCount * map->registerSize))
     return false;
-
-  if (newBaudRate == BaudRate::UNKNOWN)
+  const uint16_t crc = _crc16(frame, len - 2);
+  if (frame[len - 2] != LOBYTE(crc) || frame[len - 1] != HIBYTE(crc))
     return false;
-
+  data.address = frame[JSY_RESPONSE_ADDRESS];
+  data.model = model;
+  _decode(model, frame + JSY_RESPONSE_DATA, data);
+  return true;
+}
+
+uint16_t Mycila::JSY::crc16(const uint8_t* buffer, const size_t len) {
+  return _crc16(buffer, len);
+}
+
+bool Mycila::JSY::setBaudRate(const uint8_t address, const BaudRate baudRate) {
+  if (!_set(address, address ? address : (_lastAddress ? _lastAddress : MYCILA_JSY_ADDRESS_DEFAULT), baudRate))
+    return false;
+  // the auto-tuning now aims at this baud rate
+  if (_tuning && (address == _destinationAddress || address == MYCILA_JSY_ADDRESS_BROADCAST))
+    setBaudRateTuning(true);
+  return true;
+}
+
+bool Mycila::JSY::setDeviceAddress(const uint8_t address, const uint8_t newAddress) {
+  return _set(address, newAddress, _baudRate);
+}
+
+bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const BaudRate newBaudRate) {
+  if (!_enabled)
+    return false;
+
+  if (newBaudRate == BaudRate::UNKNOWN)
+    return false;
+
   if (newAddress == MYCILA_JSY_ADDRESS_UNKNOWN)
     return false;
 
@@ -1146,7 +1742,7 @@ bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const Ba
   }
 
   _send(address, JSY_REQUEST_SET_COM_LEN);
-  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_SET_COM, _baudRate);
+  ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_SET_COM, _baudRate, MYCILA_JSY_READ_TIMEOUT_MS);
 
   // unexpected error ?
   if (result != ReadResult::READ_SUCCESS && result != ReadResult::READ_ERROR_ADDRESS) {
@@ -1162,7 +1758,7 @@ bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const Ba
 
   bool success = false;
   for (int i = 0; i < MYCILA_JSY_RETRY_COUNT; i++) {
-    if (_canRead(address, newBaudRate)) {
+    if (_canRead(address, newBaudRate, MYCILA_JSY_READ_TIMEOUT_MS)) {
       success = true;
       break;
     }
@@ -1177,6 +1773,13 @@ bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const Ba
       _destinationAddress = newAddress;
     }
 
+    // the device answered at its new address
+    if (_lastAddress == newAddress && (address == _profile.address || address == MYCILA_JSY_ADDRESS_BROADCAST)) {
+      _profile.address = newAddress;
+      _profile.baudRate = newBaudRate;
+      _saveProfile();
+    }
+
   } else {
     LOGE(TAG, "Unable to read JSY @ 0x%02X at speed: %" PRIu32, address, newBaudRate);
     if (_baudRate != BaudRate::UNKNOWN) {
@@ -1193,36 +1796,133 @@ bool Mycila::JSY::_set(const uint8_t address, const uint8_t newAddress, const Ba
 
 #ifdef MYCILA_JSON_SUPPORT
 void Mycila::JSY::toJson(const JsonObject& root) const {
+  Snapshot snapshot;
+  getSnapshot(snapshot);
   root["enabled"] = _enabled;
-  root["time"] = _time;
+  root["time"] = snapshot.time;
   root["speed"] = _baudRate;
-  _data.toJson(root);
+  snapshot.data.toJson(root);
+  if (_stats)
+    _stats->toJson(root["stats"].to<JsonObject>());
+  if (_energy)
+    _energy->toJson(root["energy"].to<JsonObject>());
+}
+#endif
+
+void Mycila::JSY::toJson(JSYJsonWriter& writer) const {
+  Snapshot snapshot;
+  getSnapshot(snapshot);
+  writer.key(MYCILA_JSY_JSON_KEY("enabled"));
+  writer.value(_enabled);
+  writer.key(MYCILA_JSY_JSON_KEY("time"));
+  writer.value(snapshot.time);
+  writer.key(MYCILA_JSY_JSON_KEY("speed"));
+  writer.value(static_cast<uint32_t>(_baudRate));
+  snapshot.data.toJson(writer);
+  if (_stats) {
+    writer.key(MYCILA_JSY_JSON_KEY("stats"));
+    writer.beginObject();
+    _stats->toJson(writer);
+    writer.endObject();
+  }
+  if (_energy) {
+    writer.key(MYCILA_JSY_JSON_KEY("energy"));
+    writer.beginObject();
+    _energy->toJson(writer);
+    writer.endObject();
+  }
+}
+
+size_t Mycila::JSY::toJson(char* buffer, size_t size) const {
+  JSYJsonWriter writer(buffer, size);
+  writer.beginObject();
+  toJson(writer);
+  writer.endObject();
+  return writer.end();
+}
+
+size_t Mycila::JSY::toJson(Print& out) const {
+  JSYJsonWriter writer(out);
+  writer.beginObject();
+  toJson(writer);
+  writer.endObject();
+  return writer.end();
+}
+
+static constexpr const char* JSY_INSTRUMENTATION_PHASES[] = {"send", "wait", "receive", "check", "decode", "callback"};
+
+#ifdef MYCILA_JSON_SUPPORT
+void Mycila::JSY::Instrumentation::toJson(const JsonObject& root) const {
+  root["success"] = success;
+  root["timeouts"] = timeouts;
+  root["error_count"] = errorCount;
+  root["error_crc"] = errorCrc;
+  root["error_address"] = errorAddress;
+  root["error_model"] = errorModel;
+  root["bytes_sent"] = bytesSent;
+  root["bytes_received"] = bytesReceived;
+  const Phase* phases[] = {&send, &wait, &receive, &check, &decode, &callback};
+  for (size_t i = 0; i < 6; i++) {
+    JsonObject phase = root[JSY_INSTRUMENTATION_PHASES[i]].to<JsonObject>();
+    phase["count"] = phases[i]->count;
+    phase["total"] = phases[i]->total;
+    phase["last"] = phases[i]->last;
+    phase["max"] = phases[i]->max;
+  }
 }
 #endif
 
+void Mycila::JSY::Instrumentation::toJson(JSYJsonWriter& writer) const {
+  writer.key(MYCILA_JSY_JSON_KEY("success"));
+  writer.value(success);
+  writer.key(MYCILA_JSY_JSON_KEY("timeouts"));
+  writer.value(timeouts);
+  writer.key(MYCILA_JSY_JSON_KEY("error_count"));
+  writer.value(errorCount);
+  writer.key(MYCILA_JSY_JSON_KEY("error_crc"));
+  writer.value(errorCrc);
+  writer.key(MYCILA_JSY_JSON_KEY("error_address"));
+  writer.value(errorAddress);
+  writer.key(MYCILA_JSY_JSON_KEY("error_model"));
+  writer.value(errorModel);
+  writer.key(MYCILA_JSY_JSON_KEY("bytes_sent"));
+  writer.value(bytesSent);
+  writer.key(MYCILA_JSY_JSON_KEY("bytes_received"));
+  writer.value(bytesReceived);
+  const Phase* phases[] = {&send, &wait, &receive, &check, &decode, &callback};
+  for (size_t i = 0; i < 6; i++) {
+    writer.key(JSY_INSTRUMENTATION_PHASES[i]);
+    writer.beginObject();
+    writer.key(MYCILA_JSY_JSON_KEY("count"));
+    writer.value(phases[i]->count);
+    writer.key(MYCILA_JSY_JSON_KEY("total"));
+    writer.value(phases[i]->total);
+    writer.key(MYCILA_JSY_JSON_KEY("last"));
+    writer.value(phases[i]->last);
+    writer.key(MYCILA_JSY_JSON_KEY("max"));
+    writer.value(phases[i]->max);
+    writer.endObject();
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // I/O
 ///////////////////////////////////////////////////////////////////////////////
 
-bool Mycila::JSY::_canRead(const uint8_t address, BaudRate baudRate) {
+bool Mycila::JSY::_canRead(const uint8_t address, BaudRate baudRate, const uint32_t timeout) {
 #ifdef MYCILA_JSY_DEBUG
   Serial.printf("[JSY] _canRead(0x%02X)\n", address);
 #endif
   memcpy(_buffer, JSY_REQUEST_READ_MODEL, JSY_REQUEST_READ_MODEL_LEN);
   _send(address, JSY_REQUEST_READ_MODEL_LEN);
-  return _timedRead(address, JSY_RESPONSE_SIZE_READ_MODEL, baudRate) == ReadResult::READ_SUCCESS;
+  return _timedRead(address, JSY_RESPONSE_SIZE_READ_MODEL, baudRate, timeout) == ReadResult::READ_SUCCESS;
 }
 
-Mycila::JSY::ReadResult Mycila::JSY::_timedRead(const uint8_t expectedAddress, const size_t expectedLen, const BaudRate baudRate) {
-  size_t count = 0;
-  while (count < expectedLen) {
-    size_t read = _serial->readBytes(_buffer + count, expectedLen - count);
-    if (read) {
-      count += read;
-    } else {
-      break;
-    }
-  }
+Mycila::JSY::ReadResult Mycila::JSY::_timedRead(const uint8_t expectedAddress, const size_t expectedLen, const BaudRate baudRate, const uint32_t timeout) {
+  // Modbus RTU: end of frame after a silence of 3.5 characters (1.75 ms above 19200 bauds)
+  const uint32_t silenceUs = baudRate > BaudRate::BAUD_19200 ? 1750 : 35000000 / baudRate;
+  _parser.begin(expectedAddress, _buffer[JSY_REQUEST_CMD], expectedLen);
+  const size_t count = _receive(timeout, silenceUs);
 
 #ifdef MYCILA_JSY_DEBUG
   Serial.printf("[JSY] timedRead(0x%02X) %d < ", expectedAddress, count);
@@ -1234,34 +1934,141 @@ Mycila::JSY::ReadResult Mycila::JSY::_timedRead(const uint8_t expectedAddress, c
 
   _drop();
 
+  // Modbus RTU: the next request must be separated from this frame by 3.5 characters
+  _idleFrom = micros();
+  _idleUs = silenceUs;
+
+  // an abandoned frame is still on the wire: the next request waits for its expected end
+  if (_parser.rejected)
+    _idleUs += static_cast<uint32_t>((_parser.expectedLen - count) * 10000000ULL / baudRate);
+
+  const uint32_t start = micros();
+  const ReadResult result = _check(expectedAddress, count);
+  _instrumentation.check.add(micros() - start);
+
+  switch (result) {
+    case ReadResult::READ_SUCCESS:
+      _instrumentation.success++;
+      break;
+    case ReadResult::READ_TIMEOUT:
+      _instrumentation.timeouts++;
+      break;
+    case ReadResult::READ_ERROR_COUNT:
+      _instrumentation.errorCount++;
+      break;
+    case ReadResult::READ_ERROR_CRC:
+      _instrumentation.errorCrc++;
+      break;
+    case ReadResult::READ_ERROR_ADDRESS:
+      _instrumentation.errorAddress++;
+      break;
+    default:
+      break;
+  }
+
+  return result;
+}
+
+Mycila::JSY::ReadResult Mycila::JSY::_check(const uint8_t expectedAddress, const size_t count) {
   // timeout ?
   if (count == 0) {
     LOGD(TAG, "timedRead(0x%02X) timeout", expectedAddress);
     return ReadResult::READ_TIMEOUT;
   }
 
-  // check length
-  if (count != expectedLen) {
-    LOGD(TAG, "timedRead(0x%02X) error: len %d != %d", expectedAddress, count, expectedLen);
-    return ReadResult::READ_ERROR_COUNT;
+  switch (_parser.result) {
+    case ReadResult::READ_ERROR_ADDRESS:
+      // the frame is abandoned: the address is the only information about the device which answered
+      _lastAddress = _buffer[JSY_RESPONSE_ADDRESS];
+      LOGD(TAG, "timedRead(0x%02X) error: wrong device address 0x%02X", expectedAddress, _lastAddress);
+      return ReadResult::READ_ERROR_ADDRESS;
+
+    case ReadResult::READ_ERROR_COUNT:
+      if (_parser.exception)
+        LOGD(TAG, "timedRead(0x%02X) error: exception 0x%02X", expectedAddress, _buffer[JSY_RESPONSE_DATA_LEN]);
+      else
+        LOGD(TAG, "timedRead(0x%02X) error: invalid header 0x%02X 0x%02X", expectedAddress, _buffer[JSY_RESPONSE_CMD], count > JSY_RESPONSE_DATA_LEN ? _buffer[JSY_RESPONSE_DATA_LEN] : 0);
+      return ReadResult::READ_ERROR_COUNT;
+
+    case ReadResult::READ_ERROR_CRC:
+      LOGD(TAG, "timedRead(0x%02X) error: bad CRC", expectedAddress);
+      return ReadResult::READ_ERROR_CRC;
+
+    default:
+      break;
   }
 
-  // CRC check
-  uint16_t crc = _crc16(_buffer, expectedLen - 2);
-  if (_buffer[expectedLen - 2] != LOBYTE(crc) || _buffer[expectedLen - 1] != HIBYTE(crc)) {
-    LOGD(TAG, "timedRead(0x%02X) error: bad CRC 0x%02X 0x%02X != 0x%02X 0x%02X", expectedAddress, _buffer[expectedLen - 2], _buffer[expectedLen - 1], LOBYTE(crc), HIBYTE(crc));
-    return ReadResult::READ_ERROR_CRC;
+  // check length
+  if (count != _parser.expectedLen) {
+    LOGD(TAG, "timedRead(0x%02X) error: len %u != %u", expectedAddress, static_cast<unsigned>(count), static_cast<unsigned>(_parser.expectedLen));
+    return ReadResult::READ_ERROR_COUNT;
   }
 
   _lastAddress = _buffer[JSY_RESPONSE_ADDRESS];
+  return ReadResult::READ_SUCCESS;
+}
 
-  // address check
-  if (expectedAddress != MYCILA_JSY_ADDRESS_BROADCAST && expectedAddress != _lastAddress) {
-    LOGD(TAG, "timedRead(0x%02X) error: wrong device address 0x%02X", expectedAddress, _lastAddress);
-    return ReadResult::READ_ERROR_ADDRESS;
+void Mycila::JSY::Parser::begin(const uint8_t expectedAddress, const uint8_t requestFunction, const size_t len) {
+  address = expectedAddress;
+  function = requestFunction;
+  expectedLen = len;
+  count = 0;
+  crc = 0xFFFF;
+  result = ReadResult::READ_SUCCESS;
+  rejected = false;
+  exception = false;
+}
+
+bool Mycila::JSY::Parser::feed(const uint8_t* data, size_t len) {
+  len = std::min(len, remaining());
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t b = data[i];
+    crc = (crc >> 8) ^ pgm_read_word_near(CRCTable + static_cast<uint8_t>(b ^ LOBYTE(crc)));
+
+    switch (count++) {
+      case JSY_RESPONSE_ADDRESS:
+        if (address != MYCILA_JSY_ADDRESS_BROADCAST && b != address) {
+          result = ReadResult::READ_ERROR_ADDRESS;
+          rejected = true;
+          return false;
+        }
+        break;
+
+      case JSY_RESPONSE_CMD:
+        if (b == (function | 0x80)) {
+          // Modbus exception: address, function, exception code, CRC
+          exception = true;
+          expectedLen = 5;
+        } else if (b != function) {
+          result = ReadResult::READ_ERROR_COUNT;
+          rejected = true;
+          return false;
+        }
+        break;
+
+      case JSY_RESPONSE_DATA_LEN:
+        // a read response announces the number of data bytes, which must fill the expected frame
+        if (function == JSY_CMD_READ_REGISTERS && !exception && b != expectedLen - JSY_RESPONSE_SIZE_READ) {
+          result = ReadResult::READ_ERROR_COUNT;
+          rejected = true;
+          return false;
+        }
+        break;
+
+      default:
+        break;
+    }
   }
 
-  return ReadResult::READ_SUCCESS;
+  if (count < expectedLen)
+    return true;
+
+  // the CRC of a frame followed by its CRC is 0
+  if (crc != 0)
+    result = ReadResult::READ_ERROR_CRC;
+  else if (exception)
+    result = ReadResult::READ_ERROR_COUNT;
+  return false;
 }
 
 void Mycila::JSY::_send(const uint8_t address, const size_t len) {
@@ -1281,10 +2088,68 @@ void Mycila::JSY::_send(const uint8_t address, const size_t len) {
   Serial.println();
 #endif
 
+  // wait for the line to be idle
+  _sendFrom = micros();
+  const uint32_t idle = _sendFrom - _idleFrom;
+  if (idle < _idleUs) {
+    const uint32_t wait = _idleUs - idle;
+    if (wait >= 1000)
+      delay(wait / 1000);
+    delayMicroseconds(wait % 1000);
+  }
+
+  _write(len);
+  _instrumentation.bytesSent += len;
+}
+
+#ifndef MYCILA_JSY_UART_IDF
+
+///////////////////////////////////////////////////////////////////////////////
+// I/O: Arduino HardwareSerial
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSY::_write(const size_t len) {
   _serial->flush(false);
   _serial->write(_buffer, len);
 }
 
+size_t Mycila::JSY::_receive(const uint32_t timeout, const uint32_t silenceUs) {
+  // the deadline starts once the request is on the wire
+  _serial->flush();
+
+  // wait for the first byte
+  const uint32_t sent = micros();
+  _instrumentation.send.add(sent - _sendFrom);
+  _serial->setTimeout(timeout);
+  size_t count = _serial->readBytes(_buffer, 1);
+  const uint32_t first = micros();
+  _instrumentation.wait.add(first - sent);
+  _lastTurnaround = count ? std::max(first - sent, static_cast<uint32_t>(1)) : 0;
+
+  // then read until the frame is complete, rejected or the line is silent.
+  // The header is read first so that a wrong response is abandoned early, then the data by chunks checked while the next ones arrive.
+  // The UART driver is fed byte per byte below 57600 bauds, so the silence is seen within 1 ms, rounded up to the next tick.
+  if (count && _parser.feed(_buffer, count)) {
+    _serial->setTimeout((silenceUs + 999) / 1000 + 1);
+    while (true) {
+      const size_t chunk = count < JSY_RESPONSE_DATA ? JSY_RESPONSE_DATA - count : JSY_RECEIVE_CHUNK_SIZE;
+      const size_t len = std::min(chunk, _parser.remaining());
+      const size_t read = _serial->readBytes(_buffer + count, len);
+      if (!read)
+        break;
+      const bool more = _parser.feed(_buffer + count, read);
+      count += read;
+      if (!more)
+        break;
+    }
+  }
+  if (count)
+    _instrumentation.receive.add(micros() - first);
+
+  _instrumentation.bytesReceived += count;
+  return count;
+}
+
 size_t Mycila::JSY::_drop() {
   size_t count = 0;
   if (_serial->available()) {
@@ -1309,7 +2174,6 @@ size_t Mycila::JSY::_drop() {
 void Mycila::JSY::_openSerial(BaudRate baudRate) {
   LOGD(TAG, "openSerial(%" PRIu32 ")", baudRate);
   _serial->begin(baudRate, SERIAL_8N1, _pinRX, _pinTX);
-  _serial->setTimeout(MYCILA_JSY_READ_TIMEOUT_MS);
   while (!_serial)
     yield();
   while (!_serial->availableForWrite())
@@ -1318,20 +2182,604 @@ void Mycila::JSY::_openSerial(BaudRate baudRate) {
   _serial->flush(false);
 }
 
-Mycila::JSY::BaudRate Mycila::JSY::_detectBauds(const uint8_t address) {
-  for (int i = 0; i < AUTO_DETECT_BAUD_RATES_COUNT * 2; i++) {
-    BaudRate baudRate = AUTO_DETECT_BAUD_RATES[i % AUTO_DETECT_BAUD_RATES_COUNT];
-    LOGD(TAG, "find(0x%02X) %" PRIu32 " bauds", address, baudRate);
+void Mycila::JSY::_closeSerial() {
+  _serial->end();
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////
+// I/O: ESP-IDF UART driver
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSY::_write(const size_t len) {
+  // discard what was received since the last exchange, and the events about it
+  uart_flush_input(_uart);
+  xQueueReset(_uartEvents);
+  uart_write_bytes(_uart, _buffer, len);
+}
+
+size_t Mycila::JSY::_receive(const uint32_t timeout, const uint32_t silenceUs) {
+  // the deadline starts once the request is on the wire (the driver releases the TX done semaphore from its interrupt)
+  uart_wait_tx_done(_uart, portMAX_DELAY);
+
+  const uint32_t sent = micros();
+  _instrumentation.send.add(sent - _sendFrom);
+  _uartCount = 0;
+  _uartState = UartState::WAITING;
+  _lastTurnaround = 0;
+
+  // sleep on the event queue until the next event or the deadline of the current state:
+  // the first byte deadline while waiting, then the end of frame silence while receiving
+  uint32_t from = sent;
+  uint32_t waitUs = timeout * 1000;
+  while (_uartState == UartState::WAITING || _uartState == UartState::RECEIVING) {
+    const uint32_t elapsed = micros() - from;
+    const TickType_t ticks = elapsed >= waitUs ? 0 : pdMS_TO_TICKS((waitUs - elapsed + 999) / 1000) + 1;
+    uart_event_t event;
+    if (xQueueReceive(_uartEvents, &event, ticks) != pdTRUE) {
+      _uartState = _uartState == UartState::WAITING ? UartState::TIMEOUT : UartState::COMPLETE;
+      break;
+    }
+    const UartState previous = _uartState;
+    _uartState = _onUartEvent(event);
+    if (_uartState == UartState::RECEIVING && previous == UartState::WAITING)
+      _lastTurnaround = std::max(micros() - sent, static_cast<uint32_t>(1));
+    if (_uartState == UartState::RECEIVING) {
+      from = micros();
+      waitUs = silenceUs;
+    }
+  }
+
+  const uint32_t end = micros();
+  if (_uartState == UartState::COMPLETE && !_lastTurnaround)
+    _lastTurnaround = std::max(end - sent, static_cast<uint32_t>(1));
+
+  if (_lastTurnaround) {
+    _instrumentation.wait.add(_lastTurnaround);
+    _instrumentation.receive.add(end - sent - std::min(_lastTurnaround, end - sent));
+  } else {
+    _instrumentation.wait.add(end - sent);
+  }
+
+  if (_uartState == UartState::OVERFLOW) {
+    LOGW(TAG, "UART %d overflow", _uart);
+    _uartCount = 0;
+  }
+
+  _uartState = UartState::IDLE;
+  _instrumentation.bytesReceived += _uartCount;
+  return _uartCount;
+}
+
+Mycila::JSY::UartState Mycila::JSY::_onUartEvent(const uart_event_t& event) {
+  switch (event.type) {
+    case UART_DATA: {
+      // read everything buffered: some events might have been dropped if the queue was full
+      size_t available = 0;
+      uart_get_buffered_data_len(_uart, &available);
+      const size_t len = std::min(available, _parser.remaining());
+      if (len) {
+        const int read = uart_read_bytes(_uart, _buffer + _uartCount, len, 0);
+        if (read > 0) {
+          const bool more = _parser.feed(_buffer + _uartCount, read);
+          _uartCount += read;
+          // complete, or rejected as soon as the header is wrong
+          if (!more)
+            return UartState::COMPLETE;
+        }
+      }
+      return _uartCount ? UartState::RECEIVING : _uartState;
+    }
+    case UART_FIFO_OVF:
+    case UART_BUFFER_FULL:
+      return UartState::OVERFLOW;
+    default:
+      return _uartState;
+  }
+}
+
+size_t Mycila::JSY::_drop() {
+  size_t count = 0;
+  uart_get_buffered_data_len(_uart, &count);
+  if (count) {
+#ifdef MYCILA_JSY_DEBUG
+    Serial.printf("[JSY] drop %u bytes\n", static_cast<unsigned>(count));
+#endif
+    uart_flush_input(_uart);
+  }
+  return count;
+}
+
+void Mycila::JSY::_openSerial(BaudRate baudRate) {
+  LOGD(TAG, "openSerial(%" PRIu32 ")", baudRate);
+  _closeSerial();
+
+  // the HardwareSerial given to begin() tells which UART to use
+  _uart = UART_NUM_0;
+  if (_serial == &Serial1)
+    _uart = UART_NUM_1;
+#if SOC_UART_HP_NUM > 2
+  if (_serial == &Serial2)
+    _uart = UART_NUM_2;
+#endif
+
+  uart_config_t config = {};
+  config.baud_rate = static_cast<int>(baudRate);
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_DEFAULT;
+
+  // RX buffer must be bigger than the hardware FIFO. No TX buffer: requests fit in the hardware FIFO.
+  ESP_ERROR_CHECK(uart_driver_install(_uart, 2 * UART_HW_FIFO_LEN(_uart), 0, MYCILA_JSY_UART_EVENT_QUEUE_SIZE, &_uartEvents, 0));
+  ESP_ERROR_CHECK(uart_param_config(_uart, &config));
+  ESP_ERROR_CHECK(uart_set_pin(_uart, _pinTX, _pinRX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+  // data event after 1 character of silence (end of frame) or when the FIFO holds enough bytes
+  ESP_ERROR_CHECK(uart_set_rx_timeout(_uart, 1));
+  ESP_ERROR_CHECK(uart_set_rx_full_threshold(_uart, MYCILA_JSY_UART_RX_FULL_THRESHOLD));
+}
+
+void Mycila::JSY::_closeSerial() {
+  if (_uart != UART_NUM_MAX && uart_is_driver_installed(_uart))
+    uart_driver_delete(_uart);
+  _uart = UART_NUM_MAX;
+  _uartEvents = nullptr;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// discovery
+///////////////////////////////////////////////////////////////////////////////
+
+// longest first byte timeout of the models supporting a baud rate (each baud rate of the detection is supported by one model at least)
+static uint32_t discoveryProbeTimeout(Mycila::JSY::BaudRate baudRate) {
+  uint32_t timeout = 0;
+  for (const JSYRegisterMap& map : JSY_REGISTER_MAPS)
+    if (Mycila::JSY::isBaudRateSupported(map.model, baudRate))
+      timeout = std::max(timeout, firstByteTimeout(map.model));
+  return timeout;
+}
+
+size_t Mycila::JSY::discover(HardwareSerial& serial,
+                             const int8_t rxPin,
+                             const int8_t txPin,
+                             Discovery* devices,
+                             const size_t maxDevices,
+                             DiscoveryCallback callback,
+                             const uint8_t firstAddress,
+                             const uint8_t lastAddress) {
+  if (_enabled || firstAddress == MYCILA_JSY_ADDRESS_BROADCAST || lastAddress < firstAddress)
+    return 0;
+
+  if (!GPIO_IS_VALID_GPIO(rxPin) || !GPIO_IS_VALID_OUTPUT_GPIO(txPin)) {
+    LOGE(TAG, "Invalid Serial RX / TX pins: %" PRId8 " / %" PRId8, rxPin, txPin);
+    return 0;
+  }
+
+  _pinRX = (gpio_num_t)rxPin;
+  _pinTX = (gpio_num_t)txPin;
+  _serial = &serial;
+
+  const size_t addresses = lastAddress - firstAddress + 1;
+  const size_t total = AUTO_DETECT_BAUD_RATES_COUNT * addresses;
+  const uint32_t start = millis();
+  size_t done = 0;
+  size_t found = 0;
+  bool cancelled = false;
+  // the timeouts of the empty addresses are not the ones of the device read afterwards
+  const Instrumentation instrumentation = _instrumentation;
+
+  LOGI(TAG, "Discover JSY @ 0x%02X-0x%02X", firstAddress, lastAddress);
+
+  for (size_t i = 0; i < AUTO_DETECT_BAUD_RATES_COUNT && !cancelled; i++) {
+    const BaudRate baudRate = AUTO_DETECT_BAUD_RATES[i];
+    const uint32_t probeTimeout = discoveryProbeTimeout(baudRate);
+
+    // is anything answering at this baud rate ? Several devices answering together still send bytes.
+    ReadResult probe = ReadResult::READ_TIMEOUT;
+    uint32_t turnaround = 0;
     _openSerial(baudRate);
-    for (int j = 0; j < MYCILA_JSY_RETRY_COUNT; j++) {
-      if (_canRead(address, baudRate)) {
-        return baudRate;
+    _baudRate = baudRate;
+    for (int j = 0; j < MYCILA_JSY_RETRY_COUNT && !turnaround; j++) {
+      memcpy(_buffer, JSY_REQUEST_READ_MODEL, JSY_REQUEST_READ_MODEL_LEN);
+      _send(MYCILA_JSY_ADDRESS_BROADCAST, JSY_REQUEST_READ_MODEL_LEN);
+      probe = _timedRead(MYCILA_JSY_ADDRESS_BROADCAST, JSY_RESPONSE_SIZE_READ_MODEL, baudRate, probeTimeout);
+      turnaround = _lastTurnaround;
+    }
+
+    if (!turnaround) {
+      LOGD(TAG, "discover() %" PRIu32 " bauds: no answer", baudRate);
+      done += addresses;
+      if (callback && !callback(nullptr, done, total))
+        cancelled = true;
+      continue;
+    }
+
+    // A clean answer to the broadcast, followed by nothing else, comes from the only device at this baud rate (i.e. on a TTL link):
+    // several devices answering at the same time mix up their bytes.
+    if (probe == ReadResult::READ_SUCCESS && _lastAddress >= firstAddress && _lastAddress <= lastAddress) {
+      Discovery device;
+      device.address = _lastAddress;
+      device.model = (_buffer[JSY_RESPONSE_DATA] << 8) + _buffer[JSY_RESPONSE_DATA + 1];
+      device.baudRate = baudRate;
+      delay(probeTimeout);
+      if (!_drop()) {
+        device.mode = _queryMode(device.address, device.model);
+        LOGI(TAG, "Discovered JSY-MK-%X @ 0x%02X with speed %" PRIu32 " bauds", device.model, device.address, device.baudRate);
+        if (found < maxDevices)
+          devices[found] = device;
+        found++;
+        done += addresses;
+        if (callback && !callback(&device, done, total))
+          cancelled = true;
+        continue;
       }
     }
+
+    // the devices on this bus answer in about the same time as the first one which answered the broadcast: 50% above, rounded up to the next tick
+    const uint32_t timeout = std::clamp(static_cast<uint32_t>((turnaround + turnaround / 2 + 999) / 1000 + 1), static_cast<uint32_t>(MYCILA_JSY_TURNAROUND_MIN_TIMEOUT_MS), probeTimeout);
+    LOGD(TAG, "discover() %" PRIu32 " bauds: answered in %" PRIu32 " us, timeout: %" PRIu32 " ms", baudRate, turnaround, timeout);
+
+    for (uint16_t address = firstAddress; address <= lastAddress && !cancelled; address++) {
+      Discovery device;
+      for (int j = 0; j < MYCILA_JSY_RETRY_COUNT; j++) {
+        memcpy(_buffer, JSY_REQUEST_READ_MODEL, JSY_REQUEST_READ_MODEL_LEN);
+        _send(address, JSY_REQUEST_READ_MODEL_LEN);
+        const ReadResult result = _timedRead(address, JSY_RESPONSE_SIZE_READ_MODEL, baudRate, timeout);
+        if (result == ReadResult::READ_SUCCESS) {
+          device.address = address;
+          device.model = (_buffer[JSY_RESPONSE_DATA] << 8) + _buffer[JSY_RESPONSE_DATA + 1];
+          device.baudRate = baudRate;
+          device.mode = _queryMode(address, device.model);
+          break;
+        }
+        // nobody at this address: a garbled answer is retried
+        if (result == ReadResult::READ_TIMEOUT)
+          break;
+      }
+
+      if (device.address != MYCILA_JSY_ADDRESS_UNKNOWN) {
+        LOGI(TAG, "Discovered JSY-MK-%X @ 0x%02X with speed %" PRIu32 " bauds", device.model, device.address, device.baudRate);
+        if (found < maxDevices)
+          devices[found] = device;
+        found++;
+      }
+
+      done++;
+      if (callback && !callback(device.address != MYCILA_JSY_ADDRESS_UNKNOWN ? &device : nullptr, done, total))
+        cancelled = true;
+    }
+  }
+
+  _baudRate = BaudRate::UNKNOWN;
+  _closeSerial();
+  _instrumentation = instrumentation;
+
+  if (cancelled)
+    LOGW(TAG, "Discovery cancelled: %" PRIu32 " JSY found in %" PRIu32 " ms", static_cast<uint32_t>(found), millis() - start);
+  else
+    LOGI(TAG, "Discovery done: %" PRIu32 " JSY found in %" PRIu32 " ms", static_cast<uint32_t>(found), millis() - start);
+
+  return found;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// profile
+///////////////////////////////////////////////////////////////////////////////
+
+#define JSY_PROFILE_VERSION 2
+// version(1), address(1), model(2), baud rate(4), mode(1), flags(1), crc(2)
+#define JSY_PROFILE_SIZE 12
+
+#define JSY_PROFILE_FLAG_NEGOTIATED 0x01
+
+bool Mycila::JSY::clearProfile() {
+  if (!_profileStorage)
+    return false;
+  _persisted = Profile();
+  return _profileStorage->remove(_profileKey);
+}
+
+bool Mycila::JSY::_loadProfile(const uint8_t address, const uint16_t model) {
+  if (!_profileStorage)
+    return false;
+
+  uint8_t record[JSY_PROFILE_SIZE];
+  if (_profileStorage->read(_profileKey, record, sizeof(record)) != sizeof(record))
+    return false;
+
+  const uint16_t crc = _crc16(record, JSY_PROFILE_SIZE - 2);
+  if (record[0] != JSY_PROFILE_VERSION || record[JSY_PROFILE_SIZE - 2] != LOBYTE(crc) || record[JSY_PROFILE_SIZE - 1] != HIBYTE(crc)) {
+    LOGW(TAG, "Invalid JSY profile %s", _profileKey);
+    return false;
   }
+
+  Profile profile;
+  profile.address = record[1];
+  profile.model = record[2] | (record[3] << 8);
+  profile.baudRate = static_cast<BaudRate>(record[4] | (record[5] << 8) | (record[6] << 16) | (static_cast<uint32_t>(record[7]) << 24));
+  profile.mode = static_cast<Mode>(record[8]);
+  profile.negotiated = record[9] & JSY_PROFILE_FLAG_NEGOTIATED;
+  _persisted = profile;
+
+  // the profile of another device ?
+  if (address != MYCILA_JSY_ADDRESS_BROADCAST && address != profile.address)
+    return false;
+  if (model != MYCILA_JSY_MK_UNKNOWN && model != profile.model)
+    return false;
+  if (findRegisterMap(profile.model) == nullptr || !isBaudRateSupported(profile.model, profile.baudRate))
+    return false;
+
+  _profile = profile;
+  return true;
+}
+
+void Mycila::JSY::_saveProfile() {
+  if (!_profileStorage)
+    return;
+
+  // avoid useless flash writes
+  if (_profile.address == _persisted.address && _profile.model == _persisted.model && _profile.baudRate == _persisted.baudRate && _profile.mode == _persisted.mode && _profile.negotiated == _persisted.negotiated)
+    return;
+
+  uint8_t record[JSY_PROFILE_SIZE];
+  record[0] = JSY_PROFILE_VERSION;
+  record[1] = _profile.address;
+  record[2] = LOBYTE(_profile.model);
+  record[3] = HIBYTE(_profile.model);
+  record[4] = _profile.baudRate & 0xFF;
+  record[5] = (_profile.baudRate >> 8) & 0xFF;
+  record[6] = (_profile.baudRate >> 16) & 0xFF;
+  record[7] = (_profile.baudRate >> 24) & 0xFF;
+  record[8] = static_cast<uint8_t>(_profile.mode);
+  record[9] = _profile.negotiated ? JSY_PROFILE_FLAG_NEGOTIATED : 0;
+  const uint16_t crc = _crc16(record, JSY_PROFILE_SIZE - 2);
+  record[JSY_PROFILE_SIZE - 2] = LOBYTE(crc);
+  record[JSY_PROFILE_SIZE - 1] = HIBYTE(crc);
+
+  // the same record may be stored already: the profile is not loaded when the baud rate is given to begin()
+  uint8_t stored[JSY_PROFILE_SIZE];
+  if (_profileStorage->read(_profileKey, stored, sizeof(stored)) == sizeof(stored) && memcmp(stored, record, sizeof(record)) == 0) {
+    _persisted = _profile;
+    return;
+  }
+
+  if (_profileStorage->write(_profileKey, record, sizeof(record))) {
+    LOGD(TAG, "JSY profile %s saved", _profileKey);
+    _persisted = _profile;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bauds detection
+///////////////////////////////////////////////////////////////////////////////
+
+Mycila::JSY::BaudRate Mycila::JSY::_detectBauds(const uint8_t address, const uint16_t model) {
+  for (size_t i = 0; i < AUTO_DETECT_BAUD_RATES_COUNT * 2; i++)
+    if (_probeBauds(address, model, i))
+      return AUTO_DETECT_BAUD_RATES[i % AUTO_DETECT_BAUD_RATES_COUNT];
   return BaudRate::UNKNOWN;
 }
 
+bool Mycila::JSY::_probeBauds(const uint8_t address, const uint16_t model, const size_t i) {
+  const BaudRate baudRate = AUTO_DETECT_BAUD_RATES[i % AUTO_DETECT_BAUD_RATES_COUNT];
+  // a known model cannot answer at the baud rates it does not support
+  if (model != MYCILA_JSY_MK_UNKNOWN && !isBaudRateSupported(model, baudRate))
+    return false;
+  // an unknown model only waits as long as the slowest model supporting this baud rate
+  const uint32_t timeout = model == MYCILA_JSY_MK_UNKNOWN ? discoveryProbeTimeout(baudRate) : firstByteTimeout(model);
+  LOGD(TAG, "find(0x%02X) %" PRIu32 " bauds", address, baudRate);
+  _openSerial(baudRate);
+  for (int j = 0; j < MYCILA_JSY_RETRY_COUNT; j++) {
+    if (_canRead(address, baudRate, timeout)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// next higher baud rate, or BaudRate::UNKNOWN above 38400 bauds
+static Mycila::JSY::BaudRate higherBaudRate(Mycila::JSY::BaudRate baudRate) {
+  switch (baudRate) {
+    case Mycila::JSY::BaudRate::BAUD_1200:
+      return Mycila::JSY::BaudRate::BAUD_2400;
+    case Mycila::JSY::BaudRate::BAUD_2400:
+      return Mycila::JSY::BaudRate::BAUD_4800;
+    case Mycila::JSY::BaudRate::BAUD_4800:
+      return Mycila::JSY::BaudRate::BAUD_9600;
+    case Mycila::JSY::BaudRate::BAUD_9600:
+      return Mycila::JSY::BaudRate::BAUD_19200;
+    case Mycila::JSY::BaudRate::BAUD_19200:
+      return Mycila::JSY::BaudRate::BAUD_38400;
+    default:
+      return Mycila::JSY::BaudRate::UNKNOWN;
+  }
+}
+
+// next lower baud rate, or BaudRate::UNKNOWN below 1200 bauds
+static Mycila::JSY::BaudRate lowerBaudRate(Mycila::JSY::BaudRate baudRate) {
+  switch (baudRate) {
+    case Mycila::JSY::BaudRate::BAUD_38400:
+      return Mycila::JSY::BaudRate::BAUD_19200;
+    case Mycila::JSY::BaudRate::BAUD_19200:
+      return Mycila::JSY::BaudRate::BAUD_9600;
+    case Mycila::JSY::BaudRate::BAUD_9600:
+      return Mycila::JSY::BaudRate::BAUD_4800;
+    case Mycila::JSY::BaudRate::BAUD_4800:
+      return Mycila::JSY::BaudRate::BAUD_2400;
+    case Mycila::JSY::BaudRate::BAUD_2400:
+      return Mycila::JSY::BaudRate::BAUD_1200;
+    default:
+      return Mycila::JSY::BaudRate::UNKNOWN;
+  }
+}
+
+bool Mycila::JSY::_upgradeBaudRate() {
+  const BaudRate previous = _baudRate;
+  const uint8_t address = _lastAddress;
+  const uint32_t timeout = firstByteTimeout(_model);
+  bool failed = false;
+
+  // each step down is requested at the speed which was just rejected: it is degraded but still answers
+  for (BaudRate baudRate = getMaxAvailableBaudRate(_model); baudRate > previous; baudRate = lowerBaudRate(baudRate)) {
+    LOGI(TAG, "JSY @ 0x%02X: trying speed %" PRIu32 " bauds", address, baudRate);
+    if (!_set(address, address, baudRate)) {
+      failed = true;
+      break;
+    }
+
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < MYCILA_JSY_BAUD_UPGRADE_CHECKS && errors <= MYCILA_JSY_BAUD_UPGRADE_MAX_ERRORS; i++)
+      if (!_canRead(address, baudRate, timeout))
+        errors++;
+
+    if (errors <= MYCILA_JSY_BAUD_UPGRADE_MAX_ERRORS) {
+      LOGI(TAG, "JSY @ 0x%02X upgraded to speed %" PRIu32 " bauds", address, baudRate);
+      return true;
+    }
+
+    LOGW(TAG, "JSY @ 0x%02X: too many errors at speed %" PRIu32 " bauds", address, baudRate);
+  }
+
+  // back to the original speed
+  for (int i = 0; i < MYCILA_JSY_RETRY_COUNT && _baudRate != previous; i++)
+    _set(address, address, previous);
+
+  if (!failed && _baudRate == previous) {
+    LOGI(TAG, "JSY @ 0x%02X kept at speed %" PRIu32 " bauds", address, previous);
+    return true;
+  }
+
+  // a failed switch leaves the device at an unknown speed
+  if (_canRead(address, _baudRate, timeout)) {
+    LOGW(TAG, "JSY @ 0x%02X kept at speed %" PRIu32 " bauds", address, _baudRate);
+  } else {
+    LOGW(TAG, "JSY @ 0x%02X lost after a speed change: detecting it", address);
+    _baudRate = _detectBauds(address, _model);
+    if (_baudRate == BaudRate::UNKNOWN) {
+      LOGE(TAG, "Unable to read any JSY @ 0x%02X at any supported speed.", address);
+      return false;
+    }
+  }
+  _profile.baudRate = _baudRate;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// baud rate tuning
+///////////////////////////////////////////////////////////////////////////////
+
+static_assert(MYCILA_JSY_TUNING_WINDOW > 0 && MYCILA_JSY_TUNING_WINDOW <= 64, "MYCILA_JSY_TUNING_WINDOW must be between 1 and 64");
+
+#define JSY_TUNING_MASK         (MYCILA_JSY_TUNING_WINDOW == 64 ? UINT64_MAX : (1ULL << MYCILA_JSY_TUNING_WINDOW) - 1)
+#define JSY_TUNING_MAX_BACKOFF  4
+
+void Mycila::JSY::setBaudRateTuning(bool enabled) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tuningTarget = _baudRate;
+  _tuningResults = 0;
+  _tuningCount = 0;
+  _tuningSince = millis();
+  _tuningBackoff = 0;
+  _tuningProbing = false;
+  _tuning = enabled;
+}
+
+void Mycila::JSY::_tuneBaudRate(const ReadResult result) {
+  BaudRate previous;
+  BaudRate baudRate;
+  uint8_t address;
+  uint32_t errors;
+
+  // the window is shared by the async task and the reads of the user: only a baud rate change is done without the lock, which it takes
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    switch (result) {
+      case ReadResult::READ_SUCCESS:
+        _tuningResults <<= 1;
+        break;
+      case ReadResult::READ_TIMEOUT:
+      case ReadResult::READ_ERROR_COUNT:
+      case ReadResult::READ_ERROR_CRC:
+        _tuningResults = (_tuningResults << 1) | 1;
+        break;
+      default:
+        // not related to the line
+        return;
+    }
+
+    if (_tuningCount < MYCILA_JSY_TUNING_WINDOW)
+      _tuningCount++;
+    if (_tuningCount < MYCILA_JSY_TUNING_WINDOW)
+      return;
+
+    errors = __builtin_popcountll(_tuningResults & JSY_TUNING_MASK);
+
+    const uint32_t quietPeriod = static_cast<uint32_t>(MYCILA_JSY_TUNING_QUIET_PERIOD_MS) << _tuningBackoff;
+    const bool quiet = millis() - _tuningSince >= quietPeriod;
+
+    if (errors * 100 > MYCILA_JSY_TUNING_WINDOW * MYCILA_JSY_TUNING_MAX_ERROR_RATE) {
+      baudRate = lowerBaudRate(_baudRate);
+      if (baudRate < getMinAvailableBaudRate(_model)) {
+        // nothing slower
+        _tuningCount = 0;
+        return;
+      }
+      // the probed baud rate did not hold for a quiet period: wait longer before the next probe
+      if (_tuningProbing && !quiet && _tuningBackoff < JSY_TUNING_MAX_BACKOFF)
+        _tuningBackoff++;
+      else if (quiet)
+        _tuningBackoff = 0;
+
+    } else if (!errors && _baudRate < _tuningTarget && quiet) {
+      baudRate = higherBaudRate(_baudRate);
+
+    } else {
+      return;
+    }
+
+    previous = _baudRate;
+    address = _destinationAddress == MYCILA_JSY_ADDRESS_BROADCAST ? _profile.address : _destinationAddress;
+    _tuningResults = 0;
+    _tuningCount = 0;
+  }
+
+  if (_set(_destinationAddress, address, baudRate)) {
+    LOGI(TAG, "JSY @ 0x%02X speed tuned from %" PRIu32 " to %" PRIu32 " bauds (%" PRIu32 " errors in %d reads)", address, previous, baudRate, errors, MYCILA_JSY_TUNING_WINDOW);
+
+  } else {
+    LOGW(TAG, "Unable to tune JSY @ 0x%02X speed from %" PRIu32 " to %" PRIu32 " bauds", address, previous, baudRate);
+
+    // the device may have switched without being able to answer the check at its new speed
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_canRead(_destinationAddress, previous, firstByteTimeout(_model)))
+        return;
+      _openSerial(baudRate);
+      if (!_canRead(_destinationAddress, baudRate, firstByteTimeout(_model))) {
+        _openSerial(previous);
+        return;
+      }
+      _baudRate = baudRate;
+      _profile.baudRate = baudRate;
+      _saveProfile();
+    }
+
+    LOGW(TAG, "JSY @ 0x%02X answers at speed %" PRIu32 " bauds", address, baudRate);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tuningProbing = baudRate > previous;
+    _tuningSince = millis();
+  }
+  _event(EventType::EVT_BAUD_RATE_CHANGE);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // static
 ///////////////////////////////////////////////////////////////////////////////
@@ -1347,23 +2795,6 @@ inline uint16_t Mycila::JSY::_crc16(const uint8_t* data, size_t len) {
   return crc;
 }
 
-uint8_t Mycila::JSY::_register8(const uint8_t* buffer, const uint16_t registerStart, const uint16_t registerSize, const uint16_t registerAddress, uint8_t index) {
-  return buffer[JSY_RESPONSE_DATA + (registerAddress - registerStart) * registerSize + index];
-}
-
-uint16_t Mycila::JSY::_register16(const uint8_t* buffer, const uint16_t registerStart, const uint16_t registerSize, const uint16_t registerAddress) {
-  const size_t start = JSY_RESPONSE_DATA + (registerAddress - registerStart) * registerSize;
-  return (buffer[start] << 8) + buffer[start + 1];
-}
-
-uint32_t Mycila::JSY::_register32(const uint8_t* buffer, const uint16_t registerStart, const uint16_t registerSize, const uint16_t registerAddress) {
-  const size_t start = JSY_RESPONSE_DATA + (registerAddress - registerStart) * registerSize;
-  return (buffer[start] << 24) +
-         (buffer[start + 1] << 16) +
-         (buffer[start + 2] << 8) +
-         (buffer[start + 3]);
-}
-
 const char* Mycila::JSY::getModelName(uint16_t model) {
   switch (model) {
     case MYCILA_JSY_MK_1031:
@@ -1385,21 +2816,257 @@ const char* Mycila::JSY::getModelName(uint16_t model) {
   }
 }
 
+const char* Mycila::JSY::getChannelName(uint16_t model, uint8_t channel) {
+  if (channel == AGGREGATE)
+    return "aggregate";
+  switch (model) {
+    case MYCILA_JSY_MK_193:
+    case MYCILA_JSY_MK_194: {
+      static constexpr const char* CHANNELS[] = {"channel1", "channel2"};
+      return channel < 2 ? CHANNELS[channel] : nullptr;
+    }
+    case MYCILA_JSY_MK_333: {
+      static constexpr const char* PHASES[] = {"phaseA", "phaseB", "phaseC"};
+      return channel < 3 ? PHASES[channel] : nullptr;
+    }
+    default:
+      return nullptr;
+  }
+}
+
 void Mycila::JSY::_jsyTask(void* params) {
   JSY* jsy = reinterpret_cast<JSY*>(params);
   while (jsy->_enabled) {
-    if (jsy->read()) {
-      if (jsy->_pause > 0) {
-        delay(jsy->_pause);
-      } else {
-        yield();
-      }
-    } else if (jsy->_pause > 0) {
-      delay(jsy->_pause);
-    } else {
-      delay(10);
+    if (jsy->_connectionState == ConnectionState::LOST) {
+      jsy->_rediscover();
+      // the slots missed while the device was lost are not overruns
+      jsy->_deadline = 0;
+      continue;
+    }
+    jsy->_waitSlot();
+    ReadResult result;
+    jsy->_read(jsy->_destinationAddress, jsy->_model, result);
+    if (!jsy->_enabled)
+      break;
+    const uint32_t wait = jsy->_updateConnection(result);
+    if (wait > 0) {
+      jsy->_wait(wait);
+    } else if (!jsy->_period) {
+      yield();
     }
   }
   jsy->_taskHandle = NULL;
   vTaskDelete(NULL);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// connection state
+///////////////////////////////////////////////////////////////////////////////
+
+uint32_t Mycila::JSY::_updateConnection(const ReadResult result) {
+  switch (result) {
+    case ReadResult::READ_SUCCESS:
+      _failures = 0;
+      _timeouts = 0;
+      _rediscoveryBackoff = 0;
+      if (_connectionState != ConnectionState::CONNECTED)
+        _setConnectionState(ConnectionState::CONNECTED, EventType::EVT_CONNECTED);
+      // with a period, the next slot paces the reads
+      return _period ? 0 : _pause;
+    case ReadResult::READ_TIMEOUT:
+      _failures++;
+      _timeouts++;
+      break;
+    default:
+      // something answered
+      _failures++;
+      _timeouts = 0;
+      break;
+  }
+
+  if (_timeouts >= MYCILA_JSY_LOST_TIMEOUTS) {
+    _setConnectionState(ConnectionState::LOST, EventType::EVT_LOST);
+    return 0;
+  }
+
+  if (_failures < MYCILA_JSY_DEGRADED_FAILURES)
+    return _period ? 0 : (_pause > 0 ? _pause : 10);
+
+  if (_connectionState == ConnectionState::CONNECTED)
+    _setConnectionState(ConnectionState::DEGRADED, EventType::EVT_DEGRADED);
+
+  // 1, 2, 4, ... times the minimum backoff
+  const uint32_t shift = std::min(_failures - MYCILA_JSY_DEGRADED_FAILURES, static_cast<uint32_t>(16));
+  return std::max(_pause, std::min(static_cast<uint32_t>(MYCILA_JSY_BACKOFF_MIN_MS) << shift, static_cast<uint32_t>(MYCILA_JSY_BACKOFF_MAX_MS)));
+}
+
+void Mycila::JSY::_rediscover() {
+  // the first detection starts right away
+  _wait(_rediscoveryBackoff);
+  if (!_enabled)
+    return;
+
+  _setConnectionState(ConnectionState::REDISCOVERING, EventType::EVT_REDISCOVERING);
+
+  // the lock is released between the baud rates: the other calls wait for one probe at most
+  BaudRate baudRate = BaudRate::UNKNOWN;
+  for (size_t i = 0; i < AUTO_DETECT_BAUD_RATES_COUNT * 2 && _enabled && baudRate == BaudRate::UNKNOWN; i++) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_probeBauds(_destinationAddress, _model, i))
+      baudRate = AUTO_DETECT_BAUD_RATES[i % AUTO_DETECT_BAUD_RATES_COUNT];
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_enabled)
+      return;
+    if (baudRate != BaudRate::UNKNOWN) {
+      _baudRate = baudRate;
+      if (_lastAddress == _profile.address) {
+        _profile.baudRate = baudRate;
+        _saveProfile();
+      }
+    } else {
+      // reopened at the known baud rate for the next detection
+      _openSerial(_baudRate);
+    }
+  }
+
+  if (baudRate == BaudRate::UNKNOWN) {
+    _rediscoveryBackoff = std::clamp(_rediscoveryBackoff * 2, static_cast<uint32_t>(MYCILA_JSY_BACKOFF_MIN_MS), static_cast<uint32_t>(MYCILA_JSY_BACKOFF_MAX_MS));
+    LOGW(TAG, "JSY @ 0x%02X still lost, next detection in %" PRIu32 " ms", _destinationAddress, _rediscoveryBackoff);
+    _setConnectionState(ConnectionState::LOST, EventType::EVT_LOST);
+    return;
+  }
+
+  // CONNECTED at the next successful read
+  LOGI(TAG, "JSY @ 0x%02X found again with speed %" PRIu32 " bauds", _destinationAddress, baudRate);
+  _failures = 0;
+  _timeouts = 0;
+}
+
+void Mycila::JSY::_setConnectionState(const ConnectionState state, const EventType eventType) {
+  if (_connectionState == state)
+    return;
+  LOGD(TAG, "JSY @ 0x%02X connection state: %d -> %d", _destinationAddress, static_cast<int>(_connectionState), static_cast<int>(state));
+  _connectionState = state;
+  _event(eventType);
+}
+
+void Mycila::JSY::_wait(const uint32_t ms) const {
+  // end() waits for the async task to stop
+  const uint32_t start = millis();
+  while (_enabled && millis() - start < ms)
+    delay(std::min(ms - (millis() - start), static_cast<uint32_t>(50)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fixed rate sampling
+///////////////////////////////////////////////////////////////////////////////
+
+// time of the system clock in microseconds, set by SNTP
+static int64_t wallTime() {
+#ifdef ARDUINO_NATIVE
+  // the simulated clock
+  return esp_timer_get_time();
+#else
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+#endif
+}
+
+void Mycila::JSY::setPeriod(const uint32_t period, const bool aligned) {
+  _period = period;
+  _periodAligned = aligned;
+  // applied by the async task
+  _periodChanged = true;
+}
+
+Mycila::JSY::Schedule Mycila::JSY::getSchedule() const {
+  while (true) {
+    const uint32_t seq = _scheduleSeq.load(std::memory_order_acquire);
+    // being published
+    if (seq % 2)
+      continue;
+    Schedule schedule = _schedulePublished;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_scheduleSeq.load(std::memory_order_relaxed) == seq)
+      return schedule;
+  }
+}
+
+void Mycila::JSY::_publishSchedule() {
+  _scheduleSeq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _schedulePublished = _schedule;
+  _scheduleSeq.fetch_add(1, std::memory_order_release);
+}
+
+void Mycila::JSY::_waitSlot() {
+  if (_periodChanged.exchange(false)) {
+    _schedule.clear();
+    _publishSchedule();
+    _deadline = 0;
+  }
+
+  const int64_t period = static_cast<int64_t>(_period) * 1000;
+  if (!period)
+    return;
+  int64_t now = esp_timer_get_time();
+
+  if (_deadline == 0) {
+    // a new schedule starts now, or at the next multiple of the period of the system time
+    _deadline = now;
+    _lastSample = 0;
+    if (_periodAligned)
+      _deadline += (period - wallTime() % period) % period;
+  } else {
+    _deadline += period;
+    if (_periodAligned) {
+      // moves the slot to the nearest multiple of the period of the system time, following its drift and its adjustments
+      const int64_t phase = (wallTime() + (_deadline - now)) % period;
+      _deadline += phase < period / 2 ? -phase : period - phase;
+    }
+  }
+
+  if (_deadline < now) {
+    // the latest slot passed is read now, the older ones are skipped
+    const int64_t missed = (now - _deadline) / period;
+    _deadline += missed * period;
+    if (_lastSample)
+      _schedule.overruns += missed;
+  }
+
+  // sleeps, then spins the last millisecond
+  const int64_t deadline = _deadline;
+  while (_enabled && !_periodChanged) {
+    now = esp_timer_get_time();
+    const int64_t remaining = deadline - now;
+    if (remaining <= 0)
+      break;
+    if (remaining >= 1000) {
+      delay(std::min(remaining / 1000, static_cast<int64_t>(50)));
+    } else {
+      delayMicroseconds(remaining);
+    }
+  }
+
+  // end() or setPeriod() stopped the wait before the slot: no sample
+  if (!_enabled || _periodChanged || now < deadline)
+    return;
+
+  const uint32_t jitter = now - deadline;
+  if (_schedule.samples++ == 0) {
+    _schedule.jitterMin = jitter;
+    _schedule.jitterMax = jitter;
+  } else {
+    _schedule.jitterMin = std::min(_schedule.jitterMin, jitter);
+    _schedule.jitterMax = std::max(_schedule.jitterMax, jitter);
+  }
+  _schedule.jitterTotal += jitter;
+  if (_lastSample)
+    _schedule.elapsed += now - _lastSample;
+  _lastSample = now;
+  _publishSchedule();
+}
@@ -6,6 +6,10 @@
 
 #include <HardwareSerial.h>
 
+#include "MycilaJSYJsonWriter.h"
+
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <utility>
 
@@ -13,6 +17,12 @@
   #include <ArduinoJson.h>
 #endif
 
+#ifdef MYCILA_JSY_UART_IDF
+  #include <driver/uart.h>
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/queue.h>
+#endif
+
 #define MYCILA_JSY_VERSION          "15.3.11"
 #define MYCILA_JSY_VERSION_MAJOR    15
 #define MYCILA_JSY_VERSION_MINOR    3
@@ -69,20 +79,112 @@
   #define MYCILA_JSY_ASYNC_READ_PAUSE_MS 0
 #endif
 
-// Maximumtime in milliseconds to wait for bytes to arrive when reading a JSY response
-// This value is conservative and work with all JSY.
-// If you happen to only use specific JSY models, you can reduce this value to speed up the read process.
-// Only JSY1031 are slow and require such a big timeout.
-// For other models, the timeout can be decreased safely to 500 ms.
+// Maximum time in milliseconds to wait for the first byte of a JSY response when the device is slow or its model is unknown.
+// Only JSY1031 are slow and require such a big timeout. It is also used for write requests (address, speed, mode, energy reset)
+// and to read the model of a device.
 #ifndef MYCILA_JSY_READ_TIMEOUT_MS
   #define MYCILA_JSY_READ_TIMEOUT_MS 1000
 #endif
 
+// Maximum time in milliseconds to wait for the first byte of a read response for the models other than JSY1031.
+// They start answering 20 to 30 ms after the end of the request.
+#ifndef MYCILA_JSY_FIRST_BYTE_TIMEOUT_MS
+  #define MYCILA_JSY_FIRST_BYTE_TIMEOUT_MS 80
+#endif
+
+// Number of responses of a device to observe before its learned response time is used as read deadline (see JSY::Turnaround)
+#ifndef MYCILA_JSY_TURNAROUND_SAMPLES
+  #define MYCILA_JSY_TURNAROUND_SAMPLES 8
+#endif
+
+// Lower bound in milliseconds of a learned read deadline
+#ifndef MYCILA_JSY_TURNAROUND_MIN_TIMEOUT_MS
+  #define MYCILA_JSY_TURNAROUND_MIN_TIMEOUT_MS 20
+#endif
+
+// ESP-IDF UART backend (-D MYCILA_JSY_UART_IDF): the UART is driven with the ESP-IDF driver instead of the Arduino HardwareSerial API.
+// Responses are received from the driver events: the reading task sleeps on the event queue until data arrives or the deadline is reached.
+// Number of received bytes triggering a data event (the end of a frame is signalled after 1 character of silence whatever this value)
+#ifndef MYCILA_JSY_UART_RX_FULL_THRESHOLD
+  #define MYCILA_JSY_UART_RX_FULL_THRESHOLD 16
+#endif
+
+// Size of the UART driver event queue
+#ifndef MYCILA_JSY_UART_EVENT_QUEUE_SIZE
+  #define MYCILA_JSY_UART_EVENT_QUEUE_SIZE 16
+#endif
+
 #ifndef MYCILA_JSY_RETRY_COUNT
   #define MYCILA_JSY_RETRY_COUNT 3
 #endif
 
+// Number of model reads checking a new baud rate negotiated at begin() (see JSY::setBaudRateUpgrade())
+#ifndef MYCILA_JSY_BAUD_UPGRADE_CHECKS
+  #define MYCILA_JSY_BAUD_UPGRADE_CHECKS 20
+#endif
+
+// Maximum number of failed checks for a new baud rate negotiated at begin() to be kept
+#ifndef MYCILA_JSY_BAUD_UPGRADE_MAX_ERRORS
+  #define MYCILA_JSY_BAUD_UPGRADE_MAX_ERRORS 1
+#endif
+
+// Baud rate auto-tuning (see JSY::setBaudRateTuning()): number of reads in the sliding window of the error rate (up to 64)
+#ifndef MYCILA_JSY_TUNING_WINDOW
+  #define MYCILA_JSY_TUNING_WINDOW 32
+#endif
+
+// Percentage of failed reads (timeouts, count and CRC errors) in the window stepping the baud rate down
+#ifndef MYCILA_JSY_TUNING_MAX_ERROR_RATE
+  #define MYCILA_JSY_TUNING_MAX_ERROR_RATE 10
+#endif
+
+// Time in milliseconds without errors before probing the next higher baud rate, doubled after each failed probe (up to 16 times)
+#ifndef MYCILA_JSY_TUNING_QUIET_PERIOD_MS
+  #define MYCILA_JSY_TUNING_QUIET_PERIOD_MS 600000
+#endif
+
+// Async mode: number of consecutive failed reads making the connection DEGRADED (see JSY::ConnectionState)
+#ifndef MYCILA_JSY_DEGRADED_FAILURES
+  #define MYCILA_JSY_DEGRADED_FAILURES 3
+#endif
+
+// Async mode: number of consecutive read timeouts making the device LOST, which starts the detection of its baud rate
+#ifndef MYCILA_JSY_LOST_TIMEOUTS
+  #define MYCILA_JSY_LOST_TIMEOUTS 10
+#endif
+
+// Async mode: bounds in milliseconds of the exponential backoff between the reads of a DEGRADED connection and between the detections of a LOST device
+#ifndef MYCILA_JSY_BACKOFF_MIN_MS
+  #define MYCILA_JSY_BACKOFF_MIN_MS 100
+#endif
+#ifndef MYCILA_JSY_BACKOFF_MAX_MS
+  #define MYCILA_JSY_BACKOFF_MAX_MS 60000
+#endif
+
+// Number of raw frames which can wait between the I/O task and the decoding task when the pipeline is enabled (see setPipeline())
+#ifndef MYCILA_JSY_PIPELINE_DEPTH
+  #define MYCILA_JSY_PIPELINE_DEPTH 4
+#endif
+
+// Maximum number of register windows read in a poll when only some fields are selected (see setFields())
+#ifndef MYCILA_JSY_READ_WINDOWS_MAX
+  #define MYCILA_JSY_READ_WINDOWS_MAX 4
+#endif
+
+// Gap in bytes between two register windows under which they are merged and read with a single request.
+// A new request costs 13 bytes (8 for the request, 5 for the response header and CRC) plus the device turnaround time (20 to 30 ms for most devices).
+#ifndef MYCILA_JSY_READ_WINDOWS_GAP
+  #define MYCILA_JSY_READ_WINDOWS_GAP 32
+#endif
+
 namespace Mycila {
+  class JSYBus;
+  class JSYHistory;
+  class JSYStats;
+  class JSYBinary;
+  class JSYEnergy;
+  class JSYStorage;
+
   class JSY {
     public:
       enum BaudRate : uint32_t {
@@ -111,7 +213,31 @@ namespace Mycila {
         // timeout reached when reading values
         EVT_READ_TIMEOUT,
         // wrong JSY device read
-        EVT_READ_PEER
+        EVT_READ_PEER,
+        // baud rate changed by the auto-tuning (see setBaudRateTuning() and getBaudRate())
+        EVT_BAUD_RATE_CHANGE,
+        // async mode: the device answers again (see ConnectionState)
+        EVT_CONNECTED,
+        // async mode: several reads failed in a row
+        EVT_DEGRADED,
+        // async mode: the device does not answer anymore
+        EVT_LOST,
+        // async mode: the baud rate of the lost device is being detected
+        EVT_REDISCOVERING
+      };
+
+      /**
+       * @brief State of the connection with the device in async mode, each change being notified with its event (EVT_CONNECTED, EVT_DEGRADED, EVT_LOST, EVT_REDISCOVERING).
+       */
+      enum class ConnectionState {
+        // the last read succeeded
+        CONNECTED,
+        // MYCILA_JSY_DEGRADED_FAILURES reads failed in a row: the next reads are spaced with an exponential backoff
+        DEGRADED,
+        // MYCILA_JSY_LOST_TIMEOUTS reads timed out in a row: the baud rate is detected again, with an exponential backoff between the detections
+        LOST,
+        // the baud rate is being detected, or was detected and waits for a successful read
+        REDISCOVERING
       };
 
       enum class Mode {
@@ -120,6 +246,32 @@ namespace Mycila {
         DC
       };
 
+      // Metrics fields which can be selected with setFields() to reduce the registers read at each poll.
+      // A field applies to all the channels / phases and to the aggregate.
+      enum Field : uint32_t {
+        FIELD_NONE = 0,
+        FIELD_FREQUENCY = 1UL << 0,
+        FIELD_VOLTAGE = 1UL << 1,
+        FIELD_CURRENT = 1UL << 2,
+        FIELD_ACTIVE_POWER = 1UL << 3,
+        FIELD_REACTIVE_POWER = 1UL << 4,
+        FIELD_APPARENT_POWER = 1UL << 5,
+        FIELD_POWER_FACTOR = 1UL << 6,
+        FIELD_ACTIVE_ENERGY = 1UL << 7,
+        FIELD_ACTIVE_ENERGY_IMPORTED = 1UL << 8,
+        FIELD_ACTIVE_ENERGY_RETURNED = 1UL << 9,
+        FIELD_REACTIVE_ENERGY = 1UL << 10,
+        FIELD_REACTIVE_ENERGY_IMPORTED = 1UL << 11,
+        FIELD_REACTIVE_ENERGY_RETURNED = 1UL << 12,
+        FIELD_APPARENT_ENERGY = 1UL << 13,
+        FIELD_PHASE_ANGLE_U = 1UL << 14,
+        FIELD_PHASE_ANGLE_I = 1UL << 15,
+        FIELD_PHASE_ANGLE_UI = 1UL << 16,
+        FIELD_THD_U = 1UL << 17,
+        FIELD_THD_I = 1UL << 18,
+        FIELD_ALL = (1UL << 19) - 1,
+      };
+
       class Metrics {
         public:
           /**
@@ -284,6 +436,8 @@ namespace Mycila {
 #ifdef MYCILA_JSON_SUPPORT
           void toJson(const JsonObject& root) const;
 #endif
+          // write the same keys as toJson(JsonObject) into the current object of the writer
+          void toJson(JSYJsonWriter& writer) const; // NOLINT
       };
 
       class Data {
@@ -329,13 +483,157 @@ namespace Mycila {
 #ifdef MYCILA_JSON_SUPPORT
           void toJson(const JsonObject& root) const;
 #endif
+          // write the same keys as toJson(JsonObject) into the current object of the writer
+          void toJson(JSYJsonWriter& writer) const; // NOLINT
+          /**
+           * @brief Write the same JSON as toJson(JsonObject) to a buffer, without ArduinoJson and without allocation.
+           * @return The length of the JSON, which is larger than size - 1 if the output was truncated
+           */
+          size_t toJson(char* buffer, size_t size) const;
+          // write the same JSON as toJson(JsonObject) to a Print, without ArduinoJson and without allocation
+          size_t toJson(Print& out) const; // NOLINT
 
         private:
           friend class JSY;
+          friend class JSYHistory;
+          friend class JSYBinary;
           Metrics _metrics[3];
       };
 
+      // Channel index of the aggregate, after the channels / phases 0, 1 and 2
+      static constexpr uint8_t AGGREGATE = 3;
+
+      // Value of a field in Metrics: a real or an energy counter, and its JSON key
+      struct FieldTarget {
+          float Metrics::* real;
+          uint32_t Metrics::* counter;
+          const char* key;
+      };
+
+      // Number of fields (FIELD_ALL == (1 << FIELD_COUNT) - 1)
+      static constexpr size_t FIELD_COUNT = 19;
+
+      // Value of each field, in the order of the Field bits
+      static const FieldTarget FIELD_TARGETS[FIELD_COUNT];
+
       typedef std::function<void(EventType eventType, const Data& data)> Callback;
+      // Callback receiving the fields (FIELD_*) which changed since the last notified data (see setDeadband())
+      typedef std::function<void(EventType eventType, const Data& data, uint32_t changed)> ChangeCallback;
+
+      /**
+       * @brief Response time statistics of a device: time between the end of a read request and the first byte of the response.
+       * Once enough responses are observed, the read deadline of the device is derived from them instead of the conservative
+       * MYCILA_JSY_FIRST_BYTE_TIMEOUT_MS / MYCILA_JSY_READ_TIMEOUT_MS, which stay the upper bound.
+       */
+      struct Turnaround {
+          uint32_t count = 0; // number of observed responses
+          float average = 0;  // smoothed response time in microseconds
+          uint32_t max = 0;   // maximum observed response time in microseconds
+
+          void update(uint32_t us);
+          void clear() { *this = Turnaround(); }
+          /**
+           * @return The time in milliseconds to wait for the first byte of a read response of this device
+           */
+          uint32_t getTimeout(uint16_t model) const;
+      };
+
+      /**
+       * @brief What is known about the destination device, persisted with setProfileStorage() to skip the detection at the next begin()
+       */
+      struct Profile {
+          uint8_t address = MYCILA_JSY_ADDRESS_UNKNOWN; // address of the device
+          uint16_t model = MYCILA_JSY_MK_UNKNOWN;
+          BaudRate baudRate = BaudRate::UNKNOWN;
+          Mode mode = Mode::UNKNOWN; // only known once read or set (see readMode() and setMode())
+          bool negotiated = false;   // the baud rate was negotiated at begin() (see setBaudRateUpgrade())
+      };
+
+      /**
+       * @brief A device found by discover()
+       */
+      struct Discovery {
+          uint8_t address = MYCILA_JSY_ADDRESS_UNKNOWN;
+          uint16_t model = MYCILA_JSY_MK_UNKNOWN;
+          BaudRate baudRate = BaudRate::UNKNOWN;
+          Mode mode = Mode::UNKNOWN;
+      };
+
+      /**
+       * @brief Progress of discover(), called after each address checked.
+       * @param found The device just found at this address, or nullptr
+       * @param done The number of (baud rate, address) combinations checked or skipped so far
+       * @param total The number of (baud rate, address) combinations of the discovery
+       * @return false to cancel the discovery
+       */
+      typedef std::function<bool(const Discovery* found, size_t done, size_t total)> DiscoveryCallback;
+
+      /**
+       * @brief Always-on counters of the exchanges with the devices (see getInstrumentation()), to see where the time of a read goes.
+       * All the exchanges are counted, including the model reads and the probes of the baud rate detection. Times are in microseconds.
+       */
+      struct Instrumentation {
+          struct Phase {
+              uint32_t count = 0;
+              uint64_t total = 0; // cumulative time
+              uint32_t last = 0;
+              uint32_t max = 0;
+
+              void add(uint32_t us);
+              float average() const { return count ? static_cast<float>(total) / count : 0; }
+          };
+
+          // results of the exchanges
+          uint32_t success = 0;
+          uint32_t timeouts = 0;
+          uint32_t errorCount = 0;   // response of the wrong length
+          uint32_t errorCrc = 0;     // response with a bad CRC
+          uint32_t errorAddress = 0; // response from another device
+          uint32_t errorModel = 0;   // read of an unsupported model (nothing sent)
+          uint64_t bytesSent = 0;
+          uint64_t bytesReceived = 0;
+
+          Phase send;     // waiting for the line to be idle, then sending the request until it is on the wire
+          Phase wait;     // waiting for the first byte of the response (or the timeout)
+          Phase receive;  // receiving the rest of the response, until it is complete or the line is silent
+          Phase check;    // length, CRC and address checks of the response
+          Phase decode;   // decoding the registers of a successful read
+          Phase callback; // publishing the data and calling the callbacks of a read
+
+          void clear() { *this = Instrumentation(); }
+
+#ifdef MYCILA_JSON_SUPPORT
+          void toJson(const JsonObject& root) const;
+#endif
+          // write the same keys as toJson(JsonObject) into the current object of the writer
+          void toJson(JSYJsonWriter& writer) const; // NOLINT
+      };
+
+      /**
+       * @brief Statistics of the fixed rate sampling in async mode (see setPeriod()), since begin() or setPeriod(). Times are in microseconds.
+       */
+      struct Schedule {
+          uint32_t samples = 0;   // reads started on a slot
+          uint32_t overruns = 0;  // slots skipped because the previous read (or a backoff) ended after them
+          uint32_t jitterMin = 0; // delay between a slot and the start of its read
+          uint32_t jitterMax = 0;
+          uint64_t jitterTotal = 0;
+          uint64_t elapsed = 0; // time between the first and the last read started
+
+          float jitterAverage() const { return samples ? static_cast<float>(jitterTotal) / samples : 0; }
+          // achieved sample rate in reads per second
+          float rate() const { return elapsed ? (samples - 1) * 1000000.0f / elapsed : 0; }
+          void clear() { *this = Schedule(); }
+      };
+
+      /**
+       * @brief A consistent copy of the last published data (see getSnapshot())
+       */
+      struct Snapshot {
+          Data data;
+          uint32_t time = 0;       // time in milliseconds of the last successful read
+          uint32_t generation = 0; // incremented at each publication, 0 if nothing was published yet
+      };
 
       ~JSY() { end(); }
 
@@ -389,6 +687,34 @@ namespace Mycila {
        */
       void end();
 
+      /**
+       * @brief Find the devices answering on a serial port, at all the addresses of a range and all the baud rates of the detection.
+       * Each baud rate is first probed with a broadcast request, only waiting for the models supporting it (JSY1031 answers after 350 ms, the others in 20 to 30 ms):
+       * - nothing answers: the baud rate is skipped
+       * - a single device answers (i.e. on a TTL link): it is the only one at this baud rate
+       * - several devices answer (their bytes are mixed up): each address is requested with a deadline 50% above the response time of the broadcast instead of the default timeouts
+       * @param serial The serial port to use
+       * @param rxPin RX board pin connected to the TX of the devices
+       * @param txPin TX board pin connected to the RX of the devices
+       * @param devices The array receiving the devices found (address, model, baud rate and mode)
+       * @param maxDevices The size of the array
+       * @param callback Called after each address checked, to follow the progress or cancel the discovery (optional)
+       * @param firstAddress The first address to check (default: 1)
+       * @param lastAddress The last address to check (default: 255)
+       * @return The number of devices found, which can be greater than maxDevices (only the first ones are stored)
+       * @note Must be called when the JSY is not started (before begin() or after end()). The serial port is closed when it returns.
+       * @note The exchanges of the discovery are not counted in getInstrumentation().
+       * @note This function is blocking until all the baud rates and addresses are checked or the discovery is cancelled.
+       */
+      size_t discover(HardwareSerial& serial, // NOLINT
+                      int8_t rxPin,
+                      int8_t txPin,
+                      Discovery* devices,
+                      size_t maxDevices,
+                      DiscoveryCallback callback = nullptr,
+                      uint8_t firstAddress = 1,
+                      uint8_t lastAddress = 255);
+
       /**
        * @brief Set a new address for a device.
        * @param newAddress The new address to set (1-255)
@@ -438,6 +764,14 @@ namespace Mycila {
        */
       static const char* getModelName(uint16_t model);
 
+      /**
+       * @brief Get the name of a channel, as in the JSON of Data
+       * @param model The JSY model
+       * @param channel 0, 1, 2 for channel 1 / phase A, channel 2 / phase B, phase C or AGGREGATE
+       * @return "channel1", "channel2", "phaseA", "phaseB", "phaseC", "aggregate" or nullptr if the model does not have this channel
+       */
+      static const char* getChannelName(uint16_t model, uint8_t channel);
+
       /**
        * @brief Reads the JSY mode (AC or DC). Some JSY are able to work with either AC or DC current.
        * @return The mode of the JSY, or Mode::UNKNOWN if there is an error mode cannot be read.
@@ -485,6 +819,22 @@ namespace Mycila {
        */
       bool read(uint8_t address) { return _read(address, readModel(address)); }
 
+      /**
+       * @brief Select the fields to read at each poll (default: FIELD_ALL).
+       * Only the registers needed by these fields are requested, grouped in as few contiguous windows as possible,
+       * which can greatly reduce the number of bytes on the wire (i.e. for a JSY-MK-333 only used to control a load).
+       * Fields which are computed from other registers (i.e. apparent power of a JSY-MK-194) pull their inputs.
+       * Fields not selected are left cleared in Data.
+       * @param fields A combination of Field values
+       * @note isConnected() relies on the frequency: keep FIELD_FREQUENCY to use it.
+       */
+      void setFields(uint32_t fields);
+
+      /**
+       * @return The fields read at each poll
+       */
+      uint32_t getFields() const { return _fields; }
+
       /**
        * @brief Reset the energy counters of the JSY.
        * @return true if the reset was successful
@@ -523,12 +873,26 @@ namespace Mycila {
 #ifdef MYCILA_JSON_SUPPORT
       void toJson(const JsonObject& root) const;
 #endif
+      // write the same keys as toJson(JsonObject) into the current object of the writer
+      void toJson(JSYJsonWriter& writer) const; // NOLINT
+      /**
+       * @brief Write the same JSON as toJson(JsonObject) to a buffer, without ArduinoJson and without allocation.
+       * @return The length of the JSON, which is larger than size - 1 if the output was truncated
+       */
+      size_t toJson(char* buffer, size_t size) const;
+      // write the same JSON as toJson(JsonObject) to a Print, without ArduinoJson and without allocation
+      size_t toJson(Print& out) const; // NOLINT
 
       gpio_num_t getRXPin() const { return _pinRX; }
       gpio_num_t getTXPin() const { return _pinTX; }
       bool isEnabled() const { return _enabled; }
       BaudRate getBaudRate() const { return _baudRate; }
 
+      /**
+       * @return The state of the connection with the device, only tracked in async mode
+       */
+      ConnectionState getConnectionState() const { return _connectionState; }
+
       /**
        * @brief Get the address used to send requests.
        * @return The address used to send requests (1-255) or MYCILA_JSY_ADDRESS_BROADCAST (0) for all devices.
@@ -552,6 +916,31 @@ namespace Mycila {
       bool isBaudRateSupported(BaudRate baudRate) const;
       static bool isBaudRateSupported(uint16_t model, BaudRate baudRate);
 
+      /**
+       * @brief Resolution of a field for a model: the value of 1 unit of the register read (i.e. 0.01 for a voltage read in 1/100 V), 1 for the energies (Wh).
+       * Fields not read from the device (computed by the library) get the finest resolution of all the models.
+       * @param model The model of the device
+       * @param field A single field (FIELD_*)
+       * @return The resolution, or 0 if the field is invalid
+       */
+      static float getResolution(uint16_t model, uint32_t field);
+
+      /**
+       * @brief Decode a read response of the whole register map of a model, as sent by the device (i.e. a recorded frame).
+       * The data is updated the same way as by read(): its address and model are set and the fields of the model are decoded.
+       * @param model The model of the device which sent the frame
+       * @param frame The Modbus RTU response, CRC included
+       * @param len The length of the frame
+       * @param data The data to update
+       * @return false if the model is not supported, or if the length or the CRC of the frame is wrong
+       */
+      static bool decode(uint16_t model, const uint8_t* frame, size_t len, Data& data);
+
+      /**
+       * @return The Modbus CRC16 of a buffer, as sent in the last 2 bytes of a frame (low byte first)
+       */
+      static uint16_t crc16(const uint8_t* buffer, size_t len);
+
       /**
        * @brief Get the address of the last device's response.
        * @return The address of the last device's response (1-255) or MYCILA_JSY_ADDRESS_UNKNOWN if no response was received.
@@ -563,20 +952,251 @@ namespace Mycila {
        */
       uint32_t getTime() const { return _time; }
 
+      /**
+       * @brief Copy the last published data without waiting for a read in progress.
+       * Data is published after each read (successful or not: failed reads clear the data) and when it is cleared.
+       * This function does not lock: it can be called from any task or core while the JSY is read, and never returns a partially updated data.
+       * @param snapshot The snapshot to update. Its generation is used to skip the copy if nothing was published since.
+       * @return true if the snapshot was updated, false if nothing new was published since snapshot.generation
+       */
+      bool getSnapshot(Snapshot& snapshot) const;
+
+      /**
+       * @return The generation of the last published data, to cheaply check if something changed since a snapshot
+       */
+      uint32_t getGeneration() const { return _generation.load(std::memory_order_acquire); }
+
+      /**
+       * @return The response time statistics of the destination device
+       */
+      Turnaround getTurnaround() const { return _turnaround; }
+
+      /**
+       * @brief Counters of the exchanges and time spent in each phase of a read, since begin() or clearInstrumentation().
+       * The counters are updated without lock: a copy taken during a read can be off by this read.
+       */
+      Instrumentation getInstrumentation() const { return _instrumentation; }
+      void clearInstrumentation() { _instrumentation.clear(); }
+
       // check if the device is connected to the grid, meaning if last read was successful
       bool isConnected() const { return _data.aggregate.frequency > 0; }
 
       void setCallback(Callback callback) { _callback = std::move(callback); }
 
+      /**
+       * @brief Set a callback also receiving the fields which changed since the last notified data, on any channel / phase or the aggregate.
+       * For EVT_READ, the mask holds the fields which moved beyond their deadband (any change for the fields without deadband).
+       * For the other events, the mask is FIELD_ALL.
+       * @note Called after the callback set with setCallback(), with the same filtering.
+       */
+      void setChangeCallback(ChangeCallback callback) { _changeCallback = std::move(callback); }
+
+      /**
+       * @brief Only notify the callbacks of a read when a field moved significantly since the last notified data, or when a heartbeat is due (see setMaxSilence()).
+       * A field moved when |value - notified value| > max(absolute, relative * |notified value|) for a channel / phase or the aggregate.
+       * Fields without deadband do not trigger the callbacks once a deadband or a max silence is set.
+       * @param fields The fields (FIELD_*) to set the deadband of
+       * @param absolute The absolute deadband in the unit of the fields (i.e. 5 for 5 W with FIELD_ACTIVE_POWER, 1 for 1 Wh with FIELD_ACTIVE_ENERGY)
+       * @param relative The relative deadband (i.e. 0.02 for 2 %)
+       * @note Read errors and timeouts are always notified. Snapshots and statistics are updated at each read whatever the deadbands.
+       */
+      void setDeadband(uint32_t fields, float absolute, float relative = 0);
+
+      // remove all the deadbands: all the reads are notified unless a max silence is set
+      void clearDeadbands();
+
+      /**
+       * @brief Maximum time in milliseconds without notifying a read when deadbands are set (heartbeat).
+       * Without deadband, reads are only notified every maxSilence milliseconds. 0 to disable (default).
+       */
+      void setMaxSilence(uint32_t maxSilence) { _maxSilence = maxSilence; }
+      uint32_t getMaxSilence() const { return _maxSilence; }
+
+      /**
+       * @return The fields which changed in the last notification (see setChangeCallback())
+       */
+      uint32_t getChangedFields() const { return _changed; }
+
+      /**
+       * @brief Attach rolling statistics updated at each successful read (see JSYStats), or nullptr to detach them.
+       * @note The statistics are also added to toJson() under "stats".
+       */
+      void setStats(JSYStats* stats) { _stats = stats; }
+      JSYStats* getStats() const { return _stats; }
+
+      /**
+       * @brief Attach 64-bit energy counters updated at each successful read (see JSYEnergy), or nullptr to detach them.
+       * @note The energies are also added to toJson() under "energy".
+       */
+      void setEnergy(JSYEnergy* energy) { _energy = energy; }
+      JSYEnergy* getEnergy() const { return _energy; }
+
+      /**
+       * @brief Persist the profile of the device (address, model, baud rate and mode) to start faster after a reboot.
+       * A begin() with BaudRate::UNKNOWN then checks the persisted profile with a single read of the model register,
+       * and only runs the baud rate detection and the model read if the device does not match it anymore.
+       * The profile is written when it changes: at begin(), and when the baud rate, the address or the mode is changed.
+       * Call it before begin().
+       * @param storage The storage (i.e. a JSYNVSStorage or a JSYFileStorage), or nullptr to disable
+       * @param key The key of the profile in the storage, different for each JSY sharing the storage
+       */
+      void setProfileStorage(JSYStorage* storage, const char* key = "jsy_profile") {
+        _profileStorage = storage;
+        _profileKey = key;
+      }
+
+      /**
+       * @return The profile of the destination device, known after begin()
+       */
+      Profile getProfile() const { return _profile; }
+
+      /**
+       * @brief Remove the persisted profile: the next begin() runs the detection
+       */
+      bool clearProfile();
+
+      /**
+       * @brief Negotiate the highest baud rate supported by the model at begin().
+       * After the detection, the device is switched to getMaxAvailableBaudRate(model), which is checked with MYCILA_JSY_BAUD_UPGRADE_CHECKS model reads.
+       * If more than MYCILA_JSY_BAUD_UPGRADE_MAX_ERRORS of them fail, the next lower baud rate is tried, down to the original one.
+       * The negotiation is recorded in the profile (see setProfileStorage()) so that the next begin() skips it.
+       * @note Must be called before begin(). Only for a single device on the serial port: the device is addressed with the address it answered with.
+       */
+      void setBaudRateUpgrade(bool enabled) { _baudRateUpgrade = enabled; }
+      bool isBaudRateUpgrade() const { return _baudRateUpgrade; }
+
+      /**
+       * @brief Adapt the baud rate to the quality of the line while reading.
+       * The reads of the destination device are tracked in a sliding window of MYCILA_JSY_TUNING_WINDOW reads.
+       * When more than MYCILA_JSY_TUNING_MAX_ERROR_RATE percent of them fail (timeouts, count and CRC errors), the device is switched to the next lower baud rate.
+       * After MYCILA_JSY_TUNING_QUIET_PERIOD_MS at a baud rate, and no error in the window, the next higher baud rate is probed, up to the baud rate of the device
+       * when the tuning started (at begin(), at setBaudRate() or when enabled). A probe failing within the quiet period doubles it (up to 16 times).
+       * Each change is notified with EVT_BAUD_RATE_CHANGE.
+       * @note Only for a single device on the serial port.
+       */
+      void setBaudRateTuning(bool enabled);
+      bool isBaudRateTuning() const { return _tuning; }
+
+      /**
+       * @brief Sample at a fixed rate in async mode: each read starts on a slot of an absolute schedule (like vTaskDelayUntil()), so the period does not drift with the duration of the reads.
+       * When a read ends after the next slot, the next read starts at once and the older slots are skipped (counted as overruns), they are never queued.
+       * The slots are met within a few microseconds: the end of the wait is spun for less than 1 ms.
+       * @param period The time in milliseconds between two slots, or 0 to wait the pause of begin() after each read (default)
+       * @param aligned true to put the slots on the multiples of the period of the system time (i.e. at .000, .100, .200 s with 100 ms), which should be set by SNTP
+       * @note The statistics of the sampling are available with getSchedule().
+       * @note The async task applies the change before its next slot.
+       */
+      void setPeriod(uint32_t period, bool aligned = false);
+      uint32_t getPeriod() const { return _period; }
+      bool isPeriodAligned() const { return _periodAligned; }
+
+      /**
+       * @brief Jitter, overruns and achieved rate of the fixed rate sampling, since begin() or setPeriod().
+       * This function does not lock: it returns a consistent copy published by the async task after each slot.
+       */
+      Schedule getSchedule() const;
+
+      /**
+       * @brief Decouple the reads from the decoding and the callbacks in async mode.
+       * The async task only reads the device and pushes the validated raw frames into a lock-free ring of MYCILA_JSY_PIPELINE_DEPTH frames.
+       * A second task decodes them and calls the callback, so a slow callback does not lower the sample rate.
+       * When the ring is full, new frames are dropped (see getPipelineDropCount()).
+       * @param enabled true to enable the pipeline
+       * @param core The core of the decoding task (default: 0)
+       * @param stackSize The stack size of the decoding task (default: MYCILA_JSY_ASYNC_STACK_SIZE)
+       * @note Must be called before begin(). Only used in async mode. With the pipeline, the data is updated by the decoding task.
+       */
+      void setPipeline(bool enabled, uint8_t core = 0, uint32_t stackSize = MYCILA_JSY_ASYNC_STACK_SIZE);
+      bool isPipelined() const { return _pipelineTaskHandle != NULL; }
+
+      /**
+       * @return The number of frames waiting to be decoded
+       */
+      size_t getPipelineDepth() const { return _pipelineHead.load(std::memory_order_acquire) - _pipelineTail.load(std::memory_order_acquire); }
+
+      /**
+       * @return The maximum number of frames which waited to be decoded
+       */
+      size_t getPipelineMaxDepth() const { return _pipelineMaxDepth.load(std::memory_order_relaxed); }
+
+      /**
+       * @return The number of frames pushed into the pipeline (including the failed reads)
+       */
+      uint32_t getPipelineFrameCount() const { return _pipelineHead.load(std::memory_order_relaxed); }
+
+      /**
+       * @return The number of frames dropped because the decoding task was too slow
+       */
+      uint32_t getPipelineDropCount() const { return _pipelineDropped.load(std::memory_order_relaxed); }
+
     private:
+      friend class JSYBus;
+      friend class JSYEnergy;
+
+      // raw energy counter of a read (see JSYEnergy): Wh = value * num / den
+      struct RawCounter {
+          uint8_t channel;
+          uint8_t index; // 0 for FIELD_ACTIVE_ENERGY to 6 for FIELD_APPARENT_ENERGY
+          uint16_t num;
+          uint16_t den;
+          uint32_t value;
+      };
+      // 7 energies for 3 phases and the aggregate
+      static constexpr size_t MAX_RAW_COUNTERS = 28;
+
       Callback _callback = nullptr;
+      // publishes the data read by this JSY before calling the user callback
+      Callback _publisher = [this](EventType eventType, const Data& data) { _notify(eventType, data); };
+      ChangeCallback _changeCallback = nullptr;
+      // deadbands of the fields, by bit index of the Field
+      uint32_t _deadbandFields = FIELD_NONE;
+      float _deadbandAbsolute[FIELD_COUNT] = {};
+      float _deadbandRelative[FIELD_COUNT] = {};
+      uint32_t _maxSilence = 0;
+      // last data notified to the callbacks, to evaluate the deadbands
+      Data _notified;
+      uint32_t _notifiedTime = 0;
+      uint32_t _changed = FIELD_NONE;
+      JSYStats* _stats = nullptr;
+      JSYEnergy* _energy = nullptr;
+      JSYStorage* _profileStorage = nullptr;
+      const char* _profileKey = nullptr;
+      Profile _profile;
+      // last profile read or written in the storage
+      Profile _persisted;
+      bool _baudRateUpgrade = false;
+      // baud rate auto-tuning: the last reads (1 bit per failed read) and the state of the probes, only used by the reading task
+      bool _tuning = false;
+      BaudRate _tuningTarget = BaudRate::UNKNOWN;
+      uint64_t _tuningResults = 0;
+      uint32_t _tuningCount = 0;
+      uint32_t _tuningSince = 0;
+      uint8_t _tuningBackoff = 0;
+      bool _tuningProbing = false;
+      // events waiting to be notified by the decoding task (1 bit per EventType)
+      std::atomic<uint32_t> _pendingEvents = {0};
       gpio_num_t _pinRX = GPIO_NUM_NC;
       gpio_num_t _pinTX = GPIO_NUM_NC;
       HardwareSerial* _serial = nullptr;
       std::mutex _mutex;
-      TaskHandle_t _taskHandle;
+      TaskHandle_t _taskHandle = NULL;
       uint32_t _time = 0;
       uint32_t _pause = MYCILA_JSY_ASYNC_READ_PAUSE_MS;
+      // async mode: fixed rate sampling, only updated by the async task (except by setPeriod(), which requests a new schedule)
+      std::atomic<uint32_t> _period = {0};
+      std::atomic<bool> _periodAligned = {false};
+      std::atomic<bool> _periodChanged = {false};
+      int64_t _deadline = 0; // time of the next slot (esp_timer_get_time()), 0 to start a new schedule
+      int64_t _lastSample = 0;
+      Schedule _schedule;
+      // copy of _schedule published for getSchedule(), odd _scheduleSeq while it is written
+      Schedule _schedulePublished;
+      std::atomic<uint32_t> _scheduleSeq = {0};
+      // async mode: connection state machine, only updated by the async task
+      ConnectionState _connectionState = ConnectionState::CONNECTED;
+      uint32_t _failures = 0; // consecutive failed reads
+      uint32_t _timeouts = 0; // consecutive read timeouts
+      uint32_t _rediscoveryBackoff = 0;
       uint8_t _destinationAddress = MYCILA_JSY_ADDRESS_BROADCAST;
       uint8_t _lastAddress = MYCILA_JSY_ADDRESS_UNKNOWN;
       BaudRate _baudRate = BaudRate::UNKNOWN;
@@ -586,7 +1206,55 @@ namespace Mycila {
       // biggest need is for JSY-MK-333: 102 registers of 2 bytes each + 5 bytes for the response: 209 bytes
       // we use 14 blocks of 16 bytes: 224 bytes
       uint8_t _buffer[224];
+      // register image of the last read, used when several windows are read (see setFields())
+      // biggest need is for JSY-MK-333: 102 registers of 2 bytes each
+      uint8_t _registers[204];
+      uint32_t _fields = FIELD_ALL;
       Data _data;
+      Turnaround _turnaround;
+      // double buffered snapshots of _data: the slot of a generation is generation % 2.
+      // Each slot has a sequence number, odd while the slot is written.
+      Snapshot _snapshots[2];
+      std::atomic<uint32_t> _snapshotSeq[2] = {};
+      std::atomic<uint32_t> _generation = {0};
+      // time in us (micros()) of the last response: a new request is not sent before the line is idle
+      uint32_t _idleFrom = 0;
+      uint32_t _idleUs = 0;
+      // time in us between the end of the last request and the first byte of its response, 0 if no response
+      uint32_t _lastTurnaround = 0;
+      // time in us (micros()) when the last request was about to be sent
+      uint32_t _sendFrom = 0;
+      Instrumentation _instrumentation;
+
+#ifdef MYCILA_JSY_UART_IDF
+      // state of the request / response exchange, driven by the UART driver events
+      enum class UartState {
+        IDLE,
+        WAITING,   // request sent, waiting for the first bytes of the response
+        RECEIVING, // response started, waiting for the remaining bytes or for the end of frame
+        COMPLETE,
+        TIMEOUT,
+        OVERFLOW,
+      };
+
+      uart_port_t _uart = UART_NUM_MAX;
+      QueueHandle_t _uartEvents = nullptr;
+      UartState _uartState = UartState::IDLE;
+      size_t _uartCount = 0;
+#endif
+
+      // contiguous ranges of registers to read to get the selected fields of a model
+      struct ReadPlan {
+          struct Window {
+              uint8_t start; // first register, relative to the start of the register map
+              uint8_t count; // number of registers
+          };
+          uint16_t model = MYCILA_JSY_MK_UNKNOWN;
+          uint32_t fields = FIELD_NONE;  // selected fields
+          uint32_t decoded = FIELD_NONE; // selected fields and the ones they are computed from
+          uint8_t count = 0;
+          Window windows[MYCILA_JSY_READ_WINDOWS_MAX];
+      } _readPlan;
 
     private:
       enum class ReadResult {
@@ -595,24 +1263,136 @@ namespace Mycila {
         READ_ERROR_COUNT,
         READ_ERROR_CRC,
         READ_ERROR_ADDRESS,
+        READ_ERROR_MODEL,
+      };
+
+      // checks a response while its bytes arrive: address, function code and byte count as soon as they are received,
+      // and the CRC-16/MODBUS state updated byte per byte so that the frame is verified when its last byte lands
+      struct Parser {
+          uint8_t address = MYCILA_JSY_ADDRESS_BROADCAST; // expected address, broadcast for any
+          uint8_t function = 0;                           // function code of the request
+          size_t expectedLen = 0;                         // updated when the device answers with a Modbus exception
+          size_t count = 0;
+          uint16_t crc = 0xFFFF;
+          ReadResult result = ReadResult::READ_SUCCESS; // error found so far
+          bool rejected = false;                        // the frame was abandoned before its end
+          bool exception = false;                       // Modbus exception response
+
+          void begin(uint8_t expectedAddress, uint8_t requestFunction, size_t len);
+          // feeds the next received bytes, returns false once the frame is complete or rejected
+          bool feed(const uint8_t* data, size_t len);
+          size_t remaining() const { return rejected ? 0 : expectedLen - count; }
       };
 
+      // result of a read waiting in the pipeline
+      struct Frame {
+          uint32_t time;
+          int64_t timestamp; // esp_timer_get_time() at the end of the response
+          ReadResult result;
+          uint8_t address;
+          uint16_t model;
+          uint32_t fields;
+          // biggest need is for JSY-MK-333: 102 registers of 2 bytes each
+          uint8_t registers[204];
+      };
+
+      // pipeline: single producer (async task) / single consumer (decoding task) ring.
+      // head and tail are free running counters: the slot of a counter is counter % MYCILA_JSY_PIPELINE_DEPTH
+      bool _pipeline = false;
+      uint8_t _pipelineCore = 0;
+      uint32_t _pipelineStackSize = MYCILA_JSY_ASYNC_STACK_SIZE;
+      TaskHandle_t _pipelineTaskHandle = NULL;
+      std::unique_ptr<Frame[]> _pipelineFrames;
+      std::atomic<uint32_t> _pipelineHead = {0};
+      std::atomic<uint32_t> _pipelineTail = {0};
+      std::atomic<uint32_t> _pipelineDropped = {0};
+      std::atomic<size_t> _pipelineMaxDepth = {0};
+      // set by setFields(): the decoding task clears the data before the next frame
+      std::atomic<bool> _pipelineClear = {false};
+
+      // response being received
+      Parser _parser;
+      // result of the last register read
+      ReadResult _readResult = ReadResult::READ_SUCCESS;
+
       bool _set(uint8_t address, uint8_t newAddress, BaudRate newBaudRate);
-      bool _read(uint8_t address, uint16_t model);
+      // switches the device to the highest baud rate passing the checks, at begin(). Returns false if the device is lost.
+      bool _upgradeBaudRate();
+      // tracks the result of a read of the destination device and switches the baud rate if needed
+      void _tuneBaudRate(ReadResult result);
+      // notifies an event which is not a read, from the decoding task if the pipeline is enabled
+      void _event(EventType eventType);
+      // caller must hold _mutex
+      uint16_t _readModel(uint8_t address);
+      bool _read(uint8_t address, uint16_t model) {
+        ReadResult result;
+        return _read(address, model, result);
+      }
+      // result is the one of this read, even if another read happened since
+      bool _read(uint8_t address, uint16_t model, ReadResult& result);
+      // reads a device into data, using and updating the given plan, response time statistics and energy counters (optional). Caller must hold _mutex.
+      bool _read(uint8_t address, uint16_t model, uint32_t fields, ReadPlan& plan, Turnaround& turnaround, Data& data, const Callback& callback, JSYEnergy* energy);
+      // reads the registers of the selected fields. On success, registers points to the register image. Caller must hold _mutex.
+      ReadResult _readRegisters(uint8_t address, uint16_t model, uint32_t fields, ReadPlan& plan, Turnaround& turnaround, const uint8_t*& registers);
+      // applies the result of a read to data (decoding or clearing it) and to the energy counters (optional), and calls the callback
+      bool _process(ReadResult result, uint8_t address, uint16_t model, uint32_t fields, const uint8_t* registers, uint32_t time, int64_t timestamp, Data& data, const Callback& callback, JSYEnergy* energy);
+      // reads the destination device and pushes the result into the pipeline. Caller must hold _mutex.
+      bool _readToPipeline(uint8_t address, uint16_t model);
       Mode _readMode(uint8_t address, uint16_t model);
+      // mode of a model, read from the device for JSY1031. Caller must hold _mutex.
+      Mode _queryMode(uint8_t address, uint16_t model);
       bool _setMode(uint8_t address, uint16_t model, Mode mode);
-
-      bool _canRead(uint8_t address, BaudRate baudRate);
-      ReadResult _timedRead(uint8_t expectedAddress, size_t expectedLen, BaudRate baudRate);
+      // publishes _data and _time as a new snapshot. Caller must hold _mutex, or be the decoding task when the pipeline is enabled.
+      void _publish();
+      // publishes, updates the statistics and calls the callbacks if the deadbands allow it
+      void _notify(EventType eventType, const Data& data);
+      // fields which moved beyond their deadband since the last notified data
+      uint32_t _changedFields(const Data& data) const;
+
+      bool _canRead(uint8_t address, BaudRate baudRate, uint32_t timeout);
+      // reads a response until expectedLen bytes are received or the line is silent (Modbus RTU 3.5 characters).
+      // timeout is the maximum time in ms to wait for the first byte.
+      ReadResult _timedRead(uint8_t expectedAddress, size_t expectedLen, BaudRate baudRate, uint32_t timeout);
+      // result of the response of count bytes checked by _parser
+      ReadResult _check(uint8_t expectedAddress, size_t count);
       void _send(uint8_t address, size_t len);
+      // backend specific I/O
+      void _write(size_t len);
+      // receives the response checked by _parser into _buffer, waiting timeout ms for the first byte then silenceUs between bytes
+      size_t _receive(uint32_t timeout, uint32_t silenceUs);
       size_t _drop();
       void _openSerial(BaudRate baudRate);
-      BaudRate _detectBauds(uint8_t address);
+      void _closeSerial();
+#ifdef MYCILA_JSY_UART_IDF
+      // handles a UART driver event and returns the new state of the exchange (non-blocking)
+      UartState _onUartEvent(const uart_event_t& event);
+#endif
+      BaudRate _detectBauds(uint8_t address, uint16_t model);
+      // opens the serial port at the i-th baud rate of the detection and checks if the device answers. Caller must hold _mutex.
+      bool _probeBauds(uint8_t address, uint16_t model, size_t i);
+      // reads the persisted profile if it can be the one of the device at this address and of this model
+      bool _loadProfile(uint8_t address, uint16_t model);
+      // writes _profile if it changed since the last time it was read or written
+      void _saveProfile();
 
       static uint16_t _crc16(const uint8_t* buffer, size_t len);
-      static uint8_t _register8(const uint8_t* buffer, uint16_t registerStart, uint16_t registerSize, uint16_t registerAddress, uint8_t index = 0);
-      static uint16_t _register16(const uint8_t* buffer, uint16_t registerStart, uint16_t registerSize, uint16_t registerAddress);
-      static uint32_t _register32(const uint8_t* buffer, uint16_t registerStart, uint16_t registerSize, uint16_t registerAddress);
+      static bool _planRead(ReadPlan& plan, uint16_t model, uint32_t fields);
+      // decodes the register data of a read response (without the Modbus header) into data, using the register map of the model
+      static void _decode(uint16_t model, const uint8_t* registers, Data& data, uint32_t fields = FIELD_ALL);
+      // the energy counters of the registers of a read, without conversion (up to MAX_RAW_COUNTERS)
+      static size_t _readCounters(uint16_t model, const uint8_t* registers, uint32_t fields, RawCounter* counters);
       static void _jsyTask(void* pvParameters);
+      // updates the connection state after a read of the async task and returns the time to wait before the next read
+      uint32_t _updateConnection(ReadResult result);
+      // detects the baud rate of a lost device, after the backoff
+      void _rediscover();
+      void _setConnectionState(ConnectionState state, EventType eventType);
+      // waits in the async task, returning early when the JSY is stopped
+      void _wait(uint32_t ms) const;
+      // applies setPeriod() and waits for the next slot of the fixed rate sampling (if any), skipping the slots already passed
+      void _waitSlot();
+      // publishes a copy of _schedule for getSchedule()
+      void _publishSchedule();
+      static void _pipelineTask(void* pvParameters);
   };
 } // namespace Mycila
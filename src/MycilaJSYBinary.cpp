@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYBinary.h"
+
+#define JSY_BINARY_KEY_FRAME 0x01
+#define JSY_BINARY_AGGREGATE 0x02
+
+// values above are not encoded (they would not be read from a device anyway)
+#define JSY_BINARY_MAX_VALUE 0xFFFFFFFFFFLL
+
+// writes a zigzag varint, returns the number of bytes written or 0 if the buffer is too small
+static size_t writeVarint(int64_t value, uint8_t* buffer, size_t size) {
+  uint64_t v = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  size_t len = 0;
+  do {
+    if (len == size)
+      return 0;
+    buffer[len++] = (v & 0x7F) | (v > 0x7F ? 0x80 : 0);
+    v >>= 7;
+  } while (v);
+  return len;
+}
+
+// reads a zigzag varint, returns the number of bytes read or 0 if the buffer is truncated
+static size_t readVarint(const uint8_t* buffer, size_t size, int64_t& value) {
+  uint64_t v = 0;
+  for (size_t len = 0; len < size && len < 10; len++) {
+    v |= static_cast<uint64_t>(buffer[len] & 0x7F) << (7 * len);
+    if (!(buffer[len] & 0x80)) {
+      value = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+      return len + 1;
+    }
+  }
+  return 0;
+}
+
+void Mycila::JSYBinary::_resolve(uint16_t model, float* resolutions) {
+  for (size_t i = 0; i < JSY::FIELD_COUNT; i++)
+    resolutions[i] = JSY::getResolution(model, 1UL << i);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Encoder
+///////////////////////////////////////////////////////////////////////////////
+
+size_t Mycila::JSYBinary::Encoder::encode(const JSY::Data& data, uint8_t* buffer, size_t size) {
+  if (data.model != _model)
+    _resolve(data.model, _resolutions);
+
+  const JSY::Metrics* metrics[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+
+  // fields holding a value and their fixed-point value
+  uint8_t flags = 0;
+  uint8_t channels = 0;
+  uint32_t fields[4] = {};
+  int64_t values[4][JSY::FIELD_COUNT];
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+      const JSY::FieldTarget& f = JSY::FIELD_TARGETS[i];
+      if (f.real) {
+        const float value = metrics[c]->*f.real;
+        if (!std::isfinite(value))
+          continue;
+        const double q = std::round(static_cast<double>(value) / _resolutions[i]);
+        if (std::abs(q) > JSY_BINARY_MAX_VALUE)
+          continue;
+        values[c][i] = static_cast<int64_t>(q);
+      } else {
+        values[c][i] = metrics[c]->*f.counter;
+        if (!values[c][i])
+          continue;
+      }
+      fields[c] |= 1UL << i;
+    }
+    if (fields[c])
+      channels |= 1 << c;
+  }
+
+  // single channel devices: the aggregate is the channel
+  if ((channels & (1 << JSY::AGGREGATE)) && (channels & 1) && data.aggregate == data._metrics[0]) {
+    channels &= ~(1 << JSY::AGGREGATE);
+    fields[JSY::AGGREGATE] = 0;
+    flags |= JSY_BINARY_AGGREGATE;
+  }
+
+  const bool key = !_valid ||
+                   _sinceKeyFrame + 1 >= _keyFrameInterval ||
+                   data.address != _address ||
+                   data.model != _model ||
+                   flags != _flags ||
+                   channels != _channels ||
+                   memcmp(fields, _fields, sizeof(fields)) != 0;
+
+  if (key)
+    flags |= JSY_BINARY_KEY_FRAME;
+
+  // header
+  size_t len = key ? 6 : 2;
+  if (size < len) {
+    _valid = false;
+    return 0;
+  }
+  buffer[0] = (VERSION << 4) | flags;
+  buffer[1] = _sequence + 1;
+  if (key) {
+    buffer[2] = data.address;
+    buffer[3] = data.model;
+    buffer[4] = data.model >> 8;
+    buffer[5] = channels;
+    for (size_t c = 0; c < 4; c++) {
+      if (!(channels & (1 << c)))
+        continue;
+      if (size < len + 3) {
+        _valid = false;
+        return 0;
+      }
+      buffer[len++] = fields[c];
+      buffer[len++] = fields[c] >> 8;
+      buffer[len++] = fields[c] >> 16;
+    }
+  }
+
+  // values
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+      if (!(fields[c] & (1UL << i)))
+        continue;
+      const size_t n = writeVarint(key ? values[c][i] : values[c][i] - _values[c][i], buffer + len, size - len);
+      if (!n) {
+        _valid = false;
+        return 0;
+      }
+      len += n;
+    }
+  }
+
+  _address = data.address;
+  _model = data.model;
+  _flags = flags & ~JSY_BINARY_KEY_FRAME;
+  _channels = channels;
+  memcpy(_fields, fields, sizeof(fields));
+  memcpy(_values, values, sizeof(values));
+  _sequence++;
+  _sinceKeyFrame = key ? 0 : _sinceKeyFrame + 1;
+  _valid = true;
+
+  return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoder
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYBinary::Decoder::decode(const uint8_t* buffer, size_t len, JSY::Data& data) {
+  if (len < 2 || (buffer[0] >> 4) != VERSION)
+    return false;
+
+  const uint8_t flags = buffer[0] & 0x0F;
+  const uint8_t sequence = buffer[1];
+  const bool key = flags & JSY_BINARY_KEY_FRAME;
+
+  // a delta frame needs the previous frame
+  if (!key && (!_valid || sequence != static_cast<uint8_t>(_sequence + 1)))
+    return false;
+
+  uint8_t address = _address;
+  uint16_t model = _model;
+  uint8_t channels = _channels;
+  uint32_t fields[4];
+  memcpy(fields, _fields, sizeof(fields));
+  size_t pos = 2;
+
+  if (key) {
+    if (len < 6)
+      return false;
+    address = buffer[2];
+    model = buffer[3] | (buffer[4] << 8);
+    channels = buffer[5] & 0x0F;
+    pos = 6;
+    for (size_t c = 0; c < 4; c++) {
+      fields[c] = 0;
+      if (!(channels & (1 << c)))
+        continue;
+      if (len < pos + 3)
+        return false;
+      fields[c] = (buffer[pos] | (buffer[pos + 1] << 8) | (static_cast<uint32_t>(buffer[pos + 2]) << 16)) & JSY::FIELD_ALL;
+      pos += 3;
+    }
+  }
+
+  int64_t values[4][JSY::FIELD_COUNT];
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+      if (!(fields[c] & (1UL << i)))
+        continue;
+      int64_t value;
+      const size_t n = readVarint(buffer + pos, len - pos, value);
+      if (!n)
+        return false;
+      pos += n;
+      values[c][i] = key ? value : _values[c][i] + value;
+    }
+  }
+
+  if (pos != len)
+    return false;
+
+  // frame is valid: update the state
+  if (model != _model || !_valid)
+    _resolve(model, _resolutions);
+  _address = address;
+  _model = model;
+  _channels = channels;
+  memcpy(_fields, fields, sizeof(fields));
+  memcpy(_values, values, sizeof(values));
+  _sequence = sequence;
+  _valid = true;
+
+  data.clear();
+  data.address = address;
+  data.model = model;
+  JSY::Metrics* metrics[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+      if (!(fields[c] & (1UL << i)))
+        continue;
+      const JSY::FieldTarget& f = JSY::FIELD_TARGETS[i];
+      if (f.real)
+        metrics[c]->*f.real = static_cast<float>(values[c][i]) * _resolutions[i];
+      else
+        metrics[c]->*f.counter = static_cast<uint32_t>(values[c][i]);
+    }
+  }
+  if (flags & JSY_BINARY_AGGREGATE)
+    data.aggregate = data._metrics[0];
+
+  return true;
+}
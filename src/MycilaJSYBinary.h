@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "MycilaJSY.h"
+
+namespace Mycila {
+  /**
+   * @brief Compact binary encoding of JSY::Data, i.e. to stream the data over UDP or to a serial link.
+   *
+   * Frame format (version 1), little endian:
+   * - 1 byte: version (high nibble) and flags (low nibble: bit 0 key frame, bit 1 aggregate is a copy of channel 1)
+   * - 1 byte: sequence number, incremented at each frame
+   * - key frames only: address (1 byte), model (2 bytes), channels mask (1 byte: bits 0-2 channel 1 / phase A to phase C, bit 3 aggregate),
+   *   then the FIELD_* mask of each channel in the mask (3 bytes each)
+   * - the values of the fields of each channel, as zigzag varints of fixed-point integers at the resolution of the model (see JSY::getResolution()).
+   *   Key frames hold the values, delta frames the difference with the values of the previous frame.
+   *
+   * A delta frame is only sent when the address, the model and the fields holding a value did not change since the previous frame.
+   * Measured values are decoded exactly. Values computed by the library (i.e. the aggregate of a JSY-MK-194) are rounded to the resolution.
+   * With the key frame interval of 10, a JSY-MK-333 frame is about 80 bytes on average (160 for a key frame), a JSY-MK-194 about 55 bytes and a JSY-MK-163 about 16 bytes.
+   */
+  class JSYBinary {
+    public:
+      static constexpr uint8_t VERSION = 1;
+      // maximum size of a frame
+      static constexpr size_t MAX_FRAME_SIZE = 2 + 4 + 4 * 3 + 4 * JSY::FIELD_COUNT * 10;
+
+      class Encoder {
+        public:
+          /**
+           * @brief Encode the data into a frame. No memory is allocated.
+           * @param data The data to encode
+           * @param buffer The buffer receiving the frame (MAX_FRAME_SIZE bytes is always enough)
+           * @param size The size of the buffer
+           * @return The size of the frame, or 0 if the buffer is too small (the next frame is then a key frame)
+           */
+          size_t encode(const JSY::Data& data, uint8_t* buffer, size_t size); // NOLINT
+
+          /**
+           * @brief Send a key frame every interval frames, so that a decoder can resume after a lost frame (default: 10).
+           * 1 to only send key frames (no delta encoding).
+           */
+          void setKeyFrameInterval(uint8_t interval) { _keyFrameInterval = interval ? interval : 1; }
+          uint8_t getKeyFrameInterval() const { return _keyFrameInterval; }
+
+          // send a key frame next
+          void reset() { _valid = false; }
+
+        private:
+          friend class JSYBinary;
+          uint8_t _address = MYCILA_JSY_ADDRESS_UNKNOWN;
+          uint16_t _model = MYCILA_JSY_MK_UNKNOWN;
+          uint8_t _flags = 0;
+          uint8_t _channels = 0;
+          uint32_t _fields[4] = {};
+          float _resolutions[JSY::FIELD_COUNT] = {};
+          int64_t _values[4][JSY::FIELD_COUNT] = {};
+          uint8_t _sequence = 0;
+          uint8_t _keyFrameInterval = 10;
+          uint8_t _sinceKeyFrame = 0;
+          bool _valid = false;
+      };
+
+      class Decoder {
+        public:
+          /**
+           * @brief Decode a frame. No memory is allocated.
+           * @param buffer The frame
+           * @param len The size of the frame
+           * @param data The data to fill. Fields not in the frame are cleared (NAN or 0).
+           * @return false if the frame is invalid, of another version, or a delta frame not following the last decoded frame (lost frame: wait for the next key frame)
+           */
+          bool decode(const uint8_t* buffer, size_t len, JSY::Data& data); // NOLINT
+
+          // only accept a key frame next
+          void reset() { _valid = false; }
+
+        private:
+          friend class JSYBinary;
+          uint8_t _address = MYCILA_JSY_ADDRESS_UNKNOWN;
+          uint16_t _model = MYCILA_JSY_MK_UNKNOWN;
+          uint8_t _channels = 0;
+          uint32_t _fields[4] = {};
+          float _resolutions[JSY::FIELD_COUNT] = {};
+          int64_t _values[4][JSY::FIELD_COUNT] = {};
+          uint8_t _sequence = 0;
+          bool _valid = false;
+      };
+
+    private:
+      static void _resolve(uint16_t model, float* resolutions);
+  };
+} // namespace Mycila
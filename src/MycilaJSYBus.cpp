@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYBus.h"
+#include "MycilaJSYEnergy.h"
+
+#ifdef MYCILA_LOGGER_SUPPORT
+  #include <MycilaLogger.h>
+extern Mycila::Logger logger;
+  #define LOGD(tag, format, ...) logger.debug(tag, format, ##__VA_ARGS__)
+  #define LOGI(tag, format, ...) logger.info(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) logger.warn(tag, format, ##__VA_ARGS__)
+  #define LOGE(tag, format, ...) logger.error(tag, format, ##__VA_ARGS__)
+#else
+  #define LOGD(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
+  #define LOGI(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+  #define LOGE(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
+#endif
+
+#define TAG "JSY"
+
+// weight of the last interval in the smoothed sample rate
+#define JSY_BUS_RATE_SMOOTHING 0.125f
+
+Mycila::JSYBus::JSYBus() {
+  _dispatch = [this](JSY::EventType eventType, const JSY::Data& data) {
+    if (_current && _current->callback)
+      _current->callback(eventType, data);
+    if (_callback)
+      _callback(eventType, data);
+  };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// registry
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYBus::add(const uint8_t address, uint16_t model, JSY::Callback callback) {
+  if (address == MYCILA_JSY_ADDRESS_BROADCAST)
+    return false;
+
+  // model detection is done outside the lock since it needs the serial port
+  if (model == MYCILA_JSY_MK_UNKNOWN && _jsy.isEnabled())
+    model = _jsy.readModel(address);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (_find(address)) {
+    LOGW(TAG, "JSY @ 0x%02X already registered", address);
+    return false;
+  }
+
+  for (Device& device : _devices) {
+    if (device.address == MYCILA_JSY_ADDRESS_UNKNOWN) {
+      device = Device();
+      device.address = address;
+      device.model = model;
+      device.callback = std::move(callback);
+      LOGI(TAG, "Register JSY-MK-%X @ 0x%02X", model, address);
+      return true;
+    }
+  }
+
+  LOGE(TAG, "Unable to register JSY @ 0x%02X: bus full (%d devices)", address, MYCILA_JSY_BUS_MAX_DEVICES);
+  return false;
+}
+
+bool Mycila::JSYBus::remove(const uint8_t address) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Device* device = _find(address);
+  if (!device)
+    return false;
+  *device = Device();
+  return true;
+}
+
+size_t Mycila::JSYBus::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t count = 0;
+  for (const Device& device : _devices)
+    if (device.address != MYCILA_JSY_ADDRESS_UNKNOWN)
+      count++;
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// begin / end
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSYBus::begin(HardwareSerial& serial,
+                           const int8_t rxPin,
+                           const int8_t txPin,
+                           const JSY::BaudRate baudRate,
+                           const bool async,
+                           const uint8_t core,
+                           const uint32_t stackSize,
+                           const uint32_t pause) {
+  if (_jsy.isEnabled())
+    return;
+
+  // the first registered device is used to detect or check the baud rate
+  Device* probe = nullptr;
+  uint8_t probeAddress = MYCILA_JSY_ADDRESS_BROADCAST;
+  uint16_t probeModel = MYCILA_JSY_MK_UNKNOWN;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Device& device : _devices) {
+      if (device.address != MYCILA_JSY_ADDRESS_UNKNOWN) {
+        probe = &device;
+        probeAddress = device.address;
+        probeModel = device.model;
+        break;
+      }
+    }
+  }
+
+  _jsy.begin(serial, rxPin, txPin, baudRate, probeAddress, probeModel);
+
+  if (!_jsy.isEnabled())
+    return;
+
+  // the model of the first device was read by begin()
+  if (probe && probeModel == MYCILA_JSY_MK_UNKNOWN) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    probe->model = _jsy.getModel();
+  }
+
+  // read the models not given at registration: only once per device
+  for (Device& device : _devices) {
+    if (device.address != MYCILA_JSY_ADDRESS_UNKNOWN && device.model == MYCILA_JSY_MK_UNKNOWN) {
+      uint16_t model = _jsy.readModel(device.address);
+      std::lock_guard<std::mutex> lock(_mutex);
+      device.model = model;
+      if (model == MYCILA_JSY_MK_UNKNOWN)
+        LOGW(TAG, "Unable to read model of JSY @ 0x%02X", device.address);
+    }
+  }
+
+  _pause = pause;
+
+  assert(!async || xTaskCreateUniversal(_busTask, "jsyBusTask", stackSize, this, MYCILA_JSY_ASYNC_PRIORITY, &_taskHandle, core) == pdPASS);
+}
+
+void Mycila::JSYBus::end() {
+  if (_jsy.isEnabled()) {
+    _jsy.end();
+    while (_taskHandle != NULL) {
+      // JSY takes at least 40-160 ms to finish a read
+      delay(50);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Device& device : _devices)
+      if (device.energy)
+        device.energy->flush();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYBus::read() {
+  if (!_jsy.isEnabled())
+    return false;
+
+  bool success = true;
+  for (Device& device : _devices) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (device.address != MYCILA_JSY_ADDRESS_UNKNOWN)
+      success &= _read(device);
+  }
+  return success;
+}
+
+bool Mycila::JSYBus::read(const uint8_t address) {
+  if (!_jsy.isEnabled())
+    return false;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  Device* device = _find(address);
+  return device && _read(*device);
+}
+
+// must be called with _mutex held
+bool Mycila::JSYBus::_read(Device& device) {
+  std::lock_guard<std::mutex> lock(_jsy._mutex);
+
+  // the bus might have been closed while waiting for the lock
+  if (!_jsy._enabled)
+    return false;
+
+  // model not known yet: this cycle's transaction is used to read it
+  if (device.model == MYCILA_JSY_MK_UNKNOWN) {
+    device.model = _jsy._readModel(device.address);
+    if (device.model == MYCILA_JSY_MK_UNKNOWN) {
+      device.errors++;
+      return false;
+    }
+  }
+
+  _current = &device;
+  bool success = _jsy._read(device.address, device.model, device.fields, device.plan, device.turnaround, device.data, _dispatch, device.energy);
+  _current = nullptr;
+
+  if (!success) {
+    device.errors++;
+    return false;
+  }
+
+  device.reads++;
+  const uint32_t now = micros();
+  if (device.reads > 1) {
+    const float interval = now - device.lastRead;
+    device.interval = device.interval == 0 ? interval : device.interval + JSY_BUS_RATE_SMOOTHING * (interval - device.interval);
+  }
+  device.lastRead = now;
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// accessors
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYBus::getData(const uint8_t address, JSY::Data& data) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  if (!device)
+    return false;
+  data = device->data;
+  return true;
+}
+
+uint16_t Mycila::JSYBus::getModel(const uint8_t address) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  return device ? device->model : MYCILA_JSY_MK_UNKNOWN;
+}
+
+uint32_t Mycila::JSYBus::getReadCount(const uint8_t address) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  return device ? device->reads : 0;
+}
+
+uint32_t Mycila::JSYBus::getErrorCount(const uint8_t address) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  return device ? device->errors : 0;
+}
+
+float Mycila::JSYBus::getSampleRate(const uint8_t address) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  return device && device->interval > 0 ? 1000000.0f / device->interval : 0;
+}
+
+Mycila::JSY::Turnaround Mycila::JSYBus::getTurnaround(const uint8_t address) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Device* device = _find(address);
+  return device ? device->turnaround : JSY::Turnaround();
+}
+
+bool Mycila::JSYBus::setFields(const uint8_t address, const uint32_t fields) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Device* device = _find(address);
+  if (!device)
+    return false;
+  device->fields = fields & JSY::FIELD_ALL;
+  device->data.clear();
+  return true;
+}
+
+bool Mycila::JSYBus::setEnergy(const uint8_t address, JSYEnergy* energy) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Device* device = _find(address);
+  if (!device)
+    return false;
+  device->energy = energy;
+  return true;
+}
+
+bool Mycila::JSYBus::setCallback(const uint8_t address, JSY::Callback callback) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Device* device = _find(address);
+  if (!device)
+    return false;
+  device->callback = std::move(callback);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toJson
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef MYCILA_JSON_SUPPORT
+void Mycila::JSYBus::toJson(const JsonObject& root) const {
+  root["enabled"] = _jsy.isEnabled();
+  root["speed"] = _jsy.getBaudRate();
+  JsonArray devices = root["devices"].to<JsonArray>();
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const Device& device : _devices) {
+    if (device.address == MYCILA_JSY_ADDRESS_UNKNOWN)
+      continue;
+    JsonObject json = devices.add<JsonObject>();
+    device.data.toJson(json);
+    json["address"] = device.address;
+    json["model"] = device.model;
+    json["model_name"] = JSY::getModelName(device.model);
+    json["reads"] = device.reads;
+    json["errors"] = device.errors;
+    json["sample_rate"] = device.interval > 0 ? 1000000.0f / device.interval : 0;
+  }
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// private
+///////////////////////////////////////////////////////////////////////////////
+
+Mycila::JSYBus::Device* Mycila::JSYBus::_find(const uint8_t address) {
+  for (Device& device : _devices)
+    if (device.address == address)
+      return &device;
+  return nullptr;
+}
+
+const Mycila::JSYBus::Device* Mycila::JSYBus::_find(const uint8_t address) const {
+  for (const Device& device : _devices)
+    if (device.address == address)
+      return &device;
+  return nullptr;
+}
+
+void Mycila::JSYBus::_busTask(void* params) {
+  JSYBus* bus = reinterpret_cast<JSYBus*>(params);
+  while (bus->_jsy.isEnabled()) {
+    if (bus->read()) {
+      if (bus->_pause > 0) {
+        delay(bus->_pause);
+      } else {
+        yield();
+      }
+    } else if (bus->_pause > 0) {
+      delay(bus->_pause);
+    } else {
+      delay(10);
+    }
+  }
+  bus->_taskHandle = NULL;
+  vTaskDelete(NULL);
+}
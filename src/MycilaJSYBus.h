@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "MycilaJSY.h"
+
+// Maximum number of devices which can be registered on a bus
+#ifndef MYCILA_JSY_BUS_MAX_DEVICES
+  #define MYCILA_JSY_BUS_MAX_DEVICES 8
+#endif
+
+namespace Mycila {
+  /**
+   * @brief Polls several JSY devices sharing the same serial port (i.e. a RS485 segment).
+   * Each device is registered with its address and model, which is read only once if not given.
+   * A read cycle issues one request per device (with all fields selected) and each device has its own Data and callback.
+   */
+  class JSYBus {
+    public:
+      JSYBus();
+      ~JSYBus() { end(); }
+
+      /**
+       * @brief Register a device on the bus. Can be called before or after begin().
+       * @param address The address of the device (1-255)
+       * @param model The model of the device. If set to MYCILA_JSY_MK_UNKNOWN, the model is read once (at begin() or now if the bus is started)
+       * @param callback The callback called for each read of this device (optional)
+       * @return true if the device was added
+       * @note The first registered device is used to detect the baud rate in begin().
+       */
+      bool add(uint8_t address, uint16_t model = MYCILA_JSY_MK_UNKNOWN, JSY::Callback callback = nullptr);
+
+      /**
+       * @brief Unregister a device from the bus.
+       * @param address The address of the device (1-255)
+       * @return true if the device was removed
+       */
+      bool remove(uint8_t address);
+
+      /**
+       * @return The number of registered devices
+       */
+      size_t size() const;
+
+      /**
+       * @brief Open the serial port shared by all the devices.
+       * @param serial The serial port to use
+       * @param rxPin RX board pin connected to the TX of the devices
+       * @param txPin TX board pin connected to the RX of the devices
+       * @param baudRate The baud rate of the devices. If set to BaudRate::UNKNOWN, the baud rate is detected with the first registered device
+       * @param async If true, the devices will be read in a separate task (default: false)
+       * @param core The core to use for the async task (default: MYCILA_JSY_ASYNC_CORE)
+       * @param stackSize The stack size of the async task (default: MYCILA_JSY_ASYNC_STACK_SIZE)
+       * @param pause Time in milliseconds to wait between each read cycle in async mode (default: MYCILA_JSY_ASYNC_READ_PAUSE_MS)
+       * @note All the devices must use the same baud rate.
+       */
+      void begin(HardwareSerial& serial, // NOLINT
+                 int8_t rxPin,
+                 int8_t txPin,
+                 JSY::BaudRate baudRate = JSY::BaudRate::UNKNOWN,
+                 bool async = false,
+                 uint8_t core = MYCILA_JSY_ASYNC_CORE,
+                 uint32_t stackSize = MYCILA_JSY_ASYNC_STACK_SIZE,
+                 uint32_t pause = MYCILA_JSY_ASYNC_READ_PAUSE_MS);
+
+      /**
+       * @brief Ends the bus communication. Registered devices are kept.
+       */
+      void end();
+
+      bool isEnabled() const { return _jsy.isEnabled(); }
+      JSY::BaudRate getBaudRate() const { return _jsy.getBaudRate(); }
+
+      /**
+       * @brief Read all the registered devices once (one request per device).
+       * @return true if all the devices were read successfully
+       * @note This function is blocking until all the devices are read or have timed out.
+       */
+      bool read();
+
+      /**
+       * @brief Read a registered device.
+       * @param address The address of the device (1-255)
+       * @return true if the read was successful
+       * @note This function is blocking until the data is read or the timeout is reached.
+       */
+      bool read(uint8_t address);
+
+      /**
+       * @brief Copy the last data read from a device.
+       * @param address The address of the device (1-255)
+       * @param data The data to fill
+       * @return true if the device is registered
+       */
+      bool getData(uint8_t address, JSY::Data& data) const;
+
+      /**
+       * @return The model of a registered device or MYCILA_JSY_MK_UNKNOWN
+       */
+      uint16_t getModel(uint8_t address) const;
+
+      /**
+       * @return The number of successful reads of a registered device
+       */
+      uint32_t getReadCount(uint8_t address) const;
+
+      /**
+       * @return The number of failed reads (timeout or error) of a registered device
+       */
+      uint32_t getErrorCount(uint8_t address) const;
+
+      /**
+       * @return The achieved sample rate of a registered device in reads per second, smoothed over the last reads
+       */
+      float getSampleRate(uint8_t address) const;
+
+      /**
+       * @return The response time statistics of a registered device (see JSY::Turnaround)
+       */
+      JSY::Turnaround getTurnaround(uint8_t address) const;
+
+      /**
+       * @brief Select the fields to read for a device (see JSY::setFields()).
+       * @return true if the device is registered
+       */
+      bool setFields(uint8_t address, uint32_t fields);
+
+      /**
+       * @brief Set the callback of a device.
+       * @return true if the device is registered
+       * @note Callbacks are called while the bus is locked: use the given data and do not call other methods of the bus.
+       */
+      bool setCallback(uint8_t address, JSY::Callback callback);
+
+      /**
+       * @brief Attach 64-bit energy counters to a device, updated at each of its successful reads (see JSYEnergy), or nullptr to detach them.
+       * @return true if the device is registered
+       * @note The energy is flushed by end(). It must live as long as it is attached.
+       */
+      bool setEnergy(uint8_t address, JSYEnergy* energy);
+
+      /**
+       * @brief Set a callback called for the reads of all the devices. Data::address tells which device was read.
+       */
+      void setCallback(JSY::Callback callback) { _callback = std::move(callback); }
+
+      /**
+       * @brief Access to the underlying JSY driving the serial port, i.e. to reset the energy or change the baud rate of a device.
+       * @note Changing the address of a device with this object does not update the bus registry.
+       * @note Its hooks (setCallback(), setEnergy(), setStats(), getSnapshot(), getTime()...) only apply to its own read() calls, not to the reads of the bus:
+       * use the callbacks and setEnergy() of the bus for the devices.
+       */
+      JSY& getJSY() { return _jsy; }
+
+#ifdef MYCILA_JSON_SUPPORT
+      void toJson(const JsonObject& root) const;
+#endif
+
+    private:
+      struct Device {
+          uint8_t address = MYCILA_JSY_ADDRESS_UNKNOWN; // MYCILA_JSY_ADDRESS_UNKNOWN: free slot
+          uint16_t model = MYCILA_JSY_MK_UNKNOWN;
+          uint32_t fields = JSY::FIELD_ALL;
+          JSY::ReadPlan plan;
+          JSY::Turnaround turnaround;
+          JSY::Data data;
+          JSY::Callback callback = nullptr;
+          JSYEnergy* energy = nullptr;
+          uint32_t reads = 0;
+          uint32_t errors = 0;
+          uint32_t lastRead = 0; // micros() of the last successful read
+          float interval = 0;    // smoothed time in us between 2 successful reads
+      };
+
+      JSY _jsy;
+      JSY::Callback _callback = nullptr;
+      // dispatches the events of the device being read to its callback and to the bus callback
+      JSY::Callback _dispatch = nullptr;
+      Device* _current = nullptr;
+      Device _devices[MYCILA_JSY_BUS_MAX_DEVICES];
+      mutable std::mutex _mutex;
+      TaskHandle_t _taskHandle = NULL;
+      uint32_t _pause = MYCILA_JSY_ASYNC_READ_PAUSE_MS;
+
+      Device* _find(uint8_t address);
+      const Device* _find(uint8_t address) const;
+      bool _read(Device& device);
+      static void _busTask(void* pvParameters);
+  };
+} // namespace Mycila
@@ -66,3 +66,75 @@ void Mycila::JSY::Data::toJson(const JsonObject& root) const {
   }
 }
 #endif
+
+void Mycila::JSY::Data::toJson(JSYJsonWriter& writer) const {
+  writer.key(MYCILA_JSY_JSON_KEY("address"));
+  writer.value(static_cast<uint32_t>(address));
+  writer.key(MYCILA_JSY_JSON_KEY("model"));
+  writer.value(static_cast<uint32_t>(model));
+  writer.key(MYCILA_JSY_JSON_KEY("model_name"));
+  writer.value(Mycila::JSY::getModelName(model));
+
+  switch (model) {
+    case MYCILA_JSY_MK_1031:
+    case MYCILA_JSY_MK_163:
+    case MYCILA_JSY_MK_227:
+    case MYCILA_JSY_MK_229:
+      _metrics[0].toJson(writer);
+      break;
+
+    case MYCILA_JSY_MK_193:
+    case MYCILA_JSY_MK_194:
+      writer.key(MYCILA_JSY_JSON_KEY("aggregate"));
+      writer.beginObject();
+      aggregate.toJson(writer);
+      writer.endObject();
+      writer.key(MYCILA_JSY_JSON_KEY("channel1"));
+      writer.beginObject();
+      _metrics[0].toJson(writer);
+      writer.endObject();
+      writer.key(MYCILA_JSY_JSON_KEY("channel2"));
+      writer.beginObject();
+      _metrics[1].toJson(writer);
+      writer.endObject();
+      break;
+
+    case MYCILA_JSY_MK_333:
+      writer.key(MYCILA_JSY_JSON_KEY("aggregate"));
+      writer.beginObject();
+      aggregate.toJson(writer);
+      writer.endObject();
+      writer.key(MYCILA_JSY_JSON_KEY("phaseA"));
+      writer.beginObject();
+      _metrics[0].toJson(writer);
+      writer.endObject();
+      writer.key(MYCILA_JSY_JSON_KEY("phaseB"));
+      writer.beginObject();
+      _metrics[1].toJson(writer);
+      writer.endObject();
+      writer.key(MYCILA_JSY_JSON_KEY("phaseC"));
+      writer.beginObject();
+      _metrics[2].toJson(writer);
+      writer.endObject();
+      break;
+
+    default:
+      break;
+  }
+}
+
+size_t Mycila::JSY::Data::toJson(char* buffer, size_t size) const {
+  JSYJsonWriter writer(buffer, size);
+  writer.beginObject();
+  toJson(writer);
+  writer.endObject();
+  return writer.end();
+}
+
+size_t Mycila::JSY::Data::toJson(Print& out) const {
+  JSYJsonWriter writer(out);
+  writer.beginObject();
+  toJson(writer);
+  writer.endObject();
+  return writer.end();
+}
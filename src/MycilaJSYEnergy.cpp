@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYEnergy.h"
+
+#include <stdio.h>
+
+#ifndef ARDUINO_NATIVE
+  #include <esp_timer.h>
+#endif
+
+#ifdef MYCILA_LOGGER_SUPPORT
+  #include <MycilaLogger.h>
+extern Mycila::Logger logger;
+  #define LOGD(tag, format, ...) logger.debug(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) logger.warn(tag, format, ##__VA_ARGS__)
+#else
+  #define LOGD(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+#endif
+
+#define TAG "JSY"
+
+// 1 mWh = 3.6 J
+static constexpr uint64_t JSY_ENERGY_WUS_PER_MWH = 3600000;
+
+// Record of the persisted totals, little endian:
+// [version][present totals mask][model (2)][sequence (4)] 8 x [total (8)][last register value (4)][num (2)][den (2)] [crc16 (2)]
+// The 8 totals are the active energy imported and returned of the channels 1 to 3 and the aggregate.
+#define JSY_ENERGY_RECORD_VERSION 1
+#define JSY_ENERGY_RECORD_TOTALS  8
+#define JSY_ENERGY_RECORD_HEADER  8
+#define JSY_ENERGY_RECORD_ENTRY   16
+#define JSY_ENERGY_RECORD_SIZE    (JSY_ENERGY_RECORD_HEADER + JSY_ENERGY_RECORD_TOTALS * JSY_ENERGY_RECORD_ENTRY + 2)
+
+// key of an energy field in JSY::FIELD_TARGETS
+static const char* counterKey(size_t index) {
+  return Mycila::JSY::FIELD_TARGETS[__builtin_ctz(Mycila::JSY::FIELD_ACTIVE_ENERGY) + index].key;
+}
+
+static void writeLE(uint8_t* buffer, uint64_t value, size_t len) {
+  for (size_t i = 0; i < len; i++)
+    buffer[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint64_t readLE(const uint8_t* buffer, size_t len) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < len; i++)
+    value |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+  return value;
+}
+
+// index of an energy field in the counters, or -1
+static int counterIndex(uint32_t field) {
+  for (int i = 0; i < 7; i++)
+    if (field == Mycila::JSY::FIELD_ACTIVE_ENERGY << i)
+      return i;
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// update
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSYEnergy::_add(const uint16_t model, const uint8_t* registers, const uint32_t fields, const JSY::Data& data, const int64_t timestamp) {
+  JSY::RawCounter raws[JSY::MAX_RAW_COUNTERS];
+  const size_t count = JSY::_readCounters(model, registers, fields, raws);
+  const JSY::Metrics* metrics[] = {&data.channel(0), &data.channel(1), &data.phase(2), &data.aggregate};
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (model != _model) {
+    _model = model;
+    _clear();
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const JSY::RawCounter& raw = raws[i];
+    Counter& counter = _counters[raw.channel][raw.index];
+    if (counter.num == 0) {
+      // the total starts at the value of the device
+      counter.raw = raw.value;
+      counter.total = raw.value;
+      counter.last = raw.value;
+      counter.num = raw.num;
+      counter.den = raw.den;
+      continue;
+    }
+    // step of the register since the previous read, or since the restored record
+    uint32_t step;
+    bool reset = false;
+    if (raw.value >= counter.last) {
+      step = raw.value - counter.last;
+    } else if (static_cast<uint32_t>(raw.value - counter.last) < 0x80000000UL) {
+      // the register wrapped around: the small step forward is carried to the upper bits
+      step = raw.value - counter.last;
+      _wraps++;
+    } else {
+      // the counter was reset
+      step = raw.value;
+      reset = true;
+    }
+    counter.raw = reset ? raw.value : counter.raw + step;
+    counter.total += step;
+    counter.last = raw.value;
+    if (step && (raw.index == 1 || raw.index == 2)) {
+      _dirty = true;
+      _unflushed += static_cast<float>(step) * raw.num / raw.den;
+    }
+  }
+
+  // trapezoidal rule: each half of the interval is counted with the power at its end, by its sign
+  const int64_t elapsed = timestamp - _time;
+  const bool integrate = _time != 0 && elapsed > 0 && elapsed <= static_cast<int64_t>(MYCILA_JSY_ENERGY_MAX_GAP_MS) * 1000;
+  const float half = elapsed * 0.5f;
+  for (size_t c = 0; c < 4; c++) {
+    Integral& integral = _integrals[c];
+    const float power = metrics[c]->activePower;
+    if (integrate && !std::isnan(power) && !std::isnan(integral.power)) {
+      for (const float p : {integral.power, power}) {
+        const uint64_t energy = static_cast<uint64_t>(std::abs(p) * half + 0.5f);
+        if (p >= 0)
+          integral.imported += energy;
+        else
+          integral.returned += energy;
+      }
+    }
+    integral.power = power;
+  }
+  if (integrate)
+    _integratedTime += elapsed;
+  _time = timestamp;
+
+  // write-behind
+  if (_storage && _dirty && (timestamp - _flushTime >= static_cast<int64_t>(MYCILA_JSY_ENERGY_FLUSH_INTERVAL_MS) * 1000 || _unflushed >= MYCILA_JSY_ENERGY_FLUSH_DELTA_WH))
+    _flush();
+}
+
+void Mycila::JSYEnergy::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _clear();
+  if (_storage)
+    _flush();
+}
+
+void Mycila::JSYEnergy::_clear() {
+  for (auto& channel : _counters)
+    for (Counter& counter : channel)
+      counter = Counter();
+  for (Integral& integral : _integrals)
+    integral = Integral();
+  _time = 0;
+  _integratedTime = 0;
+  _wraps = 0;
+  _dirty = true;
+  _unflushed = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// persistence
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYEnergy::setStorage(JSYStorage* storage, const char* key) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _storage = storage;
+  _key = key;
+  _sequence = 0;
+  _dirty = false;
+  _unflushed = 0;
+  _flushTime = esp_timer_get_time();
+  return storage && _restore();
+}
+
+bool Mycila::JSYEnergy::flush() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return !_storage || !_dirty || _flush();
+}
+
+bool Mycila::JSYEnergy::_flush() {
+  uint8_t record[JSY_ENERGY_RECORD_SIZE] = {0};
+  record[0] = JSY_ENERGY_RECORD_VERSION;
+  writeLE(record + 2, _model, 2);
+  writeLE(record + 4, _sequence + 1, 4);
+  for (size_t t = 0; t < JSY_ENERGY_RECORD_TOTALS; t++) {
+    const Counter& counter = _counters[t / 2][1 + t % 2];
+    if (!counter.num)
+      continue;
+    uint8_t* entry = record + JSY_ENERGY_RECORD_HEADER + t * JSY_ENERGY_RECORD_ENTRY;
+    record[1] |= 1 << t;
+    writeLE(entry, counter.total, 8);
+    writeLE(entry + 8, counter.last, 4);
+    writeLE(entry + 12, counter.num, 2);
+    writeLE(entry + 14, counter.den, 2);
+  }
+  const uint16_t crc = JSY::crc16(record, JSY_ENERGY_RECORD_SIZE - 2);
+  writeLE(record + JSY_ENERGY_RECORD_SIZE - 2, crc, 2);
+
+  // the next slot: the previous records stay valid if this write is interrupted
+  char key[16];
+  snprintf(key, sizeof(key), "%s%" PRIu32, _key, (_sequence + 1) % MYCILA_JSY_ENERGY_SLOTS);
+
+  // retried at the next interval on failure
+  _flushTime = _time ? _time : esp_timer_get_time();
+  if (!_storage->write(key, record, sizeof(record)))
+    return false;
+
+  LOGD(TAG, "JSY energy totals saved in %s", key);
+  _sequence++;
+  _writes++;
+  _dirty = false;
+  _unflushed = 0;
+  return true;
+}
+
+bool Mycila::JSYEnergy::_restore() {
+  uint8_t record[JSY_ENERGY_RECORD_SIZE];
+  uint8_t best[JSY_ENERGY_RECORD_SIZE];
+  bool found = false;
+  uint32_t sequence = 0;
+
+  for (uint32_t slot = 0; slot < MYCILA_JSY_ENERGY_SLOTS; slot++) {
+    char key[16];
+    snprintf(key, sizeof(key), "%s%" PRIu32, _key, slot);
+    if (_storage->read(key, record, sizeof(record)) != sizeof(record))
+      continue;
+    if (record[0] != JSY_ENERGY_RECORD_VERSION || readLE(record + JSY_ENERGY_RECORD_SIZE - 2, 2) != JSY::crc16(record, JSY_ENERGY_RECORD_SIZE - 2)) {
+      LOGW(TAG, "Invalid JSY energy totals %s", key);
+      continue;
+    }
+    // the latest record, the sequence number can wrap around
+    const uint32_t s = readLE(record + 4, 4);
+    if (!found || static_cast<int32_t>(s - sequence) > 0) {
+      found = true;
+      sequence = s;
+      memcpy(best, record, sizeof(best));
+    }
+  }
+
+  if (!found)
+    return false;
+
+  _clear();
+  _model = readLE(best + 2, 2);
+  for (size_t t = 0; t < JSY_ENERGY_RECORD_TOTALS; t++) {
+    if (!(best[1] & (1 << t)))
+      continue;
+    const uint8_t* entry = best + JSY_ENERGY_RECORD_HEADER + t * JSY_ENERGY_RECORD_ENTRY;
+    const uint16_t den = readLE(entry + 14, 2);
+    if (!den)
+      continue;
+    Counter& counter = _counters[t / 2][1 + t % 2];
+    counter.total = readLE(entry, 8);
+    counter.last = readLE(entry + 8, 4);
+    // the device counter until the first read
+    counter.raw = counter.last;
+    counter.num = readLE(entry + 12, 2);
+    counter.den = den;
+  }
+  _sequence = sequence;
+  _dirty = false;
+  LOGD(TAG, "JSY energy totals restored from record %" PRIu32, sequence);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+///////////////////////////////////////////////////////////////////////////////
+
+// exact value of raw * num / den Wh in mWh, without overflow
+uint64_t Mycila::JSYEnergy::_mWh(const uint64_t raw, const Counter& counter) {
+  return (raw / counter.den) * counter.num * 1000 + (raw % counter.den) * counter.num * 1000 / counter.den;
+}
+
+bool Mycila::JSYEnergy::hasCounter(const uint32_t field, const uint8_t channel) const {
+  const int index = counterIndex(field);
+  if (index < 0 || channel > AGGREGATE)
+    return false;
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _has(index, channel);
+}
+
+uint64_t Mycila::JSYEnergy::getCounter(const uint32_t field, const uint8_t channel) const {
+  const int index = counterIndex(field);
+  if (index < 0 || channel > AGGREGATE)
+    return 0;
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _get(index, channel);
+}
+
+bool Mycila::JSYEnergy::_has(const size_t index, const uint8_t channel) const {
+  if (_counters[channel][index].num)
+    return true;
+  // the aggregate is the sum of the channels when the device does not provide it
+  if (channel == AGGREGATE)
+    for (uint8_t c = 0; c < AGGREGATE; c++)
+      if (_counters[c][index].num)
+        return true;
+  // the active energy of the JSY-MK-163, JSY-MK-193 and JSY-MK-194 is the sum of the imported and returned energies
+  return index == 0 && _has(1, channel);
+}
+
+uint64_t Mycila::JSYEnergy::_get(const size_t index, const uint8_t channel) const {
+  if (_counters[channel][index].num)
+    return _mWh(_counters[channel][index].raw, _counters[channel][index]);
+  if (channel == AGGREGATE) {
+    uint64_t sum = 0;
+    bool found = false;
+    for (uint8_t c = 0; c < AGGREGATE; c++) {
+      if (_counters[c][index].num) {
+        sum += _mWh(_counters[c][index].raw, _counters[c][index]);
+        found = true;
+      }
+    }
+    if (found)
+      return sum;
+  }
+  return index == 0 ? _get(1, channel) + _get(2, channel) : 0;
+}
+
+uint64_t Mycila::JSYEnergy::getTotal(const uint32_t field, const uint8_t channel) const {
+  if ((field != JSY::FIELD_ACTIVE_ENERGY_IMPORTED && field != JSY::FIELD_ACTIVE_ENERGY_RETURNED) || channel > AGGREGATE)
+    return 0;
+  const int index = counterIndex(field);
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_counters[channel][index].num)
+    return _mWh(_counters[channel][index].total, _counters[channel][index]);
+  // the aggregate is the sum of the channels when the device does not provide it
+  uint64_t sum = 0;
+  if (channel == AGGREGATE)
+    for (uint8_t c = 0; c < AGGREGATE; c++)
+      if (_counters[c][index].num)
+        sum += _mWh(_counters[c][index].total, _counters[c][index]);
+  return sum;
+}
+
+uint64_t Mycila::JSYEnergy::getIntegratedImported(const uint8_t channel) const {
+  if (channel > AGGREGATE)
+    return 0;
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _integrals[channel].imported / JSY_ENERGY_WUS_PER_MWH;
+}
+
+uint64_t Mycila::JSYEnergy::getIntegratedReturned(const uint8_t channel) const {
+  if (channel > AGGREGATE)
+    return 0;
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _integrals[channel].returned / JSY_ENERGY_WUS_PER_MWH;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toJson
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef MYCILA_JSON_SUPPORT
+void Mycila::JSYEnergy::toJson(const JsonObject& root) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (uint8_t c = 0; c < 4; c++) {
+    const char* name = JSY::getChannelName(_model, c);
+    if (!name)
+      continue;
+    JsonObject channel = root[name].to<JsonObject>();
+    for (size_t i = 0; i < COUNTERS; i++)
+      if (_has(i, c))
+        channel[counterKey(i)] = _get(i, c);
+    channel["integrated_imported"] = _integrals[c].imported / JSY_ENERGY_WUS_PER_MWH;
+    channel["integrated_returned"] = _integrals[c].returned / JSY_ENERGY_WUS_PER_MWH;
+  }
+}
+#endif
+
+void Mycila::JSYEnergy::toJson(JSYJsonWriter& writer) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (uint8_t c = 0; c < 4; c++) {
+    const char* name = JSY::getChannelName(_model, c);
+    if (!name)
+      continue;
+    writer.key(name);
+    writer.beginObject();
+    for (size_t i = 0; i < COUNTERS; i++) {
+      if (_has(i, c)) {
+        writer.key(counterKey(i));
+        writer.value(_get(i, c));
+      }
+    }
+    writer.key(MYCILA_JSY_JSON_KEY("integrated_imported"));
+    writer.value(_integrals[c].imported / JSY_ENERGY_WUS_PER_MWH);
+    writer.key(MYCILA_JSY_JSON_KEY("integrated_returned"));
+    writer.value(_integrals[c].returned / JSY_ENERGY_WUS_PER_MWH);
+    writer.endObject();
+  }
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "MycilaJSY.h"
+#include "MycilaJSYStorage.h"
+
+// Longest time in milliseconds between two reads integrated: the power during a longer gap is unknown, so it is not integrated
+#ifndef MYCILA_JSY_ENERGY_MAX_GAP_MS
+  #define MYCILA_JSY_ENERGY_MAX_GAP_MS 5000
+#endif
+
+// Persisted totals (see JSYEnergy::setStorage()): longest time in milliseconds a change waits in RAM before being written
+#ifndef MYCILA_JSY_ENERGY_FLUSH_INTERVAL_MS
+  #define MYCILA_JSY_ENERGY_FLUSH_INTERVAL_MS 600000
+#endif
+
+// Persisted totals: energy in Wh written as soon as it is reached, before the interval
+#ifndef MYCILA_JSY_ENERGY_FLUSH_DELTA_WH
+  #define MYCILA_JSY_ENERGY_FLUSH_DELTA_WH 1000
+#endif
+
+// Persisted totals: number of records written in turn, each one under the key followed by its index
+#ifndef MYCILA_JSY_ENERGY_SLOTS
+  #define MYCILA_JSY_ENERGY_SLOTS 4
+#endif
+
+namespace Mycila {
+  /**
+   * @brief 64-bit energy counters in mWh, for all the channels / phases and the aggregate, without any extra request to the device.
+   *
+   * - The energy counters of the device are decoded from their raw registers in 64-bit, without the rounding to the Wh of Metrics (i.e. 0.3125 Wh steps for the JSY-MK-163, 0.1 Wh for the JSY-MK-194)
+   *   and without its overflow at 4.29 GWh. A 32-bit register going back to a small value is a wraparound and is carried to the upper bits.
+   *   Any other decrease (i.e. resetEnergy()) resets the counter to the value of the device.
+   * - The active power is integrated between the timestamps of the responses (microseconds) with the trapezoidal rule,
+   *   in separate imported and returned accumulators, giving sub-Wh energies over short intervals, even for the models without hardware counters for the returned energy.
+   *   A gap longer than MYCILA_JSY_ENERGY_MAX_GAP_MS between two successful reads is not integrated.
+   *
+   * Attach it to a JSY with JSY::setEnergy() to update it at each successful read.
+   *
+   * The totals of the active energy imported and returned (see getTotal()) start at the value of the device counters and never go back: they add their steps, through their resets.
+   * With setStorage(), they are also persisted and continue across reboots.
+   */
+  class JSYEnergy {
+    public:
+      // Channel index of the aggregate
+      static constexpr uint8_t AGGREGATE = JSY::AGGREGATE;
+
+      /**
+       * @brief Energy of a device counter in mWh
+       * @param field An energy field (i.e. FIELD_ACTIVE_ENERGY_IMPORTED)
+       * @param channel 0, 1, 2 for channel 1 / phase A, channel 2 / phase B, phase C or AGGREGATE (default)
+       * @return The energy in mWh, or 0 if the device does not provide this counter
+       */
+      uint64_t getCounter(uint32_t field, uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @return true if the device provides the energy counter (see getCounter())
+       */
+      bool hasCounter(uint32_t field, uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @brief Total of the active energy imported or returned in mWh, continuous across the resets of the device and, with setStorage(), across reboots.
+       * @param field FIELD_ACTIVE_ENERGY_IMPORTED or FIELD_ACTIVE_ENERGY_RETURNED
+       * @param channel 0, 1, 2 for channel 1 / phase A, channel 2 / phase B, phase C or AGGREGATE (default)
+       * @return The energy in mWh, or 0 if the device does not provide this counter
+       */
+      uint64_t getTotal(uint32_t field, uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @brief Persist the totals (see getTotal()) in a storage and restore them now.
+       *
+       * The totals are kept in RAM and written behind, at most every MYCILA_JSY_ENERGY_FLUSH_INTERVAL_MS or when MYCILA_JSY_ENERGY_FLUSH_DELTA_WH is reached,
+       * and by flush(), JSY::end() and JSY::resetEnergy().
+       * A record also holds the value of the device counters: the energy counted by the device while the ESP32 was off, or not yet written, is added at the first read after a reboot.
+       *
+       * The records are written in turn in MYCILA_JSY_ENERGY_SLOTS keys (key0, key1, ...) with a sequence number and a CRC,
+       * so the writes are spread and a record broken by a power loss falls back on the previous one.
+       *
+       * @param storage The storage (i.e. JSYNVSStorage or JSYFileStorage), or nullptr to stop persisting
+       * @param key The prefix of the keys of the records (up to 14 characters)
+       * @return true if totals were restored
+       * @note Call it before JSY::setEnergy(). The storage and the key must live as long as this JSYEnergy.
+       */
+      bool setStorage(JSYStorage* storage, const char* key = "jsy_energy");
+
+      /**
+       * @brief Write the totals if they changed since the last write
+       * @return false if the write failed
+       */
+      bool flush();
+
+      /**
+       * @return The number of records written since the start
+       */
+      uint32_t getWrites() const { return _writes; }
+
+      /**
+       * @return The number of wraparounds of the 32-bit registers of the device carried to the counters
+       */
+      uint32_t getWraps() const { return _wraps; }
+
+      /**
+       * @return The active energy imported from the grid, integrated from the active power, in mWh
+       */
+      uint64_t getIntegratedImported(uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @return The active energy returned to the grid, integrated from the active power, in mWh
+       */
+      uint64_t getIntegratedReturned(uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @return The time in milliseconds covered by the integration
+       */
+      uint64_t getIntegratedTime() const { return _integratedTime / 1000; }
+
+      // clear the counters, the totals and the integration, and write the cleared totals
+      void clear();
+
+#ifdef MYCILA_JSON_SUPPORT
+      /**
+       * @brief Energies in mWh of all the channels, i.e. {"aggregate": {"active_energy_imported": 1234567, "integrated_imported": 1234321, "integrated_returned": 0}}
+       */
+      void toJson(const JsonObject& root) const;
+#endif
+      // write the same keys as toJson(JsonObject) into the current object of the writer
+      void toJson(JSYJsonWriter& writer) const; // NOLINT
+
+    private:
+      friend class JSY;
+
+      // number of energy fields, from FIELD_ACTIVE_ENERGY to FIELD_APPARENT_ENERGY
+      static constexpr size_t COUNTERS = 7;
+
+      struct Counter {
+          uint64_t raw = 0;   // raw register value extended to 64-bit
+          uint64_t total = 0; // sum of the steps of the register through its resets, in the unit of raw
+          uint32_t last = 0;  // last register value, or the one of the restored record before the first read
+          uint16_t num = 0;   // Wh = raw * num / den, 0 when not provided by the device
+          uint16_t den = 1;
+      };
+
+      struct Integral {
+          uint64_t imported = 0; // W.us
+          uint64_t returned = 0; // W.us
+          float power = NAN;     // active power of the previous read
+      };
+
+      Counter _counters[4][COUNTERS];
+      Integral _integrals[4];
+      int64_t _time = 0; // timestamp of the previous read
+      uint64_t _integratedTime = 0;
+      uint32_t _wraps = 0;
+      uint16_t _model = MYCILA_JSY_MK_UNKNOWN;
+      // write-behind persistence of the totals
+      JSYStorage* _storage = nullptr;
+      const char* _key = nullptr;
+      uint32_t _sequence = 0;  // sequence number of the last record
+      bool _dirty = false;     // totals changed since the last write
+      float _unflushed = 0;    // Wh added to the totals since the last write
+      int64_t _flushTime = 0;  // timestamp of the last write
+      uint32_t _writes = 0;
+      mutable std::mutex _mutex;
+
+      // updates the counters from the registers of a successful read and integrates its active power
+      void _add(uint16_t model, const uint8_t* registers, uint32_t fields, const JSY::Data& data, int64_t timestamp);
+      void _clear();
+      // energy of a counter, or the sum of the counters it is computed from, must be called with _mutex held
+      bool _has(size_t index, uint8_t channel) const;
+      uint64_t _get(size_t index, uint8_t channel) const;
+      static uint64_t _mWh(uint64_t raw, const Counter& counter);
+      // write the totals, must be called with _mutex held
+      bool _flush();
+      bool _restore();
+  };
+} // namespace Mycila
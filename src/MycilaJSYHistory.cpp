@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYHistory.h"
+
+// Record header flags
+// bits 0-3: channels stored (1 << channel index, 1 << AGGREGATE)
+#define JSY_HISTORY_CHANNELS  0x0F
+// the recorded fields follow the header (3 bytes), otherwise they are the ones of the previous record
+#define JSY_HISTORY_FIELDS    0x10
+// the time is absolute (4 bytes), otherwise it is a delta from the previous record (2 bytes)
+#define JSY_HISTORY_ABSOLUTE  0x20
+// the aggregate is not stored: it is a copy of channel 1
+#define JSY_HISTORY_AGGREGATE 0x40
+
+// fields holding a value in the metrics
+static uint32_t populated(const Mycila::JSY::Metrics& metrics) {
+  uint32_t fields = 0;
+  for (size_t i = 0; i < Mycila::JSY::FIELD_COUNT; i++) {
+    const Mycila::JSY::FieldTarget& f = Mycila::JSY::FIELD_TARGETS[i];
+    if (f.real ? !std::isnan(metrics.*f.real) : metrics.*f.counter != 0)
+      fields |= 1UL << i;
+  }
+  return fields;
+}
+
+static size_t bitCount(uint32_t value) {
+  size_t count = 0;
+  for (; value; value &= value - 1)
+    count++;
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// write
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYHistory::add(const JSY::Data& data, uint32_t time) {
+  if (data.model == MYCILA_JSY_MK_UNKNOWN)
+    return false;
+
+  const JSY::Metrics* metrics[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+
+  // channels and fields holding a value
+  uint8_t flags = 0;
+  uint32_t fields = 0;
+  for (uint8_t c = 0; c < 4; c++) {
+    if (!(_recordChannels & (1 << c)))
+      continue;
+    const uint32_t f = populated(*metrics[c]) & _recordFields;
+    if (f) {
+      flags |= 1 << c;
+      fields |= f;
+    }
+  }
+  if (!fields)
+    return false;
+
+  // single channel devices: the aggregate is the channel
+  if ((flags & (1 << AGGREGATE)) && (flags & 1) && data.aggregate == data._metrics[0])
+    flags = (flags & ~(1 << AGGREGATE)) | JSY_HISTORY_AGGREGATE;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (_count && (data.address != _address || data.model != _model))
+    _clear();
+  _address = data.address;
+  _model = data.model;
+
+  // keep the time monotonic so that the time ranges stay ordered
+  if (_count && static_cast<int32_t>(time - _headTime) < 0)
+    time = _headTime;
+
+  uint8_t record[MAX_RECORD_SIZE];
+  size_t len = 1;
+
+  if (!_count || fields != _headFields) {
+    flags |= JSY_HISTORY_FIELDS;
+    record[len++] = fields;
+    record[len++] = fields >> 8;
+    record[len++] = fields >> 16;
+  }
+
+  const uint32_t delta = time - _headTime;
+  if (!_count || delta > 0xFFFF) {
+    flags |= JSY_HISTORY_ABSOLUTE;
+    memcpy(record + len, &time, 4);
+    len += 4;
+  } else {
+    record[len++] = delta;
+    record[len++] = delta >> 8;
+  }
+
+  record[0] = flags;
+
+  for (uint8_t c = 0; c < 4; c++) {
+    if (!(flags & (1 << c)))
+      continue;
+    for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+      if (fields & (1UL << i)) {
+        const JSY::FieldTarget& f = JSY::FIELD_TARGETS[i];
+        if (f.real)
+          memcpy(record + len, &(metrics[c]->*f.real), 4);
+        else
+          memcpy(record + len, &(metrics[c]->*f.counter), 4);
+        len += 4;
+      }
+    }
+  }
+
+  while (_size - _used < len)
+    _drop();
+
+  _write(_head, record, len);
+  _head = (_head + len) % _size;
+  _used += len;
+  _count++;
+  _headTime = time;
+  _headFields = fields;
+
+  return true;
+}
+
+void Mycila::JSYHistory::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _clear();
+}
+
+void Mycila::JSYHistory::_clear() {
+  _head = 0;
+  _tail = 0;
+  _used = 0;
+  _count = 0;
+  _tailSeq = 0;
+  _tailTime = 0;
+  _tailFields = 0;
+  _headTime = 0;
+  _headFields = 0;
+  _generation++;
+}
+
+// drop the oldest record, must be called with _mutex held
+void Mycila::JSYHistory::_drop() {
+  uint8_t flags;
+  const size_t headerLen = _header(_tail, _tailTime, _tailFields, flags);
+  const size_t len = headerLen + _valuesLength(_tailFields, flags);
+  _tail = (_tail + len) % _size;
+  _used -= len;
+  _count--;
+  _tailSeq++;
+  _dropped++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+///////////////////////////////////////////////////////////////////////////////
+
+Mycila::JSYHistory::Cursor Mycila::JSYHistory::range(uint32_t from, uint32_t to) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Cursor cursor;
+  cursor._history = this;
+  cursor._from = from;
+  cursor._to = to;
+  cursor._seq = _tailSeq;
+  cursor._pos = _tail;
+  cursor._time = _tailTime;
+  cursor._fields = _tailFields;
+  cursor._generation = _generation;
+  return cursor;
+}
+
+Mycila::JSYHistory::Cursor Mycila::JSYHistory::all() const {
+  uint32_t from = getOldestTime();
+  uint32_t to = getNewestTime();
+  return range(from, to);
+}
+
+bool Mycila::JSYHistory::Cursor::next(uint32_t& time, JSY::Data& data) {
+  if (!_history)
+    return false;
+
+  std::lock_guard<std::mutex> lock(_history->_mutex);
+
+  // history cleared, or the records not yet read were dropped: restart from the oldest record
+  if (_generation != _history->_generation || static_cast<int32_t>(_seq - _history->_tailSeq) < 0) {
+    _generation = _history->_generation;
+    _seq = _history->_tailSeq;
+    _pos = _history->_tail;
+    _time = _history->_tailTime;
+    _fields = _history->_tailFields;
+  }
+
+  while (_seq != _history->_tailSeq + _history->_count) {
+    uint32_t t = _time;
+    uint32_t fields = _fields;
+    uint8_t flags;
+    const size_t headerLen = _history->_header(_pos, t, fields, flags);
+
+    // past the range: stay on this record
+    if (static_cast<int32_t>(t - _to) > 0)
+      return false;
+
+    const size_t valuesLen = _history->_valuesLength(fields, flags);
+    const size_t pos = (_pos + headerLen) % _history->_size;
+
+    _pos = (pos + valuesLen) % _history->_size;
+    _seq++;
+    _time = t;
+    _fields = fields;
+
+    if (static_cast<int32_t>(t - _from) < 0)
+      continue;
+
+    uint8_t values[MAX_RECORD_SIZE];
+    _history->_read(pos, values, valuesLen);
+
+    data.clear();
+    data.address = _history->_address;
+    data.model = _history->_model;
+    JSY::Metrics* metrics[] = {&data._metrics[0], &data._metrics[1], &data._metrics[2], &data.aggregate};
+    const uint8_t* value = values;
+    for (uint8_t c = 0; c < 4; c++) {
+      if (!(flags & (1 << c)))
+        continue;
+      for (size_t i = 0; i < JSY::FIELD_COUNT; i++) {
+        if (fields & (1UL << i)) {
+          const JSY::FieldTarget& f = JSY::FIELD_TARGETS[i];
+          if (f.real)
+            memcpy(&(metrics[c]->*f.real), value, 4);
+          else
+            memcpy(&(metrics[c]->*f.counter), value, 4);
+          value += 4;
+        }
+      }
+    }
+    if (flags & JSY_HISTORY_AGGREGATE)
+      data.aggregate = data._metrics[0];
+
+    time = t;
+    return true;
+  }
+
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// accessors
+///////////////////////////////////////////////////////////////////////////////
+
+size_t Mycila::JSYHistory::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _count;
+}
+
+size_t Mycila::JSYHistory::getUsedBytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _used;
+}
+
+uint32_t Mycila::JSYHistory::getDropCount() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _dropped;
+}
+
+uint32_t Mycila::JSYHistory::getOldestTime() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_count)
+    return 0;
+  uint32_t time = _tailTime;
+  uint32_t fields = _tailFields;
+  uint8_t flags;
+  _header(_tail, time, fields, flags);
+  return time;
+}
+
+uint32_t Mycila::JSYHistory::getNewestTime() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _count ? _headTime : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// private
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSYHistory::_write(size_t pos, const uint8_t* src, size_t len) {
+  const size_t first = std::min(len, _size - pos);
+  memcpy(_buffer + pos, src, first);
+  memcpy(_buffer, src + first, len - first);
+}
+
+void Mycila::JSYHistory::_read(size_t pos, uint8_t* dst, size_t len) const {
+  const size_t first = std::min(len, _size - pos);
+  memcpy(dst, _buffer + pos, first);
+  memcpy(dst + first, _buffer, len - first);
+}
+
+size_t Mycila::JSYHistory::_header(size_t pos, uint32_t& time, uint32_t& fields, uint8_t& flags) const {
+  uint8_t header[8];
+  _read(pos, header, 1);
+  flags = header[0];
+  const size_t len = 1 + (flags & JSY_HISTORY_FIELDS ? 3 : 0) + (flags & JSY_HISTORY_ABSOLUTE ? 4 : 2);
+  _read(pos, header, len);
+  size_t i = 1;
+  if (flags & JSY_HISTORY_FIELDS) {
+    fields = header[1] | (header[2] << 8) | (static_cast<uint32_t>(header[3]) << 16);
+    i = 4;
+  }
+  if (flags & JSY_HISTORY_ABSOLUTE)
+    memcpy(&time, header + i, 4);
+  else
+    time += header[i] | (header[i + 1] << 8);
+  return len;
+}
+
+size_t Mycila::JSYHistory::_valuesLength(uint32_t fields, uint8_t flags) {
+  return 4 * bitCount(flags & JSY_HISTORY_CHANNELS) * bitCount(fields);
+}
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "MycilaJSY.h"
+
+namespace Mycila {
+  /**
+   * @brief Time-series history of the data read from one device, stored in a fixed memory ring.
+   *
+   * Each sample is a compact record holding only what was populated in the data:
+   * - a 1-byte header, the time as a 2-byte delta from the previous sample (4 bytes after a gap of more than 65 s),
+   * - the recorded fields, only when they change from the previous sample (3 bytes),
+   * - 4 bytes per recorded field and per channel / phase / aggregate holding a value (the aggregate is not stored when it is a copy of the single channel).
+   *
+   * When the ring is full, the oldest samples are dropped. No memory is allocated after construction.
+   * The history can be filled from a callback of a JSY or a JSYBus and read from another task with a Cursor.
+   *
+   * Example: a JSY-MK-194 with setFields(FIELD_ACTIVE_POWER) uses 3 + 3 x 4 = 15 bytes per sample (2 channels and the aggregate),
+   * so 5 minutes at 20 Hz fit in 90 KB, and 1 minute in 18 KB.
+   */
+  class JSYHistory {
+    public:
+      // Index of the aggregate metrics in the channels mask (see setChannels())
+      static constexpr uint8_t AGGREGATE = JSY::AGGREGATE;
+      // Minimum size of the storage: the biggest record (4 x JSY::FIELD_COUNT fields)
+      static constexpr size_t MAX_RECORD_SIZE = 1 + 3 + 4 + 4 * JSY::FIELD_COUNT * 4;
+
+      /**
+       * @brief Reads the samples of a history in time order. Allocation free.
+       * Samples added while reading are also returned if they are in the time range.
+       * If the samples not yet read are dropped by the writer because the ring is full, the cursor continues from the oldest sample still stored.
+       */
+      class Cursor {
+        public:
+          /**
+           * @brief Move to the next sample in the time range.
+           * @param time Set to the time of the sample (millis() when it was added, unless given to add())
+           * @param data Set to the data of the sample. Fields which were not recorded are cleared (NAN or 0).
+           * @return false when there are no more samples in the time range
+           */
+          bool next(uint32_t& time, JSY::Data& data); // NOLINT
+
+        private:
+          friend class JSYHistory;
+          const JSYHistory* _history = nullptr;
+          uint32_t _from = 0;
+          uint32_t _to = 0;
+          uint32_t _seq = 0;    // sequence number of the next record
+          size_t _pos = 0;      // offset of the next record in the storage
+          uint32_t _time = 0;   // time of the previous record
+          uint32_t _fields = 0; // fields of the previous record
+          uint32_t _generation = 0;
+      };
+
+      /**
+       * @param buffer The storage of the samples: must stay valid for the lifetime of the history and hold at least MAX_RECORD_SIZE bytes
+       * @param size The size of the buffer in bytes
+       */
+      JSYHistory(uint8_t* buffer, size_t size) : _buffer(buffer), _size(size) { assert(size >= MAX_RECORD_SIZE); }
+
+      /**
+       * @brief Record a sample. The data of EVT_READ events is expected.
+       * @param data The data read. When the address or model of the data change, the history is cleared.
+       * @param time The time of the sample in milliseconds (default: millis()). Must not go backward.
+       * @return false if the data is empty (no model or no value)
+       */
+      bool add(const JSY::Data& data, uint32_t time = millis());
+
+      /**
+       * @brief Select the fields to record (default: FIELD_ALL). Only the fields holding a value in the data are stored.
+       * @note Takes effect for the next samples.
+       */
+      void setFields(uint32_t fields) { _recordFields = fields & JSY::FIELD_ALL; }
+      uint32_t getFields() const { return _recordFields; }
+
+      /**
+       * @brief Select the metrics to record as a mask of channels (default: all).
+       * Bits 0, 1, 2: channel 1 / phase A, channel 2 / phase B, phase C. Bit 3 (1 << AGGREGATE): aggregate.
+       * @note Takes effect for the next samples.
+       */
+      void setChannels(uint8_t channels) { _recordChannels = channels & 0x0F; }
+      uint8_t getChannels() const { return _recordChannels; }
+
+      /**
+       * @brief Samples in a time range, both ends included. The range must be shorter than 24 days.
+       */
+      Cursor range(uint32_t from, uint32_t to) const;
+
+      /**
+       * @brief Samples of the last given milliseconds until now.
+       */
+      Cursor last(uint32_t duration) const {
+        const uint32_t now = millis();
+        return range(now - duration, now);
+      }
+
+      /**
+       * @brief All the samples stored.
+       */
+      Cursor all() const;
+
+      // remove all the samples
+      void clear();
+
+      // number of samples stored
+      size_t size() const;
+      // number of bytes used by the samples
+      size_t getUsedBytes() const;
+      // size of the storage in bytes
+      size_t getCapacity() const { return _size; }
+      // number of samples dropped because the ring was full
+      uint32_t getDropCount() const;
+      // time of the oldest sample, 0 if empty
+      uint32_t getOldestTime() const;
+      // time of the newest sample, 0 if empty
+      uint32_t getNewestTime() const;
+
+    private:
+      uint8_t* _buffer;
+      const size_t _size;
+      uint32_t _recordFields = JSY::FIELD_ALL;
+      uint8_t _recordChannels = 0x0F;
+
+      size_t _head = 0; // offset of the next record to write
+      size_t _tail = 0; // offset of the oldest record
+      size_t _used = 0; // bytes used by the records
+      size_t _count = 0;
+      // sequence number of the oldest record, so that a cursor can tell if its next record was dropped
+      uint32_t _tailSeq = 0;
+      // state before the oldest record (needed to decode it)
+      uint32_t _tailTime = 0;
+      uint32_t _tailFields = 0;
+      // state of the newest record
+      uint32_t _headTime = 0;
+      uint32_t _headFields = 0;
+      uint32_t _dropped = 0;
+      // incremented on clear() to reset the cursors
+      uint32_t _generation = 0;
+      uint8_t _address = MYCILA_JSY_ADDRESS_UNKNOWN;
+      uint16_t _model = MYCILA_JSY_MK_UNKNOWN;
+      mutable std::mutex _mutex;
+
+      void _clear();
+      void _drop();
+      void _write(size_t pos, const uint8_t* src, size_t len);
+      void _read(size_t pos, uint8_t* dst, size_t len) const;
+      // decodes the header of the record at pos from the time and fields of the previous record: returns the length of the header
+      size_t _header(size_t pos, uint32_t& time, uint32_t& fields, uint8_t& flags) const; // NOLINT
+      // length of the values of a record
+      static size_t _valuesLength(uint32_t fields, uint8_t flags);
+  };
+
+  /**
+   * @brief JSYHistory with its own storage of Size bytes.
+   */
+  template <size_t Size>
+  class JSYStaticHistory : public JSYHistory {
+    public:
+      JSYStaticHistory() : JSYHistory(_storage, Size) {}
+
+    private:
+      uint8_t _storage[Size];
+  };
+} // namespace Mycila
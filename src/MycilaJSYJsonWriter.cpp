@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYJsonWriter.h"
+
+// most decimals written for a float (a float has about 7 significant digits)
+#define JSY_JSON_MAX_DECIMALS 6
+
+static constexpr uint32_t POW10[JSY_JSON_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+// writes the decimal digits of value at the end of buffer, returns the first digit
+static char* formatUnsigned(uint64_t value, char* end) {
+  do {
+    *--end = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  return end;
+}
+
+void Mycila::JSYJsonWriter::beginObject() {
+  _separator();
+  _put('{');
+  _depth++;
+  _comma &= ~(1UL << _depth);
+}
+
+void Mycila::JSYJsonWriter::endObject() {
+  _put('}');
+  _depth--;
+}
+
+void Mycila::JSYJsonWriter::key(const char* fragment, size_t len) {
+  _separator();
+  _write(fragment, len);
+  _afterKey = true;
+}
+
+void Mycila::JSYJsonWriter::key(const char* name) {
+  _separator();
+  _put('"');
+  _write(name, strlen(name));
+  _write("\":", 2);
+  _afterKey = true;
+}
+
+void Mycila::JSYJsonWriter::value(float value, uint8_t decimals) {
+  _separator();
+
+  if (!std::isfinite(value)) {
+    _write("null", 4);
+    return;
+  }
+
+  double d = value;
+  const bool negative = d < 0;
+  if (negative)
+    d = -d;
+
+  if (decimals > JSY_JSON_MAX_DECIMALS)
+    decimals = JSY_JSON_MAX_DECIMALS;
+
+  // out of the fixed-point range: rare, let printf handle it
+  if (d >= 1e12) {
+    char str[24];
+    const int len = snprintf(str, sizeof(str), "%.9g", static_cast<double>(value));
+    _write(str, len);
+    return;
+  }
+
+  const uint64_t scaled = static_cast<uint64_t>(d * POW10[decimals] + 0.5);
+  uint64_t integer = scaled / POW10[decimals];
+  uint32_t fraction = scaled % POW10[decimals];
+
+  char str[32];
+  char* end = str + sizeof(str);
+  char* p = end;
+
+  if (fraction) {
+    // trailing zeros are removed
+    while (fraction % 10 == 0) {
+      fraction /= 10;
+      decimals--;
+    }
+    for (uint8_t i = 0; i < decimals; i++) {
+      *--p = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    *--p = '.';
+  }
+  p = formatUnsigned(integer, p);
+  if (negative && scaled)
+    *--p = '-';
+
+  _write(p, end - p);
+}
+
+void Mycila::JSYJsonWriter::value(uint32_t value) {
+  _separator();
+  char str[12];
+  char* end = str + sizeof(str);
+  char* p = formatUnsigned(value, end);
+  _write(p, end - p);
+}
+
+void Mycila::JSYJsonWriter::value(uint64_t value) {
+  _separator();
+  char str[21];
+  char* end = str + sizeof(str);
+  char* p = formatUnsigned(value, end);
+  _write(p, end - p);
+}
+
+void Mycila::JSYJsonWriter::value(bool value) {
+  _separator();
+  if (value)
+    _write("true", 4);
+  else
+    _write("false", 5);
+}
+
+void Mycila::JSYJsonWriter::value(const char* value) {
+  _separator();
+  _put('"');
+  _write(value, strlen(value));
+  _put('"');
+}
+
+size_t Mycila::JSYJsonWriter::end() {
+  if (_out) {
+    _out->write(reinterpret_cast<const uint8_t*>(_buffer), _pos);
+    _pos = 0;
+  } else if (_buffer) {
+    _buffer[_pos] = '\0';
+  }
+  return _length;
+}
+
+void Mycila::JSYJsonWriter::_separator() {
+  // values in an object are preceded by a key which already added the separator
+  if (_afterKey) {
+    _afterKey = false;
+    return;
+  }
+  if (_comma & (1UL << _depth))
+    _put(',');
+  _comma |= 1UL << _depth;
+}
+
+void Mycila::JSYJsonWriter::_put(char c) {
+  _length++;
+  if (_pos == _size) {
+    if (!_out)
+      return;
+    _out->write(reinterpret_cast<const uint8_t*>(_buffer), _pos);
+    _pos = 0;
+  }
+  _buffer[_pos++] = c;
+}
+
+void Mycila::JSYJsonWriter::_write(const char* str, size_t len) {
+  _length += len;
+  while (len) {
+    if (_pos == _size) {
+      if (!_out)
+        return;
+      _out->write(reinterpret_cast<const uint8_t*>(_buffer), _pos);
+      _pos = 0;
+    }
+    const size_t n = std::min(len, _size - _pos);
+    memcpy(_buffer + _pos, str, n);
+    _pos += n;
+    str += n;
+    len -= n;
+  }
+}
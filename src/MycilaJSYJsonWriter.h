@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include <Arduino.h>
+
+// Key fragment for JSYJsonWriter::key(): the quoted key and the colon, with their length computed at compile time
+#define MYCILA_JSY_JSON_KEY(name) "\"" name "\":", sizeof("\"" name "\":") - 1
+
+namespace Mycila {
+  /**
+   * @brief Allocation-free JSON writer used by the toJson(char*, size_t) and toJson(Print&) functions.
+   * It writes directly to a caller buffer or to a Print (through a small stack buffer), without ArduinoJson.
+   * Floats are written with a fixed number of decimals, trailing zeros removed.
+   */
+  class JSYJsonWriter {
+    public:
+      /**
+       * @brief Write to a buffer. The output is always null-terminated and truncated if the buffer is too small.
+       */
+      JSYJsonWriter(char* buffer, size_t size) : _buffer(size ? buffer : nullptr), _size(size ? size - 1 : 0) {}
+
+      /**
+       * @brief Write to a Print (i.e. a Serial, a WiFiClient or an AsyncResponseStream).
+       */
+      explicit JSYJsonWriter(Print& out) : _out(&out), _buffer(_chunk), _size(sizeof(_chunk)) {} // NOLINT
+
+      JSYJsonWriter(const JSYJsonWriter&) = delete;
+      JSYJsonWriter& operator=(const JSYJsonWriter&) = delete;
+
+      // start an object (as a value after key(), or as the root)
+      void beginObject();
+      void endObject();
+
+      // a precomputed key fragment, see MYCILA_JSY_JSON_KEY
+      void key(const char* fragment, size_t len);
+      // a key computed at runtime (not escaped)
+      void key(const char* name);
+
+      void value(float value, uint8_t decimals);
+      void value(uint32_t value);
+      void value(uint64_t value);
+      void value(bool value);
+      // a string value (not escaped)
+      void value(const char* value);
+
+      /**
+       * @brief Flush the output and null-terminate the buffer.
+       * @return The length of the JSON. When writing to a buffer, it can be larger than the buffer size if the output was truncated.
+       */
+      size_t end();
+
+    private:
+      Print* _out = nullptr;
+      char* _buffer;
+      size_t _size;       // usable size of _buffer
+      size_t _pos = 0;    // position in _buffer
+      size_t _length = 0; // total length written
+      uint32_t _comma = 0; // bit set for each depth which already has a member
+      uint8_t _depth = 0;
+      bool _afterKey = false;
+      char _chunk[64];
+
+      void _write(const char* str, size_t len);
+      void _put(char c);
+      void _separator();
+  };
+} // namespace Mycila
@@ -156,3 +156,103 @@ void Mycila::JSY::Metrics::toJson(const JsonObject& root) const {
     root["thdi_0"] = t;
 }
 #endif
+
+void Mycila::JSY::Metrics::toJson(JSYJsonWriter& writer) const {
+  // same keys and order as toJson(JsonObject)
+  if (!std::isnan(frequency)) {
+    writer.key(MYCILA_JSY_JSON_KEY("frequency"));
+    writer.value(frequency, 2);
+  }
+  if (!std::isnan(voltage)) {
+    writer.key(MYCILA_JSY_JSON_KEY("voltage"));
+    writer.value(voltage, 4);
+  }
+  if (!std::isnan(current)) {
+    writer.key(MYCILA_JSY_JSON_KEY("current"));
+    writer.value(current, 4);
+  }
+  if (!std::isnan(activePower)) {
+    writer.key(MYCILA_JSY_JSON_KEY("active_power"));
+    writer.value(activePower, 4);
+  }
+  if (!std::isnan(reactivePower)) {
+    writer.key(MYCILA_JSY_JSON_KEY("reactive_power"));
+    writer.value(reactivePower, 4);
+  }
+  if (!std::isnan(apparentPower)) {
+    writer.key(MYCILA_JSY_JSON_KEY("apparent_power"));
+    writer.value(apparentPower, 4);
+  }
+  if (!std::isnan(powerFactor)) {
+    writer.key(MYCILA_JSY_JSON_KEY("power_factor"));
+    writer.value(powerFactor, 3);
+  }
+  if (activeEnergy) {
+    writer.key(MYCILA_JSY_JSON_KEY("active_energy"));
+    writer.value(activeEnergy);
+  }
+  if (apparentEnergy) {
+    writer.key(MYCILA_JSY_JSON_KEY("apparent_energy"));
+    writer.value(apparentEnergy);
+  }
+  if (activeEnergyImported) {
+    writer.key(MYCILA_JSY_JSON_KEY("active_energy_imported"));
+    writer.value(activeEnergyImported);
+  }
+  if (activeEnergyReturned) {
+    writer.key(MYCILA_JSY_JSON_KEY("active_energy_returned"));
+    writer.value(activeEnergyReturned);
+  }
+  if (reactiveEnergy) {
+    writer.key(MYCILA_JSY_JSON_KEY("reactive_energy"));
+    writer.value(reactiveEnergy);
+  }
+  if (reactiveEnergyImported) {
+    writer.key(MYCILA_JSY_JSON_KEY("reactive_energy_imported"));
+    writer.value(reactiveEnergyImported);
+  }
+  if (reactiveEnergyReturned) {
+    writer.key(MYCILA_JSY_JSON_KEY("reactive_energy_returned"));
+    writer.value(reactiveEnergyReturned);
+  }
+  if (!std::isnan(phaseAngleU)) {
+    writer.key(MYCILA_JSY_JSON_KEY("phase_angle_u"));
+    writer.value(phaseAngleU, 2);
+  }
+  if (!std::isnan(phaseAngleI)) {
+    writer.key(MYCILA_JSY_JSON_KEY("phase_angle_i"));
+    writer.value(phaseAngleI, 2);
+  }
+  if (!std::isnan(phaseAngleUI)) {
+    writer.key(MYCILA_JSY_JSON_KEY("phase_angle_ui"));
+    writer.value(phaseAngleUI, 2);
+  }
+  if (!std::isnan(thdU)) {
+    writer.key(MYCILA_JSY_JSON_KEY("thd_u"));
+    writer.value(thdU, 2);
+  }
+  if (!std::isnan(thdI)) {
+    writer.key(MYCILA_JSY_JSON_KEY("thd_i"));
+    writer.value(thdI, 2);
+  }
+  float r = resistance();
+  float d = dimmedVoltage();
+  float n = nominalPower();
+  float t = thdi();
+  if (!std::isnan(r)) {
+    writer.key(MYCILA_JSY_JSON_KEY("resistance"));
+    writer.value(r, 4);
+  }
+  if (!std::isnan(d)) {
+    writer.key(MYCILA_JSY_JSON_KEY("dimmed_voltage"));
+    writer.value(d, 4);
+  }
+  if (!std::isnan(n)) {
+    writer.key(MYCILA_JSY_JSON_KEY("nominal_power"));
+    writer.value(n, 4);
+  }
+  if (!std::isnan(t)) {
+    writer.key(MYCILA_JSY_JSON_KEY("thdi_0"));
+    writer.value(t, 4);
+  }
+}
@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYStats.h"
+
+static constexpr uint32_t JSY_STATS_DEFAULT_WINDOWS[] = {1000, 10000, 60000};
+
+Mycila::JSYStats::JSYStats() {
+  for (size_t w = 0; w < MYCILA_JSY_STATS_WINDOWS; w++) {
+    // windows above the 3 defaults are 10 times longer than the previous one
+    uint32_t duration = w < 3 ? JSY_STATS_DEFAULT_WINDOWS[w] : _windows[w - 1].duration * 10;
+    _windows[w].duration = duration;
+    _windows[w].bucketDuration = duration / MYCILA_JSY_STATS_BUCKETS;
+    _clear(_windows[w]);
+  }
+  setFields(JSY::FIELD_ACTIVE_POWER | JSY::FIELD_VOLTAGE | JSY::FIELD_CURRENT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// settings
+///////////////////////////////////////////////////////////////////////////////
+
+bool Mycila::JSYStats::setWindow(size_t window, uint32_t duration) {
+  if (window >= MYCILA_JSY_STATS_WINDOWS || duration < MYCILA_JSY_STATS_BUCKETS)
+    return false;
+  std::lock_guard<std::mutex> lock(_mutex);
+  _windows[window].duration = duration;
+  _windows[window].bucketDuration = duration / MYCILA_JSY_STATS_BUCKETS;
+  _clear(_windows[window]);
+  return true;
+}
+
+bool Mycila::JSYStats::setFields(uint32_t fields) {
+  fields &= JSY::FIELD_ALL;
+  uint8_t slots[MYCILA_JSY_STATS_FIELDS];
+  size_t count = 0;
+  for (uint8_t i = 0; i < JSY::FIELD_COUNT; i++) {
+    if (!(fields & (1UL << i)))
+      continue;
+    // energies are not tracked
+    if (!JSY::FIELD_TARGETS[i].real || count == MYCILA_JSY_STATS_FIELDS)
+      return false;
+    slots[count++] = i;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _fields = fields;
+  _slotCount = count;
+  memcpy(_slots, slots, count);
+  for (Window& window : _windows)
+    _clear(window);
+  return true;
+}
+
+void Mycila::JSYStats::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (Window& window : _windows)
+    _clear(window);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// update
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSYStats::add(const JSY::Data& data, uint32_t time) {
+  const JSY::Metrics* metrics[] = {&data.channel(0), &data.channel(1), &data.phase(2), &data.aggregate};
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (data.model != _model) {
+    _model = data.model;
+    for (Window& window : _windows)
+      _clear(window);
+  }
+
+  for (Window& window : _windows) {
+    const uint32_t epoch = time / window.bucketDuration;
+    const size_t b = epoch % MYCILA_JSY_STATS_BUCKETS;
+
+    // the bucket is reused for a new period of time
+    if (window.epochs[b] != epoch) {
+      window.epochs[b] = epoch;
+      for (size_t c = 0; c < 4; c++)
+        for (size_t s = 0; s < _slotCount; s++)
+          window.buckets[c][s][b].count = 0;
+    }
+
+    for (size_t c = 0; c < 4; c++) {
+      for (size_t s = 0; s < _slotCount; s++) {
+        const float value = metrics[c]->*JSY::FIELD_TARGETS[_slots[s]].real;
+        if (std::isnan(value))
+          continue;
+        Bucket& bucket = window.buckets[c][s][b];
+        // Welford's online algorithm
+        if (bucket.count++ == 0) {
+          bucket.mean = value;
+          bucket.m2 = 0;
+          bucket.min = value;
+          bucket.max = value;
+        } else {
+          const float delta = value - bucket.mean;
+          bucket.mean += delta / bucket.count;
+          bucket.m2 += delta * (value - bucket.mean);
+          bucket.min = std::min(bucket.min, value);
+          bucket.max = std::max(bucket.max, value);
+        }
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read
+///////////////////////////////////////////////////////////////////////////////
+
+Mycila::JSYStats::Stat Mycila::JSYStats::get(size_t window, uint32_t field, uint8_t channel) const {
+  if (window >= MYCILA_JSY_STATS_WINDOWS || channel > AGGREGATE)
+    return Stat();
+  const uint32_t now = millis();
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (size_t s = 0; s < _slotCount; s++)
+    if (field == 1UL << _slots[s])
+      return _get(_windows[window], s, channel, now);
+  return Stat();
+}
+
+// merges the buckets of the window with Chan's parallel algorithm, must be called with _mutex held
+Mycila::JSYStats::Stat Mycila::JSYStats::_get(const Window& window, size_t slot, uint8_t channel, uint32_t now) const {
+  const uint32_t epoch = now / window.bucketDuration;
+  uint32_t count = 0;
+  double mean = 0;
+  double m2 = 0;
+  Stat stat;
+  for (size_t b = 0; b < MYCILA_JSY_STATS_BUCKETS; b++) {
+    const Bucket& bucket = window.buckets[channel][slot][b];
+    if (!bucket.count || epoch - window.epochs[b] >= MYCILA_JSY_STATS_BUCKETS)
+      continue;
+    const uint32_t n = count + bucket.count;
+    const double delta = bucket.mean - mean;
+    mean += delta * bucket.count / n;
+    m2 += bucket.m2 + delta * delta * count * bucket.count / n;
+    stat.min = count ? std::min(stat.min, bucket.min) : bucket.min;
+    stat.max = count ? std::max(stat.max, bucket.max) : bucket.max;
+    count = n;
+  }
+  if (count) {
+    stat.count = count;
+    stat.mean = mean;
+    stat.variance = m2 / count;
+  }
+  return stat;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toJson
+///////////////////////////////////////////////////////////////////////////////
+
+static void windowName(uint32_t duration, char* name, size_t size) {
+  if (duration % 1000 == 0)
+    snprintf(name, size, "%" PRIu32 "s", duration / 1000);
+  else
+    snprintf(name, size, "%" PRIu32 "ms", duration);
+}
+
+#ifdef MYCILA_JSON_SUPPORT
+void Mycila::JSYStats::toJson(const JsonObject& root) const {
+  const uint32_t now = millis();
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const Window& window : _windows) {
+    char name[16];
+    windowName(window.duration, name, sizeof(name));
+    JsonObject json = root[name].to<JsonObject>();
+    for (uint8_t c = 0; c < 4; c++) {
+      const char* channelName = JSY::getChannelName(_model, c);
+      if (!channelName)
+        continue;
+      JsonObject channel = json[channelName].to<JsonObject>();
+      for (size_t s = 0; s < _slotCount; s++) {
+        const Stat stat = _get(window, s, c, now);
+        if (!stat.count)
+          continue;
+        JsonObject field = channel[JSY::FIELD_TARGETS[_slots[s]].key].to<JsonObject>();
+        field["count"] = stat.count;
+        field["mean"] = stat.mean;
+        field["stddev"] = stat.stddev();
+        field["min"] = stat.min;
+        field["max"] = stat.max;
+      }
+    }
+  }
+}
+#endif
+
+void Mycila::JSYStats::toJson(JSYJsonWriter& writer) const {
+  const uint32_t now = millis();
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const Window& window : _windows) {
+    char name[16];
+    windowName(window.duration, name, sizeof(name));
+    writer.key(name);
+    writer.beginObject();
+    for (uint8_t c = 0; c < 4; c++) {
+      const char* channelName = JSY::getChannelName(_model, c);
+      if (!channelName)
+        continue;
+      writer.key(channelName);
+      writer.beginObject();
+      for (size_t s = 0; s < _slotCount; s++) {
+        const Stat stat = _get(window, s, c, now);
+        if (!stat.count)
+          continue;
+        writer.key(JSY::FIELD_TARGETS[_slots[s]].key);
+        writer.beginObject();
+        writer.key(MYCILA_JSY_JSON_KEY("count"));
+        writer.value(stat.count);
+        writer.key(MYCILA_JSY_JSON_KEY("mean"));
+        writer.value(stat.mean, 4);
+        writer.key(MYCILA_JSY_JSON_KEY("stddev"));
+        writer.value(stat.stddev(), 4);
+        writer.key(MYCILA_JSY_JSON_KEY("min"));
+        writer.value(stat.min, 4);
+        writer.key(MYCILA_JSY_JSON_KEY("max"));
+        writer.value(stat.max, 4);
+        writer.endObject();
+      }
+      writer.endObject();
+    }
+    writer.endObject();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// private
+///////////////////////////////////////////////////////////////////////////////
+
+void Mycila::JSYStats::_clear(Window& window) {
+  for (size_t b = 0; b < MYCILA_JSY_STATS_BUCKETS; b++) {
+    window.epochs[b] = 0;
+    for (size_t c = 0; c < 4; c++)
+      for (size_t s = 0; s < MYCILA_JSY_STATS_FIELDS; s++)
+        window.buckets[c][s][b].count = 0;
+  }
+}
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include "MycilaJSY.h"
+
+// Number of rolling windows (default: 1 s, 10 s and 60 s)
+#ifndef MYCILA_JSY_STATS_WINDOWS
+  #define MYCILA_JSY_STATS_WINDOWS 3
+#endif
+
+// Number of buckets per window: the window slides by steps of duration / buckets
+#ifndef MYCILA_JSY_STATS_BUCKETS
+  #define MYCILA_JSY_STATS_BUCKETS 10
+#endif
+
+// Maximum number of fields tracked at the same time (default: active power, voltage and current)
+#ifndef MYCILA_JSY_STATS_FIELDS
+  #define MYCILA_JSY_STATS_FIELDS 3
+#endif
+
+namespace Mycila {
+  /**
+   * @brief Rolling statistics (count, mean, variance, min, max) of some metrics over time windows, for all the channels / phases and the aggregate.
+   *
+   * Each window is split in MYCILA_JSY_STATS_BUCKETS buckets of duration / buckets.
+   * A sample updates the current bucket of each window in O(1) with Welford's algorithm.
+   * Reading the statistics of a window merges its buckets, so a window covers between (buckets - 1) / buckets and all of its duration, and never needs the samples.
+   * The memory used is fixed: about 20 bytes per window, bucket, channel and field (7 KB with the defaults).
+   *
+   * Attach it to a JSY with JSY::setStats() to update it at each read, or call add() from a callback (i.e. for the devices of a JSYBus).
+   */
+  class JSYStats {
+    public:
+      // Channel index of the aggregate in get()
+      static constexpr uint8_t AGGREGATE = JSY::AGGREGATE;
+
+      struct Stat {
+          uint32_t count = 0; // number of samples in the window
+          float mean = NAN;
+          float variance = NAN; // population variance of the samples
+          float min = NAN;
+          float max = NAN;
+          float stddev() const { return std::sqrt(variance); }
+      };
+
+      JSYStats();
+
+      /**
+       * @brief Add the values of a sample. Called by the JSY when attached with JSY::setStats().
+       * @param data The data of an EVT_READ event
+       * @param time The time of the sample in milliseconds (default: millis())
+       */
+      void add(const JSY::Data& data, uint32_t time = millis());
+
+      /**
+       * @brief Statistics of a field over a window, up to now.
+       * @param window The index of the window (0 to MYCILA_JSY_STATS_WINDOWS - 1)
+       * @param field A single field (i.e. FIELD_ACTIVE_POWER) selected with setFields()
+       * @param channel 0, 1, 2 for channel 1 / phase A, channel 2 / phase B, phase C or AGGREGATE (default)
+       * @return The statistics, with a count of 0 if there is no sample in the window or if the field is not tracked
+       */
+      Stat get(size_t window, uint32_t field, uint8_t channel = AGGREGATE) const;
+
+      /**
+       * @brief Set the duration of a window and clear its statistics.
+       * @param window The index of the window (0 to MYCILA_JSY_STATS_WINDOWS - 1)
+       * @param duration The duration in milliseconds (at least MYCILA_JSY_STATS_BUCKETS)
+       * @return false if the window index or the duration is invalid
+       */
+      bool setWindow(size_t window, uint32_t duration);
+      uint32_t getWindow(size_t window) const { return window < MYCILA_JSY_STATS_WINDOWS ? _windows[window].duration : 0; }
+
+      /**
+       * @brief Select the fields to track and clear the statistics (default: FIELD_ACTIVE_POWER | FIELD_VOLTAGE | FIELD_CURRENT).
+       * Only real values can be tracked (not the energies), up to MYCILA_JSY_STATS_FIELDS fields.
+       * @return false if too many fields or an energy field is given
+       */
+      bool setFields(uint32_t fields);
+      uint32_t getFields() const { return _fields; }
+
+      // clear all the statistics
+      void clear();
+
+#ifdef MYCILA_JSON_SUPPORT
+      /**
+       * @brief Statistics of all the windows, i.e. {"1s": {"aggregate": {"active_power": {"count": 20, "mean": 500.2, "stddev": 1.5, "min": 498.7, "max": 502.1}}}}
+       */
+      void toJson(const JsonObject& root) const;
+#endif
+      // write the same keys as toJson(JsonObject) into the current object of the writer
+      void toJson(JSYJsonWriter& writer) const; // NOLINT
+
+    private:
+      struct Bucket {
+          uint32_t count;
+          float mean;
+          float m2; // sum of the squared differences from the mean
+          float min;
+          float max;
+      };
+
+      struct Window {
+          uint32_t duration;
+          uint32_t bucketDuration;
+          uint32_t epochs[MYCILA_JSY_STATS_BUCKETS]; // time / bucketDuration of each bucket
+          Bucket buckets[4][MYCILA_JSY_STATS_FIELDS][MYCILA_JSY_STATS_BUCKETS];
+      };
+
+      Window _windows[MYCILA_JSY_STATS_WINDOWS];
+      uint32_t _fields = JSY::FIELD_NONE;
+      uint8_t _slots[MYCILA_JSY_STATS_FIELDS]; // field bit index of each tracked field
+      size_t _slotCount = 0;
+      uint16_t _model = MYCILA_JSY_MK_UNKNOWN;
+      mutable std::mutex _mutex;
+
+      void _clear(Window& window);
+      Stat _get(const Window& window, size_t slot, uint8_t channel, uint32_t now) const;
+  };
+} // namespace Mycila
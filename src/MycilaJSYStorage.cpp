@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#include "MycilaJSYStorage.h"
+
+#include <stdio.h>
+
+#ifdef MYCILA_LOGGER_SUPPORT
+  #include <MycilaLogger.h>
+extern Mycila::Logger logger;
+  #define LOGD(tag, format, ...) logger.debug(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) logger.warn(tag, format, ##__VA_ARGS__)
+#else
+  #define LOGD(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
+  #define LOGW(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+#endif
+
+#define TAG "JSY"
+
+#ifndef ARDUINO_NATIVE
+
+///////////////////////////////////////////////////////////////////////////////
+// NVS
+///////////////////////////////////////////////////////////////////////////////
+
+Mycila::JSYNVSStorage::~JSYNVSStorage() {
+  if (_opened)
+    nvs_close(_handle);
+}
+
+size_t Mycila::JSYNVSStorage::read(const char* key, void* buffer, size_t size) {
+  if (!_open())
+    return 0;
+  size_t len = size;
+  const esp_err_t err = nvs_get_blob(_handle, key, buffer, &len);
+  if (err != ESP_OK) {
+    if (err != ESP_ERR_NVS_NOT_FOUND)
+      LOGD(TAG, "NVS read(%s) error: %s", key, esp_err_to_name(err));
+    return 0;
+  }
+  return len;
+}
+
+bool Mycila::JSYNVSStorage::write(const char* key, const void* data, size_t len) {
+  if (!_open())
+    return false;
+  esp_err_t err = nvs_set_blob(_handle, key, data, len);
+  if (err == ESP_OK)
+    err = nvs_commit(_handle);
+  if (err != ESP_OK) {
+    LOGW(TAG, "NVS write(%s) error: %s", key, esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
+
+bool Mycila::JSYNVSStorage::remove(const char* key) {
+  if (!_open())
+    return false;
+  esp_err_t err = nvs_erase_key(_handle, key);
+  if (err == ESP_ERR_NVS_NOT_FOUND)
+    return true;
+  if (err == ESP_OK)
+    err = nvs_commit(_handle);
+  return err == ESP_OK;
+}
+
+bool Mycila::JSYNVSStorage::_open() {
+  if (!_opened) {
+    const esp_err_t err = nvs_open(_ns, NVS_READWRITE, &_handle);
+    if (err != ESP_OK) {
+      LOGW(TAG, "NVS open(%s) error: %s", _ns, esp_err_to_name(err));
+      return false;
+    }
+    _opened = true;
+  }
+  return true;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// File
+///////////////////////////////////////////////////////////////////////////////
+
+size_t Mycila::JSYFileStorage::read(const char* key, void* buffer, size_t size) {
+  FILE* file = fopen(_path(key).c_str(), "rb");
+  if (!file)
+    return 0;
+  // one more byte to detect a record larger than the buffer
+  uint8_t extra;
+  size_t len = fread(buffer, 1, size, file);
+  if (len == size && fread(&extra, 1, 1, file) == 1)
+    len = 0;
+  fclose(file);
+  return len;
+}
+
+bool Mycila::JSYFileStorage::write(const char* key, const void* data, size_t len) {
+  const std::string path = _path(key);
+  const std::string tmp = path + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file) {
+    LOGW(TAG, "Unable to write %s", tmp.c_str());
+    return false;
+  }
+  const bool written = fwrite(data, 1, len, file) == len;
+  if (fclose(file) != 0 || !written) {
+    ::remove(tmp.c_str());
+    LOGW(TAG, "Unable to write %s", tmp.c_str());
+    return false;
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    // some file systems do not replace an existing file
+    ::remove(path.c_str());
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+      LOGW(TAG, "Unable to write %s", path.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Mycila::JSYFileStorage::remove(const char* key) {
+  const std::string path = _path(key);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return true;
+  fclose(file);
+  return ::remove(path.c_str()) == 0;
+}
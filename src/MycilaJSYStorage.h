@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright (C) Mathieu Carbou
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include <string>
+
+#ifndef ARDUINO_NATIVE
+  #include <nvs.h>
+#endif
+
+namespace Mycila {
+  /**
+   * @brief Key / value storage of small binary records, used to persist what the library learns across reboots (see JSY::setProfileStorage()).
+   * Implement it to use another storage.
+   */
+  class JSYStorage {
+    public:
+      virtual ~JSYStorage() = default;
+
+      /**
+       * @brief Read a record
+       * @param key The key of the record (up to 15 characters)
+       * @param buffer The buffer receiving the record
+       * @param size The size of the buffer
+       * @return The size of the record, or 0 if it does not exist or does not fit in the buffer
+       */
+      virtual size_t read(const char* key, void* buffer, size_t size) = 0;
+
+      /**
+       * @brief Write a record, replacing the previous one
+       * @return true if the record is written
+       */
+      virtual bool write(const char* key, const void* data, size_t len) = 0;
+
+      /**
+       * @brief Remove a record
+       * @return true if the record is removed or did not exist
+       */
+      virtual bool remove(const char* key) = 0;
+  };
+
+#ifndef ARDUINO_NATIVE
+  /**
+   * @brief Storage in a namespace of the NVS partition (initialized by the Arduino core at boot).
+   */
+  class JSYNVSStorage : public JSYStorage {
+    public:
+      explicit JSYNVSStorage(const char* ns = "jsy") : _ns(ns) {}
+      ~JSYNVSStorage() override;
+
+      size_t read(const char* key, void* buffer, size_t size) override;
+      bool write(const char* key, const void* data, size_t len) override;
+      bool remove(const char* key) override;
+
+    private:
+      const char* _ns;
+      nvs_handle_t _handle = 0;
+      bool _opened = false;
+
+      bool _open();
+  };
+#endif
+
+  /**
+   * @brief Storage in one file per key in a directory: on the host, or on a file system mounted in the VFS of the ESP32 (i.e. "/littlefs/jsy").
+   * A record is written to a temporary file which then replaces the previous one, so a power loss keeps the previous record.
+   */
+  class JSYFileStorage : public JSYStorage {
+    public:
+      explicit JSYFileStorage(const char* directory) : _directory(directory) {}
+
+      size_t read(const char* key, void* buffer, size_t size) override;
+      bool write(const char* key, const void* data, size_t len) override;
+      bool remove(const char* key) override;
+
+    private:
+      std::string _directory;
+
+      std::string _path(const char* key) const { return _directory + "/" + key; }
+  };
+} // namespace Mycila